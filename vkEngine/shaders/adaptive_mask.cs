@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#include "pathtracer.glsl"
+
+// Relative standard error of the pixel mean luminance, returns false if there are not enough samples
+//	to trust the estimate yet
+bool getPixelError(ivec2 pixelCoords, out float error)
+{
+	// Only the traced samples count, reprojected history doesn't contribute to the moments
+	const vec3 moments = imageLoad(momentsImage, pixelCoords).xyz;
+	const float numSamples = moments.z;
+	if (numSamples < float(max(ubo.adaptiveMinSamples, 2)))
+	{
+		error = 0.0;
+		return false;
+	}
+
+	// Unbiased sample variance
+	const float variance = max(moments.y - moments.x * moments.x, 0.0) * numSamples / (numSamples - 1.0);
+	error = sqrt(variance / numSamples) / max(moments.x, 1e-3);
+	return true;
+}
+
+// Allocates the samples for the next frame: pixels with the error estimate above the threshold
+//	take the full amount of samples, the converged ones are skipped entirely
+void main()
+{
+	ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
+	if (pixelCoords.x >= int(ubo.renderWidth) || pixelCoords.y >= int(ubo.renderHeight))
+		return;
+
+	// Error is dilated over the 3x3 neighborhood, so that a pixel where few samples happened to agree
+	//	(e.g. rarely hit caustic) isn't considered converged while its neighbors are still noisy
+	const ivec2 maxCoords = ivec2(ubo.renderWidth - 1, ubo.renderHeight - 1);
+	bool isConverged = true;
+	for (int offsetY = -1; offsetY <= 1 && isConverged; ++offsetY)
+	{
+		for (int offsetX = -1; offsetX <= 1; ++offsetX)
+		{
+			float error;
+			ivec2 neighborCoords = clamp(pixelCoords + ivec2(offsetX, offsetY), ivec2(0, 0), maxCoords);
+			if (!getPixelError(neighborCoords, error) || error > ubo.adaptiveErrorThreshold)
+			{
+				isConverged = false;
+				break;
+			}
+		}
+	}
+
+	imageStore(sampleCountImage, pixelCoords, uvec4(isConverged ? 0 : ubo.samplesPerFrame, 0, 0, 0));
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec4 in_color;
+layout(location = 1) in vec2 in_texCoords;
+layout(location = 2) in float in_time;
+
+layout(location = 0) out vec4 outColor;
+
+#include "ubo.glsl"
+
+// Filled by the compute path tracer
+layout(set = 0, binding = 2, rgba32f) uniform readonly image2D accumImage;
+
+// Storage images can't be sampled, so the bilinear filter is done manually; with the render extent equal
+//	to the swapchain extent the weights are zero, and this turns into the plain per-pixel copy
+vec3 loadAccumBilinear(vec2 displayCoords)
+{
+	const vec2 renderSize = vec2(ubo.renderWidth, ubo.renderHeight);
+	const vec2 displaySize = vec2(ubo.displayWidth, ubo.displayHeight);
+
+	const vec2 renderCoords = displayCoords * (renderSize / displaySize) - 0.5;
+	const vec2 baseCoords = floor(renderCoords);
+	const vec2 weights = renderCoords - baseCoords;
+
+	// Render extent is the top-left part of the image, the rest holds the stale data
+	const ivec2 maxCoords = ivec2(renderSize) - 1;
+	const ivec2 coords00 = clamp(ivec2(baseCoords), ivec2(0), maxCoords);
+	const ivec2 coords11 = clamp(ivec2(baseCoords) + 1, ivec2(0), maxCoords);
+
+	// Accumulation alpha stores the number of samples
+	const vec3 color00 = imageLoad(accumImage, coords00).rgb;
+	const vec3 color10 = imageLoad(accumImage, ivec2(coords11.x, coords00.y)).rgb;
+	const vec3 color01 = imageLoad(accumImage, ivec2(coords00.x, coords11.y)).rgb;
+	const vec3 color11 = imageLoad(accumImage, coords11).rgb;
+
+	return mix(mix(color00, color10, weights.x), mix(color01, color11, weights.x), weights.y);
+}
+
+void main()
+{
+	outColor = in_color * vec4(loadAccumBilinear(gl_FragCoord.xy), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Workgroup size is set via specialization constants, see `Wrapper::initComputePipelineState`
+layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z = 1) in;
+
+// Image could be dispatched in several tiles, each dispatch covers one tile
+layout(push_constant) uniform PushConstants
+{
+	ivec2 tileOffset;
+	ivec2 tileSize;
+} pushConstants;
+
+#include "pathtracer.glsl"
+
+void main()
+{
+	ivec2 tileCoords = ivec2(gl_GlobalInvocationID.xy);
+	if (tileCoords.x >= pushConstants.tileSize.x || tileCoords.y >= pushConstants.tileSize.y)
+		return;
+
+	ivec2 pixelCoords = pushConstants.tileOffset + tileCoords;
+	if (pixelCoords.x >= int(ubo.renderWidth) || pixelCoords.y >= int(ubo.renderHeight))
+		return;
+
+	// Match the texture coordinates of the fullscreen quad: pixel centers, with V pointing up
+	vec2 uv = vec2(
+		(pixelCoords.x + 0.5) / float(ubo.renderWidth),
+		1.0 - (pixelCoords.y + 0.5) / float(ubo.renderHeight)
+		);
+
+	vec4 surface;
+	PixelSamples samples = tracePixel(pixelCoords, uv, getPixelNumSamples(pixelCoords), surface);
+	accumulatePixel(pixelCoords, samples);
+
+	if (samples.numSamples > 0)
+		storePixelSurface(pixelCoords, surface);
+	else
+		carryPixelSurface(pixelCoords);
+}
\ No newline at end of file
@@ -0,0 +1,656 @@
+#ifndef PATHTRACER_GLSL
+#define PATHTRACER_GLSL
+
+// Path tracing integrator, shared between the fragment and compute shader variants
+//	requires GL_GOOGLE_include_directive
+
+#include "ubo.glsl"
+#include "sampler.glsl"
+
+// Running average of all the samples since the last accumulation restart, alpha stores the number of samples
+layout(set = 0, binding = 2, rgba32f) uniform image2D accumImage;
+// Adaptive sampling statistics: x - mean luminance, y - mean squared luminance of the individual samples
+//	since the last accumulation restart, zw are unused
+layout(set = 0, binding = 6, rgba32f) uniform image2D momentsImage;
+// Number of samples each pixel takes in the current frame, written by `adaptive_mask.cs`
+layout(set = 0, binding = 7, r32ui) uniform uimage2D sampleCountImage;
+// First hit of the first pixel sample, for the temporal reprojection: xyz - normal, w - distance along the ray,
+//	negative if the sky is hit; images alternate between the frames, so the previous frame surfaces are kept intact
+layout(set = 0, binding = 9, rgba32f) uniform image2D surfaceImage0;
+layout(set = 0, binding = 10, rgba32f) uniform image2D surfaceImage1;
+
+#define PI		3.14159265358979323846
+#define _2PI	6.28318530717958647692
+
+// Maps the uniform random numbers in [0, 1) onto the point in the unit sphere: xy - angles, z - radius
+vec3 randInUnitSphere(vec3 rnd)
+{
+	float angTheta = _2PI*rnd.x;
+	float angPhi = _2PI*rnd.y;
+	float rad = rnd.z;
+
+	return vec3(rad*sin(angTheta)*cos(angPhi), rad*sin(angTheta)*sin(angPhi), rad*cos(angTheta));
+}
+// Maps the uniform random numbers in [0, 1) onto the point on the unit disk: x - angle, y - radius
+vec2 randOnDisk(vec2 rnd)
+{
+	float ang = _2PI*rnd.x;
+	float rad = rnd.y;
+
+	return vec2(rad*cos(ang), rad*sin(ang));
+}
+
+// Scatter direction perturbation, takes the bounce dimensions of the sampler
+vec3 getBounceRandInUnitSphere(inout SamplerState samplerState)
+{
+	const vec2 rndAngles = getBounceSample2D(samplerState, SAMPLER_BOUNCE_PAIR_DIRECTION);
+	const float rndRadius = getBounceSample2D(samplerState, SAMPLER_BOUNCE_PAIR_RADIUS_LOBE).x;
+	return randInUnitSphere(vec3(rndAngles, rndRadius));
+}
+
+/* Ray */
+struct Ray
+{
+	vec3 O;
+	vec3 D;
+};
+
+Ray getRay(vec3 O, vec3 D)
+{
+	Ray r;
+	r.O = O;
+	r.D = D;
+	return r;
+}
+
+vec3 getRayPoint(Ray ray, float t)
+{
+	return ray.O + t * ray.D;
+}
+/* End of Ray */
+
+/* Hitting Routines */
+struct HitData
+{
+	vec3 p;
+	vec3 n;
+	float t;
+	int materialIndex;
+};
+
+bool hitSphere(vec3 center, float radius, int materialIndex, Ray r, float t_min, float t_max, out HitData hitData)
+{
+	/*
+
+	Sphere eqn: dot( (p-c), (p-c) ) = rad*rad
+		where p - point, c - sphere center, rad - sphere radius
+	subs p for r(t)=r.O+r.D*t - ray:
+		dot( (r(t)-c), (r(t)-c) ) = rad*rad
+		dot( (r.O+r.D*t-c), (r.O+r.D*t-c) ) = rad*rad
+	=>
+		<r.O,r.O> + <r.O,r.D*t> - <r.O,c> + <r.D*t,r.O> + <r.D*t,r.D*t> - <r.D*t,c> - <c,r.O> - <c,r.D*t> + <c,c> = rad*rad
+		<r.O,r.O> + t*<r.O,r.D> - <r.O,c> + t*<r.D,r.O> + t*<t*r.D,r.D> - t*<r.D,c> - <c,r.O> - t*<c,r.D> + <c,c> = rad*rad
+
+		t*t*<r.D,r.D> + t*(<r.O,r.D> + <r.D,r.O> - <r.D,c> - <c,r.D>) + (<r.O,r.O> - <r.O,c> - <c,r.O> + <c,c>) = rad*rad
+		t*t*<r.D,r.D> + t*(2*<r.O,r.D> - 2*<r.D,c>) + (<r.O,r.O> - 2*<r.O,c> + <c,c>) = rad*rad
+
+	also,
+		2*<r.O,r.D> - 2*<r.D,c> = 2*<r.D,r.O-c>
+		<r.O-c,r.O-c> = <r.O,r.O> - <c,r.O> - <r.O,c> + <c,c> = <r.O,r.O> - 2*<c,r.O> + <c,c>
+
+	and,
+		rayO2sphC = r.O-c
+
+	hence,
+		t*t*<r.D,r.D> + t*(2*<r.D,r.O-c>) + (<r.O-c,r.O-c>) = rad*rad
+
+	*/
+
+	vec3 rayO2sphC = r.O - center;
+	float a = dot(r.D, r.D);
+	float b = 2.0 * dot(r.D, rayO2sphC);
+	float c = dot(rayO2sphC, rayO2sphC) - radius*radius;
+	float discriminant = b*b - 4*a*c;
+
+	if (discriminant < 0)
+	{
+		return false;
+	}
+
+	// x0,x1 = [-b +- sqrt(D)] / [2*a]
+	float sqrtD_div2a = sqrt(discriminant) / (2*a);
+	float negB_div2a = -b / (2*a);
+
+	float hitT1 = negB_div2a - sqrtD_div2a;
+	if (hitT1 > t_min && hitT1 < t_max)
+	{
+		hitData.t = hitT1;
+		hitData.p = getRayPoint(r, hitT1);
+		hitData.n = (hitData.p - center) / radius;
+		hitData.materialIndex = materialIndex;
+		return true;
+	}
+
+	float hitT2 = negB_div2a + sqrtD_div2a;
+	if (hitT2 > t_min && hitT2 < t_max)
+	{
+		hitData.t = hitT2;
+		hitData.p = getRayPoint(r, hitT2);
+		hitData.n = (hitData.p - center) / radius;
+		hitData.materialIndex = materialIndex;
+		return true;
+	}
+
+	return false;
+}
+
+bool refract(vec3 v, vec3 n, float ni_over_nt, out vec3 outV)
+{
+	// Snell's law of refraction
+	// 	n1 * sin(theta1) = n2 * sin(theta2)
+	//	where n - refractive index, theta - is the angle measured from the normal of the boundary
+
+	vec3 v_nrm = normalize(v);
+	float vdotn = dot(v_nrm, n);
+	float discriminant = 1.0 - ni_over_nt*ni_over_nt * (1.0 - vdotn*vdotn);
+	if (discriminant <= 0)
+		return false;
+
+	outV = ni_over_nt * (v_nrm - vdotn*n) - n*sqrt(discriminant);
+	return true;
+}
+
+float schlick(float cosine, float refIdx)
+{
+	float r0 = (1.0 - refIdx) / (1.0 + refIdx);
+	r0 = r0*r0;
+	float one_minus_cos = 1.0 - cosine;
+	// Cannot use pow() here as per spec, it's undefined for x < 0
+	float one_minus_cos_sq = one_minus_cos*one_minus_cos;
+	return r0 + (1.0 - r0) * one_minus_cos*one_minus_cos_sq*one_minus_cos_sq;
+}
+
+// Should match `scene::MaterialType`
+#define MaterialTypeLambert	1
+#define MaterialTypeMetal	2
+#define MaterialTypeGlass	3
+// Layout should match `vulkan::SceneMaterial`
+struct Material
+{
+	int type;
+	float roughness;
+	float refIdx;
+	float pad;
+	vec4 albedo;
+};
+
+// Materials are uploaded by the host, see `vulkan::Wrapper::uploadMaterials`
+layout(std430, set = 0, binding = 5) readonly buffer MaterialsBuffer
+{
+	Material materials[];
+} materialsTable;
+
+bool materialScatterRay(int materialIndex, Ray inR, HitData hitData, inout SamplerState samplerState, out vec3 attenuation, out Ray outR)
+{
+	if (materialIndex >= int(ubo.numMaterials) || materialIndex < 0)
+		return false;
+
+	Material material = materialsTable.materials[materialIndex];
+
+	int materialType = material.type;
+	if (materialType == MaterialTypeLambert)
+	{
+		vec3 target = hitData.p + hitData.n + getBounceRandInUnitSphere(samplerState);
+		outR.O = hitData.p;
+		outR.D = target - hitData.p;
+		attenuation = material.albedo.rgb;
+		return true;
+	}
+	else if (materialType == MaterialTypeMetal)
+	{
+		vec3 reflected = reflect(normalize(inR.D), hitData.n);
+		outR.O = hitData.p;
+		outR.D = reflected + material.roughness*getBounceRandInUnitSphere(samplerState);
+		attenuation = material.albedo.rgb;
+		return (dot(outR.D, hitData.n) > 0);
+	}
+	else if (materialType == MaterialTypeGlass)
+	{
+		vec3 rayD_nrm = normalize(inR.D);
+		vec3 reflected = reflect(rayD_nrm, hitData.n);
+		float ni_over_nt;
+		attenuation = material.albedo.rgb;
+
+		const float refIdx = material.refIdx;
+
+		vec3 outNormal;
+		float cosine;
+		if (dot(rayD_nrm, hitData.n) > 0)
+		{
+			outNormal = -hitData.n;
+			ni_over_nt = refIdx;
+			cosine = refIdx*dot(rayD_nrm, hitData.n);
+		}
+		else
+		{
+			outNormal = hitData.n;
+			ni_over_nt = 1.0 / refIdx;
+			cosine = -dot(rayD_nrm, hitData.n);
+		}
+
+		vec3 refracted;
+		float reflProb;
+		if (refract(rayD_nrm, outNormal, ni_over_nt, refracted))
+		{
+			reflProb = schlick(cosine, refIdx);
+		}
+		else
+		{
+			reflProb = 1.0;
+		}
+
+		if (getBounceSample2D(samplerState, SAMPLER_BOUNCE_PAIR_RADIUS_LOBE).y > reflProb)
+		{
+			outR.O = hitData.p;
+			outR.D = refracted + material.roughness*getBounceRandInUnitSphere(samplerState);
+			return true;
+		}
+		else
+		{
+			outR.O = hitData.p;
+			outR.D = reflected;
+			return true;
+		}
+	}
+	return false;
+}
+
+#define HitObjectSphere		1
+struct HitObject
+{
+	int type;
+	int materialIndex;
+	vec4 param0;
+	vec4 param1;
+};
+
+// Scene is uploaded by the host, see `vulkan::Wrapper::uploadScene`
+//	hit objects are reordered so that each BVH leaf references contiguous range
+layout(std430, set = 0, binding = 3) readonly buffer SceneBuffer
+{
+	HitObject hitObjects[];
+} scene;
+
+// Layout should match `scene::BVHNode`
+//	nodes are stored depth-first, left child of the interior node immediately follows it
+struct BVHNode
+{
+	vec3 boundsMin;
+	// Interior node: index of the right child; leaf: index of the first hit object
+	int rightOrFirst;
+	vec3 boundsMax;
+	// Interior node: 0; leaf: number of hit objects
+	int count;
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer BVHBuffer
+{
+	BVHNode nodes[];
+} bvh;
+
+// Returns distance to the box entry point, or t_max if the box is missed or farther than t_max
+float hitAABB(vec3 boundsMin, vec3 boundsMax, vec3 rayO, vec3 rayInvD, float t_min, float t_max)
+{
+	vec3 t0 = (boundsMin - rayO) * rayInvD;
+	vec3 t1 = (boundsMax - rayO) * rayInvD;
+	vec3 tNear = min(t0, t1);
+	vec3 tFar = max(t0, t1);
+	float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, t_min));
+	float tExit = min(min(tFar.x, tFar.y), min(tFar.z, t_max));
+	return (tEnter <= tExit) ? tEnter : t_max;
+}
+
+// Zero direction components are replaced with the tiny ones, otherwise the slab test multiplies
+//	the zero distances to the slab (ray origin on the box face) by the infinity and gets NaN
+vec3 getSafeInvD(vec3 D)
+{
+	const float eps = 1e-20;
+	const vec3 tinyD = mix(vec3(eps), vec3(-eps), lessThan(D, vec3(0.0)));
+	return 1.0 / mix(D, tinyD, lessThanEqual(abs(D), vec3(eps)));
+}
+
+// Should match `c_bvhMaxDepth` in `bvh.h`, builder limits the depth so the stack is never full
+#define BVH_STACK_SIZE	64
+
+bool hitWorld(Ray r, out HitData hitData)
+{
+	// We need non-zero t_min, as sometimes due to FP errors, reflecting rays will hit the same
+	//	surface they were reflected from, causing artifacts and inf-loops
+	const float t_min = 0.00001;
+	const float t_max = 10000.0;
+
+	bool anyHit = false;
+	HitData hitDataTemp;
+	float closestHit = t_max;
+
+	if (ubo.numHitObjects == 0)
+		return false;
+
+	const vec3 rayInvD = getSafeInvD(r.D);
+
+	// Root is only tested once, children are tested by their parent to decide the traversal order
+	if (hitAABB(bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax, r.O, rayInvD, t_min, closestHit) >= closestHit)
+		return false;
+
+	// Entry distances are stored as well, since closest hit could get closer while the node is on the stack
+	int stack[BVH_STACK_SIZE];
+	float stackT[BVH_STACK_SIZE];
+	int stackSize = 0;
+	int nodeIdx = 0;
+	while (true)
+	{
+		BVHNode node = bvh.nodes[nodeIdx];
+		if (node.count > 0)
+		{
+			const int leafEnd = node.rightOrFirst + node.count;
+			for (int i = node.rightOrFirst; i < leafEnd; ++i)
+			{
+				if (scene.hitObjects[i].type == HitObjectSphere)
+				{
+					vec4 sphereParams = scene.hitObjects[i].param0;
+					// `closestHit` as t_max prunes everything behind the closest hit found so far
+					bool isSphereHit = hitSphere(sphereParams.xyz, sphereParams.w, scene.hitObjects[i].materialIndex, r, t_min, closestHit, hitDataTemp);
+					if (isSphereHit && (hitDataTemp.t < closestHit))
+					{
+						anyHit = true;
+						closestHit = hitDataTemp.t;
+						hitData = hitDataTemp;
+					}
+				}
+			}
+		}
+		else
+		{
+			int childNear = nodeIdx + 1;
+			int childFar = node.rightOrFirst;
+			float tNear = hitAABB(bvh.nodes[childNear].boundsMin, bvh.nodes[childNear].boundsMax, r.O, rayInvD, t_min, closestHit);
+			float tFar = hitAABB(bvh.nodes[childFar].boundsMin, bvh.nodes[childFar].boundsMax, r.O, rayInvD, t_min, closestHit);
+			if (tFar < tNear)
+			{
+				int tmpIdx = childNear;
+				childNear = childFar;
+				childFar = tmpIdx;
+
+				float tmpT = tNear;
+				tNear = tFar;
+				tFar = tmpT;
+			}
+
+			if (tNear < closestHit)
+			{
+				// Visit the closer child first, so that the farther one is more likely to be pruned
+				if (tFar < closestHit && stackSize < BVH_STACK_SIZE)
+				{
+					stack[stackSize] = childFar;
+					stackT[stackSize] = tFar;
+					++stackSize;
+				}
+				nodeIdx = childNear;
+				continue;
+			}
+		}
+
+		// Pop the next node that is still closer than the closest hit
+		nodeIdx = -1;
+		while (stackSize > 0)
+		{
+			--stackSize;
+			if (stackT[stackSize] < closestHit)
+			{
+				nodeIdx = stack[stackSize];
+				break;
+			}
+		}
+		if (nodeIdx < 0)
+			break;
+	}
+
+	return anyHit;
+}
+/* End of Hitting Routines */
+
+// Constant term every path contributes regardless of how it ends
+#define AMBIENT_COLOR	vec3(0.1, 0.1, 0.1)
+
+// Color that the path contributes when it stops bouncing, either missing the scene or being terminated
+vec3 getPathTerminationColor(vec3 dissipation, vec3 rayD)
+{
+	vec3 nrmD = normalize(rayD);
+	float t = clamp(0.5*(nrmD.y + 1.0), 0.0, 1.0);
+	return dissipation*((1-t)*vec3(1.0, 1.0, 1.0) + t*vec3(0.5, 0.7, 1.0)) + AMBIENT_COLOR;
+}
+
+// Unbiased Russian roulette: path survives with the probability based on its throughput, and the throughput of
+//	the surviving path is compensated by that probability; terminated path only contributes AMBIENT_COLOR
+//	returns false if the path should be terminated
+bool russianRoulette(inout vec3 dissipation, uint depth, inout SamplerState samplerState)
+{
+	if (depth < ubo.rrMinDepth)
+		return true;
+
+	float survivalProb = min(max(dissipation.r, max(dissipation.g, dissipation.b)), 0.95);
+	if (survivalProb <= 0.0 || getBounceSample1D(samplerState) >= survivalProb)
+		return false;
+
+	dissipation /= survivalProb;
+	return true;
+}
+
+#define SKY_SURFACE		vec4(0.0, 0.0, 0.0, -1.0)
+
+vec3 getColor(Ray r, SamplerState samplerState, out vec4 surface)
+{
+	Ray curRay = r;
+	bool needRayCast = true;
+	HitData hitData;
+	float recastCount = 0.0;
+
+	vec3 dissipation = vec3(1.0, 1.0, 1.0);
+	surface = SKY_SURFACE;
+
+	while (needRayCast)
+	{
+		recastCount += 1.0;
+		if (recastCount > float(ubo.maxBounces))
+			break;
+
+		bool isAnythingHit = hitWorld(curRay, hitData);
+		if (isAnythingHit)
+		{
+			if (recastCount == 1.0)
+			{
+				surface = vec4(hitData.n, hitData.t * length(curRay.D));
+			}
+
+			Ray inRay = curRay;
+			vec3 attenuation;
+			setSamplerBounce(samplerState, uint(recastCount) - 1);
+			needRayCast = materialScatterRay(hitData.materialIndex, inRay, hitData, samplerState, attenuation, curRay);
+			dissipation *= attenuation;
+
+			// No need for the roulette after the last bounce, path is terminated anyway
+			const uint depth = uint(recastCount);
+			if (needRayCast && depth < ubo.maxBounces && !russianRoulette(dissipation, depth, samplerState))
+			{
+				return AMBIENT_COLOR;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return getPathTerminationColor(dissipation, curRay.D);
+}
+
+// Primary ray through the random point within the pixel, with the random lens offset
+//	camera is set up on the host, see `scene::computeCameraRayGenParams`
+Ray generateCameraRay(vec2 uv, SamplerState samplerState)
+{
+	const float width = float(ubo.renderWidth);
+	const float height = float(ubo.renderHeight);
+
+	vec3 origin = ubo.cameraOrigin.xyz;
+	vec3 llc = ubo.cameraLowerLeftCorner.xyz;
+	vec3 axisX = ubo.cameraAxisX.xyz;
+	vec3 axisY = ubo.cameraAxisY.xyz;
+
+	vec2 rndDisk = randOnDisk(getSample2D(samplerState, SAMPLER_PAIR_LENS));
+	vec3 offset = ubo.cameraLensX.xyz*rndDisk.x + ubo.cameraLensY.xyz*rndDisk.y;
+	vec2 rndJitter = getSample2D(samplerState, SAMPLER_PAIR_PIXEL);
+	vec3 rayTarget = llc + (uv.x + rndJitter.x/width) * axisX + (uv.y + rndJitter.y/height) * axisY;
+	return getRay(origin + offset, rayTarget - origin - offset);
+}
+
+float getLuminance(vec3 color)
+{
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Number of samples the pixel takes this frame, 0 means that the pixel is converged and should be skipped
+uint getPixelNumSamples(ivec2 pixelCoords)
+{
+	// Mask is built from the statistics of the previous frame, which are discarded on accumulation restart
+	if (ubo.adaptiveSampling == 0 || ubo.accumFrameCount == 0)
+		return ubo.samplesPerFrame;
+	return imageLoad(sampleCountImage, pixelCoords).x;
+}
+
+// Sums over the samples taken for the pixel in the current frame
+struct PixelSamples
+{
+	vec3 sumColor;
+	float sumLum;
+	float sumLumSq;
+	uint numSamples;
+};
+
+PixelSamples getEmptyPixelSamples()
+{
+	PixelSamples samples;
+	samples.sumColor = vec3(0.0, 0.0, 0.0);
+	samples.sumLum = 0.0;
+	samples.sumLumSq = 0.0;
+	samples.numSamples = 0;
+	return samples;
+}
+
+void addPixelSample(inout PixelSamples samples, vec3 color)
+{
+	const float lum = getLuminance(color);
+	samples.sumColor += color;
+	samples.sumLum += lum;
+	samples.sumLumSq += lum * lum;
+	samples.numSamples += 1;
+}
+
+// Index of the first sample the pixel takes this frame: sampler sequence of the pixel continues
+//	from the amount of samples it has traced, which could differ between pixels due to the adaptive sampling;
+//	see `accumulatePixel`, accumulation alpha also counts the reprojected history
+uint getPixelFirstSampleIdx(ivec2 pixelCoords)
+{
+	if (ubo.accumFrameCount == 0)
+		return 0;
+	return uint(imageLoad(momentsImage, pixelCoords).z);
+}
+
+// Surface is only taken from the first sample, and is left as the sky if the pixel takes no samples
+PixelSamples tracePixel(ivec2 pixelCoords, vec2 uv, uint numSamples, out vec4 surface)
+{
+	const uint firstSampleIdx = getPixelFirstSampleIdx(pixelCoords);
+
+	surface = SKY_SURFACE;
+	PixelSamples samples = getEmptyPixelSamples();
+	for (int i = 0; i < int(numSamples); ++i)
+	{
+		SamplerState samplerState = getSamplerState(pixelCoords, firstSampleIdx + uint(i));
+		Ray r = generateCameraRay(uv, samplerState);
+		vec4 sampleSurface;
+		addPixelSample(samples, getColor(r, samplerState, sampleSurface));
+		if (i == 0)
+		{
+			surface = sampleSurface;
+		}
+	}
+	return samples;
+}
+
+// Surfaces are only maintained while the temporal reprojection is enabled, see `temporal.cs`
+void storePixelSurface(ivec2 pixelCoords, vec4 surface)
+{
+	if (ubo.temporalReprojection == 0)
+		return;
+
+	if ((ubo.frameIdx & 1u) == 0u)
+		imageStore(surfaceImage0, pixelCoords, surface);
+	else
+		imageStore(surfaceImage1, pixelCoords, surface);
+}
+vec4 loadPrevPixelSurface(ivec2 pixelCoords)
+{
+	if ((ubo.frameIdx & 1u) == 0u)
+		return imageLoad(surfaceImage1, pixelCoords);
+	else
+		return imageLoad(surfaceImage0, pixelCoords);
+}
+vec4 loadPixelSurface(ivec2 pixelCoords)
+{
+	if ((ubo.frameIdx & 1u) == 0u)
+		return imageLoad(surfaceImage0, pixelCoords);
+	else
+		return imageLoad(surfaceImage1, pixelCoords);
+}
+// Pixels that take no samples this frame (converged with the adaptive sampling) keep the previous surface
+void carryPixelSurface(ivec2 pixelCoords)
+{
+	if (ubo.temporalReprojection == 0)
+		return;
+
+	storePixelSurface(pixelCoords, loadPrevPixelSurface(pixelCoords));
+}
+
+// Blends the frame samples into the accumulation image, returns the accumulated color
+vec4 accumulatePixel(ivec2 pixelCoords, PixelSamples samples)
+{
+	// Pixels could take different amount of samples each frame due to the adaptive sampling,
+	//	so the running averages are weighted by the per-pixel sample count stored in the accumulation alpha
+	vec4 accumColor = vec4(0.0, 0.0, 0.0, 0.0);
+	vec4 moments = vec4(0.0, 0.0, 0.0, 0.0);
+	if (ubo.accumFrameCount > 0)
+	{
+		accumColor = imageLoad(accumImage, pixelCoords);
+		moments = imageLoad(momentsImage, pixelCoords);
+	}
+
+	if (samples.numSamples > 0)
+	{
+		const float prevNumSamples = accumColor.a;
+		const float numSamples = prevNumSamples + float(samples.numSamples);
+		accumColor.rgb = (accumColor.rgb * prevNumSamples + samples.sumColor) / numSamples;
+		accumColor.a = numSamples;
+		// Accumulation alpha also counts the reprojected history samples (see `temporal.cs`), which have no
+		//	moments, so the moments keep the amount of the traced samples they average separately
+		const float prevNumTracedSamples = moments.z;
+		const float numTracedSamples = prevNumTracedSamples + float(samples.numSamples);
+		moments.xy = (moments.xy * prevNumTracedSamples + vec2(samples.sumLum, samples.sumLumSq)) / numTracedSamples;
+		moments.z = numTracedSamples;
+
+		imageStore(accumImage, pixelCoords, accumColor);
+		imageStore(momentsImage, pixelCoords, moments);
+	}
+
+	return vec4(accumColor.rgb, 1.0);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef SAMPLER_GLSL
+#define SAMPLER_GLSL
+
+// Low-discrepancy sampler: each pair of the path dimensions takes the first two dimensions of the Sobol sequence,
+//	Owen-scrambled and shuffled with the per-pair seed, so that the pairs are decorrelated from each other
+//	(Burley 2020, "Practical Hash-based Owen Scrambling"); pixels share the sequence, and are decorrelated
+//	by the Cranley-Patterson rotation taken from the blue noise texture, which turns the remaining error
+//	into the high frequency noise. Deep bounces barely benefit from the stratification, and take the numbers
+//	from the per-path PCG generator instead, which is much cheaper than the scrambled Sobol point
+//	requires GL_GOOGLE_include_directive
+
+#include "ubo.glsl"
+
+// Generated on the host, see `vulkan::Wrapper::initTextureImage`, channels are independent patterns
+layout(set = 0, binding = 1) uniform sampler2D blueNoiseTexture;
+// Should match `image::c_blueNoiseSize`
+#define BLUE_NOISE_SIZE		64
+
+// Dimension pairs allocation: camera ray takes the first pairs, then each bounce takes the same amount of pairs,
+//	so that the same dimensions always drive the same decision regardless of what happened earlier on the path
+#define SAMPLER_PAIR_PIXEL		0
+#define SAMPLER_PAIR_LENS		1
+#define SAMPLER_NUM_CAMERA_PAIRS	2
+// Bounce pairs: scatter direction angles, then scatter direction radius and the glass lobe choice
+#define SAMPLER_BOUNCE_PAIR_DIRECTION	0
+#define SAMPLER_BOUNCE_PAIR_RADIUS_LOBE	1
+#define SAMPLER_NUM_BOUNCE_PAIRS	2
+// Bounces starting from this one take the PCG numbers
+#define SAMPLER_NUM_SOBOL_BOUNCES	4
+
+struct SamplerState
+{
+	ivec2 pixelCoords;
+	// Index of the sample in the pixel sequence, the sequence continues across the accumulated frames
+	uint sampleIdx;
+	// Same for all the pixels, changes on accumulation restart
+	uint seed;
+	// Number of scatters before the current bounce, see `setSamplerBounce`
+	uint bounceIdx;
+	// PCG state, advanced by every number taken from it; the state should be carried along the path
+	uint rngState;
+};
+
+uint hashUint(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+uint hashCombine(uint seed, uint value)
+{
+	return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// PCG (O'Neill 2014): 32-bit LCG step followed by the RXS-M-XS output permutation
+uint pcgHash(uint x)
+{
+	const uint state = x * 747796405u + 2891336453u;
+	const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+float getRngFloat(inout uint rngState)
+{
+	const uint word = pcgHash(rngState);
+	rngState = rngState * 747796405u + 2891336453u;
+	return float(word >> 8u) * (1.0 / 16777216.0);
+}
+// Integer seeding keeps the sequences intact regardless of the uptime, unlike the float time
+uint getRngState(uint pixelIdx, uint frameIdx, uint sampleIdx)
+{
+	return pcgHash(sampleIdx + pcgHash(frameIdx + pcgHash(pixelIdx + pcgHash(ubo.randomSeed))));
+}
+
+// Each bit of the result only depends on the same and the lower bits of the argument, so applied to the
+//	reversed bits it flips each bit based on the more significant ones, which is exactly what the Owen scrambling does
+uint laineKarrasPermutation(uint x, uint seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+uint nestedUniformScramble(uint x, uint seed)
+{
+	x = bitfieldReverse(x);
+	x = laineKarrasPermutation(x, seed);
+	x = bitfieldReverse(x);
+	return x;
+}
+
+// First two Sobol dimensions, 0.32 fixed point
+uvec2 sobol2D(uint index)
+{
+	// Generator matrix of the first dimension is identity, which makes it the van der Corput sequence
+	uvec2 point = uvec2(bitfieldReverse(index), 0u);
+	uint direction = 0x80000000u;
+	while (index != 0u)
+	{
+		if ((index & 1u) != 0u)
+			point.y ^= direction;
+		index >>= 1;
+		direction ^= direction >> 1;
+	}
+	return point;
+}
+
+SamplerState getSamplerState(ivec2 pixelCoords, uint sampleIdx)
+{
+	SamplerState samplerState;
+	samplerState.pixelCoords = pixelCoords;
+	samplerState.sampleIdx = sampleIdx;
+	samplerState.seed = hashCombine(hashUint(ubo.randomSeed), ubo.accumStartFrame);
+	samplerState.bounceIdx = 0;
+	const uint pixelIdx = uint(pixelCoords.y) * ubo.renderWidth + uint(pixelCoords.x);
+	samplerState.rngState = getRngState(pixelIdx, ubo.frameIdx, sampleIdx);
+	return samplerState;
+}
+// Bounce index is the number of scatters that happened before it
+void setSamplerBounce(inout SamplerState samplerState, uint bounceIdx)
+{
+	samplerState.bounceIdx = bounceIdx;
+}
+
+vec2 getSample2D(SamplerState samplerState, uint pairIdx)
+{
+	const uint pairSeed = hashCombine(samplerState.seed, pairIdx);
+
+	// Shuffled index still goes through all the samples of each aligned power of two block,
+	//	so the stratification of the sample prefixes is preserved
+	const uint shuffledIdx = nestedUniformScramble(samplerState.sampleIdx, pairSeed);
+	uvec2 point = sobol2D(shuffledIdx);
+	point.x = nestedUniformScramble(point.x, hashCombine(pairSeed, 0u));
+	point.y = nestedUniformScramble(point.y, hashCombine(pairSeed, 1u));
+	const vec2 sampleValue = vec2(point >> 8u) * (1.0 / 16777216.0);
+
+	// Noise texture is offset differently for each pair, and alternates the channel pairs
+	const uint tileHash = hashUint(pairSeed);
+	const ivec2 tileOffset = ivec2(tileHash & (BLUE_NOISE_SIZE - 1), (tileHash >> 8) & (BLUE_NOISE_SIZE - 1));
+	const vec4 blueNoise = texelFetch(blueNoiseTexture, (samplerState.pixelCoords + tileOffset) & (BLUE_NOISE_SIZE - 1), 0);
+	const vec2 rotation = ((pairIdx & 1u) == 0u) ? blueNoise.rg : blueNoise.ba;
+
+	return fract(sampleValue + rotation);
+}
+vec2 getBounceSample2D(inout SamplerState samplerState, uint bouncePairIdx)
+{
+	if (samplerState.bounceIdx >= SAMPLER_NUM_SOBOL_BOUNCES)
+	{
+		vec2 sampleValue;
+		sampleValue.x = getRngFloat(samplerState.rngState);
+		sampleValue.y = getRngFloat(samplerState.rngState);
+		return sampleValue;
+	}
+	return getSample2D(samplerState, SAMPLER_NUM_CAMERA_PAIRS + samplerState.bounceIdx * SAMPLER_NUM_BOUNCE_PAIRS + bouncePairIdx);
+}
+// Single number that is not a part of any allocated pair, always taken from the PCG generator
+float getBounceSample1D(inout SamplerState samplerState)
+{
+	return getRngFloat(samplerState.rngState);
+}
+
+#endif
\ No newline at end of file
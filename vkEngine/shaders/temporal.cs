@@ -0,0 +1,130 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#include "pathtracer.glsl"
+
+// Accumulation image of the previous frame, copied before the tracing restarted the accumulation
+layout(set = 0, binding = 8, rgba32f) uniform readonly image2D historyImage;
+
+// Surface distances are compared relative to the distance, normals by the cosine between them
+#define DISTANCE_THRESHOLD		0.05
+#define NORMAL_THRESHOLD		0.9
+// History luminance is clipped to the mean plus-minus this amount of standard deviations of the frame samples,
+//	deviation estimated from fewer samples is meaningless (zero with a single sample), so there is no clipping then
+#define CLIP_SCALE				1.0
+#define CLIP_MIN_SAMPLES		4.0
+
+// Direction through the pixel center of the current camera, same as the camera rays without the jitter and lens
+vec3 getPixelDirection(ivec2 pixelCoords)
+{
+	const vec2 uv = vec2(
+		(pixelCoords.x + 0.5) / float(ubo.renderWidth),
+		1.0 - (pixelCoords.y + 0.5) / float(ubo.renderHeight)
+		);
+	return normalize(ubo.cameraLowerLeftCorner.xyz + uv.x * ubo.cameraAxisX.xyz + uv.y * ubo.cameraAxisY.xyz - ubo.cameraOrigin.xyz);
+}
+
+// Intersects the direction from the previous camera origin with its image plane, returns false if the
+//	direction points away from it; resulting coordinates are continuous, with pixel centers at half-integers
+bool projectToPrevCamera(vec3 dir, out vec2 prevCoords)
+{
+	const vec3 axisX = ubo.prevCameraAxisX.xyz;
+	const vec3 axisY = ubo.prevCameraAxisY.xyz;
+	const vec3 planeNormal = cross(axisX, axisY);
+	const vec3 toPlane = ubo.prevCameraLowerLeftCorner.xyz - ubo.prevCameraOrigin.xyz;
+
+	prevCoords = vec2(-1.0, -1.0);
+	const float dirDotNormal = dot(dir, planeNormal);
+	if (abs(dirDotNormal) < 1e-8)
+		return false;
+	const float planeDist = dot(toPlane, planeNormal) / dirDotNormal;
+	if (planeDist <= 0.0)
+		return false;
+
+	// Image plane axes are orthogonal
+	const vec3 planePoint = dir * planeDist - toPlane;
+	const vec2 uv = vec2(dot(planePoint, axisX) / dot(axisX, axisX), dot(planePoint, axisY) / dot(axisY, axisY));
+	prevCoords = vec2(uv.x * float(ubo.renderWidth), (1.0 - uv.y) * float(ubo.renderHeight));
+	return true;
+}
+
+// Disocclusion test: previous frame surface should be the same surface the current pixel sees
+bool isSurfaceConsistent(vec4 surface, vec4 prevSurface, float expectedPrevDist)
+{
+	if (surface.w < 0.0 || prevSurface.w < 0.0)
+		return (surface.w < 0.0 && prevSurface.w < 0.0);
+
+	return abs(prevSurface.w - expectedPrevDist) < DISTANCE_THRESHOLD * expectedPrevDist && dot(surface.xyz, prevSurface.xyz) > NORMAL_THRESHOLD;
+}
+
+// Runs on the frames with the camera motion, after the tracing restarted the accumulation: the previous
+//	accumulated radiance is fetched at the location where the pixel surface was seen by the previous camera,
+//	and blended with the frame samples as if it was accumulated in this pixel
+void main()
+{
+	ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
+	if (pixelCoords.x >= int(ubo.renderWidth) || pixelCoords.y >= int(ubo.renderHeight))
+		return;
+
+	const vec4 accumColor = imageLoad(accumImage, pixelCoords);
+	if (accumColor.a <= 0.0)
+		return;
+
+	// Sky is infinitely far away, so only its direction matters
+	const vec4 surface = loadPixelSurface(pixelCoords);
+	const vec3 pixelDir = getPixelDirection(pixelCoords);
+	const vec3 surfacePoint = ubo.cameraOrigin.xyz + pixelDir * surface.w;
+	const vec3 prevDir = (surface.w < 0.0) ? pixelDir : (surfacePoint - ubo.prevCameraOrigin.xyz);
+	const float expectedPrevDist = length(prevDir);
+
+	vec2 prevCoords;
+	if (!projectToPrevCamera(prevDir, prevCoords))
+		return;
+
+	// Bilinear filter over the taps that pass the disocclusion test, so that the history doesn't leak across edges
+	const vec2 baseCoords = floor(prevCoords - 0.5);
+	const vec2 weights = prevCoords - 0.5 - baseCoords;
+	const ivec2 maxCoords = ivec2(ubo.renderWidth - 1, ubo.renderHeight - 1);
+
+	vec4 history = vec4(0.0, 0.0, 0.0, 0.0);
+	float sumWeights = 0.0;
+	for (int tapY = 0; tapY < 2; ++tapY)
+	{
+		for (int tapX = 0; tapX < 2; ++tapX)
+		{
+			const ivec2 tapCoords = ivec2(baseCoords) + ivec2(tapX, tapY);
+			if (any(lessThan(tapCoords, ivec2(0, 0))) || any(greaterThan(tapCoords, maxCoords)))
+				continue;
+			if (!isSurfaceConsistent(surface, loadPrevPixelSurface(tapCoords), expectedPrevDist))
+				continue;
+
+			const float tapWeight = ((tapX == 0) ? 1.0 - weights.x : weights.x) * ((tapY == 0) ? 1.0 - weights.y : weights.y);
+			history += tapWeight * imageLoad(historyImage, tapCoords);
+			sumWeights += tapWeight;
+		}
+	}
+	if (sumWeights < 1e-3)
+		return;
+	history /= sumWeights;
+
+	// Clipping rejects the history where the shading changed (e.g. reflections moving over the surface), the box
+	//	is based on the per-sample deviation rather than the error of the mean, so the history noise passes through
+	const vec3 moments = imageLoad(momentsImage, pixelCoords).xyz;
+	if (moments.z >= CLIP_MIN_SAMPLES)
+	{
+		const float deviation = sqrt(max(moments.y - moments.x * moments.x, 0.0) * moments.z / (moments.z - 1.0));
+		const float historyLum = getLuminance(history.rgb);
+		const float clippedLum = clamp(historyLum, moments.x - CLIP_SCALE * deviation, moments.x + CLIP_SCALE * deviation);
+		if (historyLum > 0.0)
+		{
+			history.rgb *= clippedLum / historyLum;
+		}
+	}
+
+	const float historyNumSamples = min(history.a, float(ubo.temporalMaxHistorySamples));
+	const float numSamples = historyNumSamples + accumColor.a;
+	imageStore(accumImage, pixelCoords, vec4((history.rgb * historyNumSamples + accumColor.rgb * accumColor.a) / numSamples, numSamples));
+}
\ No newline at end of file
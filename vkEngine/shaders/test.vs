@@ -1,14 +1,12 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec4 in_color;
 layout(location = 2) in vec2 in_texCoords;
 
-layout(set = 0, binding = 0) uniform UniformBufferObject
-{
-	float time;
-} ubo;
+#include "ubo.glsl"
 
 out gl_PerVertex
 {
@@ -0,0 +1,53 @@
+#ifndef UBO_GLSL
+#define UBO_GLSL
+
+// Layout should match `vulkan::UniformBufferObject`
+layout(set = 0, binding = 0) uniform UniformBufferObject
+{
+	vec4 cameraOrigin;
+	vec4 cameraLowerLeftCorner;
+	vec4 cameraAxisX;
+	vec4 cameraAxisY;
+	vec4 cameraLensX;
+	vec4 cameraLensY;
+	// Camera of the previous frame, only set for the frames that reproject the history, see `temporal.cs`
+	vec4 prevCameraOrigin;
+	vec4 prevCameraLowerLeftCorner;
+	vec4 prevCameraAxisX;
+	vec4 prevCameraAxisY;
+
+	float time;
+	uint accumFrameCount;
+	uint samplesPerFrame;
+	uint renderWidth;
+	uint renderHeight;
+	// Number of valid entries in the scene storage buffer
+	uint numHitObjects;
+	// Number of valid entries in the materials storage buffer
+	uint numMaterials;
+	// Maximum number of ray casts per path
+	uint maxBounces;
+	// Russian roulette is only applied to the paths with this or more scatters
+	uint rrMinDepth;
+	// Adaptive sampling: when enabled, pixels take the amount of samples allocated by the mask pass
+	uint adaptiveSampling;
+	// Pixels with the relative standard error of the mean luminance below this are considered converged
+	float adaptiveErrorThreshold;
+	// Pixels are not considered converged until they accumulate at least this amount of samples
+	uint adaptiveMinSamples;
+	// Seeds the sampler, see `sampler.glsl`
+	uint randomSeed;
+	// Index of the frame that restarted the accumulation, sampler sequences are reseeded on restart
+	uint accumStartFrame;
+	// Index of the current frame, seeds the PCG generator
+	uint frameIdx;
+	// Presentation target size, render size is smaller when the dynamic resolution scales it down
+	uint displayWidth;
+	uint displayHeight;
+	// Temporal reprojection: when enabled, the tracers store the first hit surfaces of the pixels
+	uint temporalReprojection;
+	// Reprojected history is capped at this amount of samples, so that it doesn't lag too much behind the motion
+	uint temporalMaxHistorySamples;
+} ubo;
+
+#endif
\ No newline at end of file
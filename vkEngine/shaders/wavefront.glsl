@@ -0,0 +1,124 @@
+#ifndef WAVEFRONT_GLSL
+#define WAVEFRONT_GLSL
+
+// Wavefront path tracer: the megakernel loop of `getColor` is split into separate stages,
+//	each processing only the paths that need it, see `vulkan::Wrapper::recordWavefrontTracing`
+//	requires GL_GOOGLE_include_directive
+
+#include "pathtracer.glsl"
+
+// Workgroup size is set via specialization constant, see `Wrapper::initWavefrontPipelines`
+layout(local_size_x_id = 0, local_size_y = 1, local_size_z = 1) in;
+
+// Should match `vulkan::Wrapper::WavefrontPushConstants`
+layout(push_constant) uniform PushConstants
+{
+	// Index of the ray queue that is currently traced (ping-pong between bounces)
+	uint rayQueueIdx;
+	uint sampleIdx;
+	uint bounceIdx;
+	// Control stage: 0 - after extend, 1 - after shade (or generate), 2 - before generate
+	uint controlPhase;
+} pushConstants;
+
+// One path per pixel, indexed by the pixel index
+struct PathState
+{
+	vec4 rayO;
+	vec4 rayD;
+	// xyz - product of attenuations along the path
+	vec4 dissipation;
+	// Number of scatters happened so far
+	uint depth;
+	// See `SamplerState::rngState`
+	uint rngState;
+	uint pad1;
+	uint pad2;
+};
+
+// Closest hit found by the extend stage for the path, indexed by the pixel index
+struct PathHit
+{
+	// xyz - hit point, w - hit distance
+	vec4 pt;
+	// xyz - normal, w - material index
+	vec4 nm;
+};
+
+layout(std430, set = 1, binding = 0) buffer PathStatesBuffer
+{
+	PathState pathStates[];
+} paths;
+
+layout(std430, set = 1, binding = 1) buffer PathHitsBuffer
+{
+	PathHit pathHits[];
+} hits;
+
+// Two ray queues of `numPaths` entries, contain pixel indices of the paths alive
+layout(std430, set = 1, binding = 2) buffer RayQueuesBuffer
+{
+	uint rayQueues[];
+} rayQueues;
+
+// One queue of `numPaths` entries per material type, contain pixel indices of the paths that need shading
+#define NUM_MATERIAL_QUEUES		3
+layout(std430, set = 1, binding = 3) buffer MaterialQueuesBuffer
+{
+	uint materialQueues[];
+} materialQueues;
+
+// Layout should match `vulkan::Wrapper::WavefrontCounters`
+//	dispatch arguments are consumed by `vkCmdDispatchIndirect`
+layout(std430, set = 1, binding = 4) buffer CountersBuffer
+{
+	uvec4 extendDispatchArgs;
+	uvec4 shadeDispatchArgs[NUM_MATERIAL_QUEUES];
+	uint rayQueueCounts[2];
+	uint materialQueueCounts[NUM_MATERIAL_QUEUES];
+} counters;
+
+// Sum of the path contributions for the current frame, per pixel
+//	w stores the sum of the squared luminances of the individual path contributions
+layout(std430, set = 1, binding = 5) buffer RadianceBuffer
+{
+	vec4 radiance[];
+} radiance;
+
+uint getNumPaths()
+{
+	return ubo.renderWidth * ubo.renderHeight;
+}
+
+ivec2 getPixelCoords(uint pixelIdx)
+{
+	return ivec2(pixelIdx % ubo.renderWidth, pixelIdx / ubo.renderWidth);
+}
+
+// Match the texture coordinates of the fullscreen quad: pixel centers, with V pointing up
+vec2 getPixelUV(ivec2 pixelCoords)
+{
+	return vec2(
+		(pixelCoords.x + 0.5) / float(ubo.renderWidth),
+		1.0 - (pixelCoords.y + 0.5) / float(ubo.renderHeight)
+		);
+}
+
+uint getNumGroups(uint numItems)
+{
+	return (numItems + gl_WorkGroupSize.x - 1) / gl_WorkGroupSize.x;
+}
+
+void addPathContribution(uint pixelIdx, vec3 color)
+{
+	// Each pixel has exactly one path alive, so no atomics needed
+	const float lum = getLuminance(color);
+	radiance.radiance[pixelIdx] += vec4(color, lum * lum);
+}
+
+void terminatePath(uint pixelIdx, vec3 dissipation, vec3 rayD)
+{
+	addPathContribution(pixelIdx, getPathTerminationColor(dissipation, rayD));
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.glsl"
+
+// Single-thread stage, which sizes the indirect dispatches by the amount of paths in the queues
+void main()
+{
+	if (gl_GlobalInvocationID.x != 0)
+		return;
+
+	const uint rayQueueIdx = pushConstants.rayQueueIdx;
+	if (pushConstants.controlPhase == 0)
+	{
+		// Extend is done: shade the material queues, and prepare the next ray queue to be filled
+		for (int queueIdx = 0; queueIdx < NUM_MATERIAL_QUEUES; ++queueIdx)
+		{
+			counters.shadeDispatchArgs[queueIdx] = uvec4(getNumGroups(counters.materialQueueCounts[queueIdx]), 1, 1, 0);
+		}
+		counters.rayQueueCounts[1 - rayQueueIdx] = 0;
+	}
+	else if (pushConstants.controlPhase == 2)
+	{
+		// Generate is about to start: it appends the paths into the first ray queue
+		counters.rayQueueCounts[0] = 0;
+		counters.rayQueueCounts[1] = 0;
+		for (int queueIdx = 0; queueIdx < NUM_MATERIAL_QUEUES; ++queueIdx)
+		{
+			counters.materialQueueCounts[queueIdx] = 0;
+		}
+	}
+	else
+	{
+		// Shade (or generate) is done: extend the surviving rays, and prepare the material queues to be filled
+		counters.extendDispatchArgs = uvec4(getNumGroups(counters.rayQueueCounts[1 - rayQueueIdx]), 1, 1, 0);
+		for (int queueIdx = 0; queueIdx < NUM_MATERIAL_QUEUES; ++queueIdx)
+		{
+			counters.materialQueueCounts[queueIdx] = 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.glsl"
+
+// Finds the closest hit for every ray in the current queue, and sorts the hit paths into the material queues
+void main()
+{
+	const uint queueEntryIdx = gl_GlobalInvocationID.x;
+	const uint rayQueueIdx = pushConstants.rayQueueIdx;
+	if (queueEntryIdx >= counters.rayQueueCounts[rayQueueIdx])
+		return;
+
+	const uint numPaths = getNumPaths();
+	const uint pixelIdx = rayQueues.rayQueues[rayQueueIdx * numPaths + queueEntryIdx];
+
+	PathState pathState = paths.pathStates[pixelIdx];
+	Ray r = getRay(pathState.rayO.xyz, pathState.rayD.xyz);
+
+	HitData hitData;
+	int materialType = -1;
+	if (hitWorld(r, hitData) && hitData.materialIndex >= 0 && hitData.materialIndex < int(ubo.numMaterials))
+	{
+		materialType = materialsTable.materials[hitData.materialIndex].type;
+	}
+
+	const int materialQueueIdx = materialType - MaterialTypeLambert;
+	if (materialQueueIdx < 0 || materialQueueIdx >= NUM_MATERIAL_QUEUES)
+	{
+		terminatePath(pixelIdx, pathState.dissipation.rgb, r.D);
+		return;
+	}
+
+	PathHit pathHit;
+	pathHit.pt = vec4(hitData.p, hitData.t);
+	pathHit.nm = vec4(hitData.n, float(hitData.materialIndex));
+	hits.pathHits[pixelIdx] = pathHit;
+
+	// Stream compaction: only hit paths get into the queues
+	uint materialQueueEntryIdx = atomicAdd(counters.materialQueueCounts[materialQueueIdx], 1);
+	materialQueues.materialQueues[materialQueueIdx * numPaths + materialQueueEntryIdx] = pixelIdx;
+}
\ No newline at end of file
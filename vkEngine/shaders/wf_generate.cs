@@ -0,0 +1,56 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.glsl"
+
+// Generates camera rays for the pixels that still need samples, and fills the first ray queue
+//	counters are reset by the preceding control stage
+void main()
+{
+	const uint pixelIdx = gl_GlobalInvocationID.x;
+	if (pixelIdx >= getNumPaths())
+		return;
+
+	// Converged pixels don't spawn paths at all
+	const ivec2 pixelCoords = getPixelCoords(pixelIdx);
+	if (pushConstants.sampleIdx >= getPixelNumSamples(pixelCoords))
+	{
+		if (pushConstants.sampleIdx == 0)
+		{
+			carryPixelSurface(pixelCoords);
+		}
+		return;
+	}
+
+	// Surface of the first sample is overwritten by the shade stage if the camera ray hits anything
+	if (pushConstants.sampleIdx == 0)
+	{
+		storePixelSurface(pixelCoords, SKY_SURFACE);
+	}
+
+	vec2 uv = getPixelUV(pixelCoords);
+	SamplerState samplerState = getSamplerState(pixelCoords, getPixelFirstSampleIdx(pixelCoords) + pushConstants.sampleIdx);
+	Ray r = generateCameraRay(uv, samplerState);
+
+	// Same as the megakernel `getColor`, without any bounces allowed the camera ray isn't even traced, and the
+	//	path is terminated right away; the bounce loop isn't recorded at all then, see `recordWavefrontTracing`
+	if (ubo.maxBounces == 0)
+	{
+		terminatePath(pixelIdx, vec3(1.0, 1.0, 1.0), r.D);
+		return;
+	}
+
+	PathState pathState;
+	pathState.rayO = vec4(r.O, 0.0);
+	pathState.rayD = vec4(r.D, 0.0);
+	pathState.dissipation = vec4(1.0, 1.0, 1.0, 0.0);
+	pathState.depth = 0;
+	pathState.rngState = samplerState.rngState;
+	pathState.pad1 = 0;
+	pathState.pad2 = 0;
+	paths.pathStates[pixelIdx] = pathState;
+
+	uint rayQueueEntryIdx = atomicAdd(counters.rayQueueCounts[0], 1);
+	rayQueues.rayQueues[rayQueueEntryIdx] = pixelIdx;
+}
\ No newline at end of file
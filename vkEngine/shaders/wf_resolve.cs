@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.glsl"
+
+// Blends the frame samples into the accumulation image
+void main()
+{
+	const uint pixelIdx = gl_GlobalInvocationID.x;
+	if (pixelIdx >= getNumPaths())
+		return;
+
+	const ivec2 pixelCoords = getPixelCoords(pixelIdx);
+	const vec4 pixelRadiance = radiance.radiance[pixelIdx];
+	radiance.radiance[pixelIdx] = vec4(0.0, 0.0, 0.0, 0.0);
+
+	PixelSamples samples;
+	samples.sumColor = pixelRadiance.rgb;
+	samples.sumLum = getLuminance(pixelRadiance.rgb);
+	samples.sumLumSq = pixelRadiance.w;
+	samples.numSamples = getPixelNumSamples(pixelCoords);
+
+	accumulatePixel(pixelCoords, samples);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.glsl"
+
+// Each material type gets its own pipeline, so the threads don't diverge on material type
+layout(constant_id = 1) const int shadeMaterialType = MaterialTypeLambert;
+
+// Scatters the paths from the material queue, and puts the surviving ones into the next ray queue
+void main()
+{
+	const int materialQueueIdx = shadeMaterialType - MaterialTypeLambert;
+	const uint queueEntryIdx = gl_GlobalInvocationID.x;
+	if (queueEntryIdx >= counters.materialQueueCounts[materialQueueIdx])
+		return;
+
+	const uint numPaths = getNumPaths();
+	const uint pixelIdx = materialQueues.materialQueues[materialQueueIdx * numPaths + queueEntryIdx];
+
+	PathState pathState = paths.pathStates[pixelIdx];
+	PathHit pathHit = hits.pathHits[pixelIdx];
+
+	HitData hitData;
+	hitData.p = pathHit.pt.xyz;
+	hitData.t = pathHit.pt.w;
+	hitData.n = pathHit.nm.xyz;
+	hitData.materialIndex = int(pathHit.nm.w);
+
+	// Same random sequences as the megakernel `getColor`
+	const ivec2 pixelCoords = getPixelCoords(pixelIdx);
+	SamplerState samplerState = getSamplerState(pixelCoords, getPixelFirstSampleIdx(pixelCoords) + pushConstants.sampleIdx);
+	samplerState.rngState = pathState.rngState;
+	setSamplerBounce(samplerState, pathState.depth);
+
+	Ray inRay = getRay(pathState.rayO.xyz, pathState.rayD.xyz);
+	if (pathState.depth == 0 && pushConstants.sampleIdx == 0)
+	{
+		storePixelSurface(pixelCoords, vec4(hitData.n, hitData.t * length(inRay.D)));
+	}
+
+	Ray outRay;
+	vec3 attenuation;
+	bool needRayCast = materialScatterRay(hitData.materialIndex, inRay, hitData, samplerState, attenuation, outRay);
+
+	pathState.dissipation.rgb *= attenuation;
+	pathState.rayO = vec4(outRay.O, 0.0);
+	pathState.rayD = vec4(outRay.D, 0.0);
+	pathState.depth += 1;
+
+	if (!needRayCast || pathState.depth >= ubo.maxBounces)
+	{
+		terminatePath(pixelIdx, pathState.dissipation.rgb, outRay.D);
+		return;
+	}
+
+	vec3 dissipation = pathState.dissipation.rgb;
+	if (!russianRoulette(dissipation, pathState.depth, samplerState))
+	{
+		addPathContribution(pixelIdx, AMBIENT_COLOR);
+		return;
+	}
+	pathState.dissipation.rgb = dissipation;
+	pathState.rngState = samplerState.rngState;
+
+	paths.pathStates[pixelIdx] = pathState;
+
+	const uint nextRayQueueIdx = 1 - pushConstants.rayQueueIdx;
+	uint rayQueueEntryIdx = atomicAdd(counters.rayQueueCounts[nextRayQueueIdx], 1);
+	rayQueues.rayQueues[nextRayQueueIdx * numPaths + rayQueueEntryIdx] = pixelIdx;
+}
\ No newline at end of file
@@ -0,0 +1,941 @@
+// Kernels are only bit-identical without the FMA contraction, see `simd_kernels.h`
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#include "cpu/pathtracer.h"
+#include "cpu/thread_pool.h"
+#include "cpu/simd_kernels.h"
+#include "cpu/tile_scheduler.h"
+#include "image/ppm.h"
+#include "image/blue_noise.h"
+
+// Code below intentionally follows `pathtracer.glsl` as close as possible, including the function names,
+//	so that any change to the shader integrator could be easily mirrored here
+
+namespace cpu
+{
+	namespace
+	{
+		// Minimal subset of the GLSL vector types and functions used by the integrator
+		struct vec2
+		{
+			float x, y;
+		};
+		struct vec3
+		{
+			float x, y, z;
+		};
+
+		inline vec2 vec2C(float x, float y) { vec2 v = { x, y }; return v; }
+		inline vec3 vec3C(float x, float y, float z) { vec3 v = { x, y, z }; return v; }
+		inline vec3 vec3C(const math::Vec3 & v) { return vec3C(v.x, v.y, v.z); }
+
+		inline vec2 operator + (const vec2 & v0, const vec2 & v1) { return vec2C(v0.x + v1.x, v0.y + v1.y); }
+		inline vec2 operator * (float s, const vec2 & v) { return vec2C(s * v.x, s * v.y); }
+
+		inline vec3 operator + (const vec3 & v0, const vec3 & v1) { return vec3C(v0.x + v1.x, v0.y + v1.y, v0.z + v1.z); }
+		inline vec3 operator - (const vec3 & v0, const vec3 & v1) { return vec3C(v0.x - v1.x, v0.y - v1.y, v0.z - v1.z); }
+		inline vec3 operator - (const vec3 & v) { return vec3C(-v.x, -v.y, -v.z); }
+		inline vec3 operator * (const vec3 & v0, const vec3 & v1) { return vec3C(v0.x * v1.x, v0.y * v1.y, v0.z * v1.z); }
+		inline vec3 operator * (const vec3 & v, float s) { return vec3C(v.x * s, v.y * s, v.z * s); }
+		inline vec3 operator * (float s, const vec3 & v) { return vec3C(s * v.x, s * v.y, s * v.z); }
+		inline vec3 operator / (const vec3 & v, float s) { return vec3C(v.x / s, v.y / s, v.z / s); }
+		inline vec3 & operator += (vec3 & v0, const vec3 & v1) { v0 = v0 + v1; return v0; }
+		inline vec3 & operator *= (vec3 & v0, const vec3 & v1) { v0 = v0 * v1; return v0; }
+		inline vec3 & operator /= (vec3 & v, float s) { v = v / s; return v; }
+
+		inline float dot(const vec2 & v0, const vec2 & v1) { return v0.x * v1.x + v0.y * v1.y; }
+		inline float dot(const vec3 & v0, const vec3 & v1) { return v0.x * v1.x + v0.y * v1.y + v0.z * v1.z; }
+		inline vec3 normalize(const vec3 & v) { return v / sqrtf(dot(v, v)); }
+		inline vec3 reflect(const vec3 & i, const vec3 & n) { return i - 2.0f * dot(n, i) * n; }
+		inline float fract(float x) { return x - floorf(x); }
+		inline float clamp(float x, float minVal, float maxVal) { return std::min(std::max(x, minVal), maxVal); }
+
+		// Counterpart of the UBO, values that are constant during the frame
+		struct FrameConstants
+		{
+			const scene::Sphere * spheres;
+			uint32_t numHitObjects;
+			const scene::Material * materials;
+			uint32_t numMaterials;
+			const scene::BVHNode * nodes;
+			// Sphere geometry duplicated in the layout of the intersection kernels
+			SphereSoA sphereSoA;
+			const SphereKernels * kernels;
+
+			vec3 cameraOrigin;
+			vec3 cameraLowerLeftCorner;
+			vec3 cameraAxisX;
+			vec3 cameraAxisY;
+			vec3 cameraLensX;
+			vec3 cameraLensY;
+
+			uint32_t randomSeed;
+			uint32_t accumStartFrame;
+			uint32_t frameIdx;
+			// Samples each pixel accumulated before the frame, there is no adaptive sampling here
+			uint32_t accumSampleCount;
+			// Interleaved RGBA, `image::c_blueNoiseSize` squared texels
+			const unsigned char * blueNoise;
+			uint32_t samplesPerFrame;
+			uint32_t renderWidth;
+			uint32_t renderHeight;
+			uint32_t maxBounces;
+			uint32_t rrMinDepth;
+		};
+
+		const float _2PI = 6.28318530717958647692f;
+
+		vec3 randInUnitSphere(vec3 rnd)
+		{
+			float angTheta = _2PI*rnd.x;
+			float angPhi = _2PI*rnd.y;
+			float rad = rnd.z;
+
+			return vec3C(rad*sinf(angTheta)*cosf(angPhi), rad*sinf(angTheta)*sinf(angPhi), rad*cosf(angTheta));
+		}
+		vec2 randOnDisk(vec2 rnd)
+		{
+			float ang = _2PI*rnd.x;
+			float rad = rnd.y;
+
+			return vec2C(rad*cosf(ang), rad*sinf(ang));
+		}
+
+		// Sampler, see `sampler.glsl`
+		const uint32_t SAMPLER_PAIR_PIXEL = 0;
+		const uint32_t SAMPLER_PAIR_LENS = 1;
+		const uint32_t SAMPLER_NUM_CAMERA_PAIRS = 2;
+		const uint32_t SAMPLER_BOUNCE_PAIR_DIRECTION = 0;
+		const uint32_t SAMPLER_BOUNCE_PAIR_RADIUS_LOBE = 1;
+		const uint32_t SAMPLER_NUM_BOUNCE_PAIRS = 2;
+		const uint32_t SAMPLER_NUM_SOBOL_BOUNCES = 4;
+
+		struct SamplerState
+		{
+			int pixelX, pixelY;
+			uint32_t sampleIdx;
+			uint32_t seed;
+			uint32_t bounceIdx;
+			uint32_t rngState;
+		};
+
+		inline uint32_t bitfieldReverse(uint32_t x)
+		{
+			x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+			x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+			x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+			x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+			return (x >> 16) | (x << 16);
+		}
+
+		uint32_t hashUint(uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+		uint32_t hashCombine(uint32_t seed, uint32_t value)
+		{
+			return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+		}
+
+		uint32_t pcgHash(uint32_t x)
+		{
+			const uint32_t state = x * 747796405u + 2891336453u;
+			const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+			return (word >> 22u) ^ word;
+		}
+		float getRngFloat(uint32_t & rngState)
+		{
+			const uint32_t word = pcgHash(rngState);
+			rngState = rngState * 747796405u + 2891336453u;
+			return float(word >> 8u) * (1.0f / 16777216.0f);
+		}
+		uint32_t getRngState(const FrameConstants & ubo, uint32_t pixelIdx, uint32_t frameIdx, uint32_t sampleIdx)
+		{
+			return pcgHash(sampleIdx + pcgHash(frameIdx + pcgHash(pixelIdx + pcgHash(ubo.randomSeed))));
+		}
+
+		uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+		{
+			x += seed;
+			x ^= x * 0x6c50b47cu;
+			x ^= x * 0xb82f1e52u;
+			x ^= x * 0xc7afe638u;
+			x ^= x * 0x8d22f6e6u;
+			return x;
+		}
+		uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+		{
+			x = bitfieldReverse(x);
+			x = laineKarrasPermutation(x, seed);
+			x = bitfieldReverse(x);
+			return x;
+		}
+
+		void sobol2D(uint32_t index, uint32_t * pointX, uint32_t * pointY)
+		{
+			*pointX = bitfieldReverse(index);
+			*pointY = 0;
+			uint32_t direction = 0x80000000u;
+			while (index != 0)
+			{
+				if ((index & 1) != 0)
+					*pointY ^= direction;
+				index >>= 1;
+				direction ^= direction >> 1;
+			}
+		}
+
+		SamplerState getSamplerState(const FrameConstants & ubo, int pixelX, int pixelY, uint32_t sampleIdx)
+		{
+			SamplerState samplerState;
+			samplerState.pixelX = pixelX;
+			samplerState.pixelY = pixelY;
+			samplerState.sampleIdx = sampleIdx;
+			samplerState.seed = hashCombine(hashUint(ubo.randomSeed), ubo.accumStartFrame);
+			samplerState.bounceIdx = 0;
+			const uint32_t pixelIdx = uint32_t(pixelY) * ubo.renderWidth + uint32_t(pixelX);
+			samplerState.rngState = getRngState(ubo, pixelIdx, ubo.frameIdx, sampleIdx);
+			return samplerState;
+		}
+		void setSamplerBounce(SamplerState & samplerState, uint32_t bounceIdx)
+		{
+			samplerState.bounceIdx = bounceIdx;
+		}
+
+		vec2 getSample2D(const FrameConstants & ubo, const SamplerState & samplerState, uint32_t pairIdx)
+		{
+			const uint32_t pairSeed = hashCombine(samplerState.seed, pairIdx);
+
+			const uint32_t shuffledIdx = nestedUniformScramble(samplerState.sampleIdx, pairSeed);
+			uint32_t pointX, pointY;
+			sobol2D(shuffledIdx, &pointX, &pointY);
+			pointX = nestedUniformScramble(pointX, hashCombine(pairSeed, 0u));
+			pointY = nestedUniformScramble(pointY, hashCombine(pairSeed, 1u));
+			const vec2 sampleValue = vec2C(float(pointX >> 8) * (1.0f / 16777216.0f), float(pointY >> 8) * (1.0f / 16777216.0f));
+
+			// Same as `texelFetch` of the UNORM texture
+			const int blueNoiseMask = image::c_blueNoiseSize - 1;
+			const uint32_t tileHash = hashUint(pairSeed);
+			const int texelX = (samplerState.pixelX + int(tileHash & blueNoiseMask)) & blueNoiseMask;
+			const int texelY = (samplerState.pixelY + int((tileHash >> 8) & blueNoiseMask)) & blueNoiseMask;
+			const unsigned char * blueNoise = ubo.blueNoise + (texelY * image::c_blueNoiseSize + texelX) * 4 + ((pairIdx & 1) != 0 ? 2 : 0);
+			const vec2 rotation = vec2C(float(blueNoise[0]) / 255.0f, float(blueNoise[1]) / 255.0f);
+
+			return vec2C(fract(sampleValue.x + rotation.x), fract(sampleValue.y + rotation.y));
+		}
+		vec2 getBounceSample2D(const FrameConstants & ubo, SamplerState & samplerState, uint32_t bouncePairIdx)
+		{
+			if (samplerState.bounceIdx >= SAMPLER_NUM_SOBOL_BOUNCES)
+			{
+				vec2 sampleValue;
+				sampleValue.x = getRngFloat(samplerState.rngState);
+				sampleValue.y = getRngFloat(samplerState.rngState);
+				return sampleValue;
+			}
+			return getSample2D(ubo, samplerState, SAMPLER_NUM_CAMERA_PAIRS + samplerState.bounceIdx * SAMPLER_NUM_BOUNCE_PAIRS + bouncePairIdx);
+		}
+		float getBounceSample1D(SamplerState & samplerState)
+		{
+			return getRngFloat(samplerState.rngState);
+		}
+
+		vec3 getBounceRandInUnitSphere(const FrameConstants & ubo, SamplerState & samplerState)
+		{
+			const vec2 rndAngles = getBounceSample2D(ubo, samplerState, SAMPLER_BOUNCE_PAIR_DIRECTION);
+			const float rndRadius = getBounceSample2D(ubo, samplerState, SAMPLER_BOUNCE_PAIR_RADIUS_LOBE).x;
+			return randInUnitSphere(vec3C(rndAngles.x, rndAngles.y, rndRadius));
+		}
+
+		struct Ray
+		{
+			vec3 O;
+			vec3 D;
+		};
+
+		Ray getRay(vec3 O, vec3 D)
+		{
+			Ray r;
+			r.O = O;
+			r.D = D;
+			return r;
+		}
+
+		vec3 getRayPoint(const Ray & ray, float t)
+		{
+			return ray.O + t * ray.D;
+		}
+
+		struct HitData
+		{
+			vec3 p;
+			vec3 n;
+			float t;
+			int materialIndex;
+		};
+
+		// Ray-sphere intersection itself is in `simd_kernels.cpp`, see `hitSphere` in `pathtracer.glsl` for the derivation
+		HitData getSphereHitData(const FrameConstants & ubo, const Ray & r, int sphereIdx, float t)
+		{
+			const scene::Sphere & sphere = ubo.spheres[sphereIdx];
+
+			HitData hitData;
+			hitData.t = t;
+			hitData.p = getRayPoint(r, t);
+			hitData.n = (hitData.p - vec3C(sphere.center)) / sphere.radius;
+			hitData.materialIndex = sphere.materialIndex;
+			return hitData;
+		}
+
+		bool refract(vec3 v, vec3 n, float ni_over_nt, vec3 & outV)
+		{
+			vec3 v_nrm = normalize(v);
+			float vdotn = dot(v_nrm, n);
+			float discriminant = 1.0f - ni_over_nt*ni_over_nt * (1.0f - vdotn*vdotn);
+			if (discriminant <= 0)
+				return false;
+
+			outV = ni_over_nt * (v_nrm - vdotn*n) - n*sqrtf(discriminant);
+			return true;
+		}
+
+		float schlick(float cosine, float refIdx)
+		{
+			float r0 = (1.0f - refIdx) / (1.0f + refIdx);
+			r0 = r0*r0;
+			float one_minus_cos = 1.0f - cosine;
+			float one_minus_cos_sq = one_minus_cos*one_minus_cos;
+			return r0 + (1.0f - r0) * one_minus_cos*one_minus_cos_sq*one_minus_cos_sq;
+		}
+
+		bool materialScatterRay(const FrameConstants & ubo, int materialIndex, const Ray & inR, const HitData & hitData, SamplerState & samplerState, vec3 & attenuation, Ray & outR)
+		{
+			if (materialIndex >= int(ubo.numMaterials) || materialIndex < 0)
+				return false;
+
+			const scene::Material & material = ubo.materials[materialIndex];
+
+			if (material.type == scene::MaterialType::eLambert)
+			{
+				vec3 target = hitData.p + hitData.n + getBounceRandInUnitSphere(ubo, samplerState);
+				outR.O = hitData.p;
+				outR.D = target - hitData.p;
+				attenuation = vec3C(material.albedo);
+				return true;
+			}
+			else if (material.type == scene::MaterialType::eMetal)
+			{
+				vec3 reflected = reflect(normalize(inR.D), hitData.n);
+				outR.O = hitData.p;
+				outR.D = reflected + material.roughness*getBounceRandInUnitSphere(ubo, samplerState);
+				attenuation = vec3C(material.albedo);
+				return (dot(outR.D, hitData.n) > 0);
+			}
+			else if (material.type == scene::MaterialType::eGlass)
+			{
+				vec3 rayD_nrm = normalize(inR.D);
+				vec3 reflected = reflect(rayD_nrm, hitData.n);
+				float ni_over_nt;
+				attenuation = vec3C(material.albedo);
+
+				const float refIdx = material.refIdx;
+
+				vec3 outNormal;
+				float cosine;
+				if (dot(rayD_nrm, hitData.n) > 0)
+				{
+					outNormal = -hitData.n;
+					ni_over_nt = refIdx;
+					cosine = refIdx*dot(rayD_nrm, hitData.n);
+				}
+				else
+				{
+					outNormal = hitData.n;
+					ni_over_nt = 1.0f / refIdx;
+					cosine = -dot(rayD_nrm, hitData.n);
+				}
+
+				vec3 refracted = vec3C(0.0f, 0.0f, 0.0f);
+				float reflProb;
+				if (refract(rayD_nrm, outNormal, ni_over_nt, refracted))
+				{
+					reflProb = schlick(cosine, refIdx);
+				}
+				else
+				{
+					reflProb = 1.0f;
+				}
+
+				if (getBounceSample2D(ubo, samplerState, SAMPLER_BOUNCE_PAIR_RADIUS_LOBE).y > reflProb)
+				{
+					outR.O = hitData.p;
+					outR.D = refracted + material.roughness*getBounceRandInUnitSphere(ubo, samplerState);
+					return true;
+				}
+				else
+				{
+					outR.O = hitData.p;
+					outR.D = reflected;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Returns distance to the box entry point, or t_max if the box is missed or farther than t_max
+		float hitAABB(const float boundsMin[3], const float boundsMax[3], vec3 rayO, vec3 rayInvD, float t_min, float t_max)
+		{
+			const float rayOArr[3] = { rayO.x, rayO.y, rayO.z };
+			const float rayInvDArr[3] = { rayInvD.x, rayInvD.y, rayInvD.z };
+
+			float tEnter = t_min;
+			float tExit = t_max;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float t0 = (boundsMin[axis] - rayOArr[axis]) * rayInvDArr[axis];
+				float t1 = (boundsMax[axis] - rayOArr[axis]) * rayInvDArr[axis];
+				tEnter = std::max(tEnter, std::min(t0, t1));
+				tExit = std::min(tExit, std::max(t0, t1));
+			}
+			return (tEnter <= tExit) ? tEnter : t_max;
+		}
+
+		// Zero direction components are replaced with the tiny ones, otherwise the slab test multiplies
+		//	the zero distances to the slab (ray origin on the box face) by the infinity and gets NaN
+		vec3 getSafeInvD(vec3 D)
+		{
+			const float eps = 1e-20f;
+			auto safeInv = [eps](float d) { return 1.0f / ((fabsf(d) > eps) ? d : ((d < 0.0f) ? -eps : eps)); };
+			return vec3C(safeInv(D.x), safeInv(D.y), safeInv(D.z));
+		}
+
+		// Builder limits the BVH depth, so the stack is never full
+		const int BVH_STACK_SIZE = scene::c_bvhMaxDepth;
+
+		bool hitWorld(const FrameConstants & ubo, const Ray & r, HitData & hitData)
+		{
+			const float t_min = 0.00001f;
+			const float t_max = 10000.0f;
+
+			int closestSphereIdx = -1;
+			float closestHit = t_max;
+
+			if (ubo.numHitObjects == 0)
+				return false;
+
+			const vec3 rayInvD = getSafeInvD(r.D);
+			const float rayO[3] = { r.O.x, r.O.y, r.O.z };
+			const float rayD[3] = { r.D.x, r.D.y, r.D.z };
+
+			const scene::BVHNode * nodes = ubo.nodes;
+			if (hitAABB(nodes[0].boundsMin, nodes[0].boundsMax, r.O, rayInvD, t_min, closestHit) >= closestHit)
+				return false;
+
+			int stack[BVH_STACK_SIZE];
+			float stackT[BVH_STACK_SIZE];
+			int stackSize = 0;
+			int nodeIdx = 0;
+			while (true)
+			{
+				const scene::BVHNode & node = nodes[nodeIdx];
+				if (node.count > 0)
+				{
+					float leafClosestHit;
+					const int leafClosestSphereIdx = ubo.kernels->hitSpheres(ubo.sphereSoA, node.rightOrFirst, node.count, rayO, rayD, t_min, closestHit, &leafClosestHit);
+					if (leafClosestSphereIdx >= 0)
+					{
+						closestSphereIdx = leafClosestSphereIdx;
+						closestHit = leafClosestHit;
+					}
+				}
+				else
+				{
+					int childNear = nodeIdx + 1;
+					int childFar = node.rightOrFirst;
+					float tNear = hitAABB(nodes[childNear].boundsMin, nodes[childNear].boundsMax, r.O, rayInvD, t_min, closestHit);
+					float tFar = hitAABB(nodes[childFar].boundsMin, nodes[childFar].boundsMax, r.O, rayInvD, t_min, closestHit);
+					if (tFar < tNear)
+					{
+						std::swap(childNear, childFar);
+						std::swap(tNear, tFar);
+					}
+
+					if (tNear < closestHit)
+					{
+						if (tFar < closestHit)
+						{
+							assert(stackSize < BVH_STACK_SIZE);
+							stack[stackSize] = childFar;
+							stackT[stackSize] = tFar;
+							++stackSize;
+						}
+						nodeIdx = childNear;
+						continue;
+					}
+				}
+
+				nodeIdx = -1;
+				while (stackSize > 0)
+				{
+					--stackSize;
+					if (stackT[stackSize] < closestHit)
+					{
+						nodeIdx = stack[stackSize];
+						break;
+					}
+				}
+				if (nodeIdx < 0)
+					break;
+			}
+
+			if (closestSphereIdx < 0)
+				return false;
+
+			hitData = getSphereHitData(ubo, r, closestSphereIdx, closestHit);
+			return true;
+		}
+
+		// Same as `hitWorld` for each ray of the packet selected by `rayMask`, but the BVH is traversed once
+		//	for the whole packet: node is visited if any of the rays hits it, and the leaf spheres are tested
+		//	against all such rays at once; returns mask of the rays that hit anything
+		uint32_t hitWorldPacket(const FrameConstants & ubo, const Ray * rays, const RayPacket & packet, uint32_t rayMask, HitData * hitData)
+		{
+			const float t_min = 0.00001f;
+			const float t_max = 10000.0f;
+
+			if (ubo.numHitObjects == 0 || rayMask == 0)
+				return 0;
+
+			alignas(64) float closestHit[c_maxRayPacketSize];
+			int closestSphereIdx[c_maxRayPacketSize];
+			vec3 rayInvD[c_maxRayPacketSize];
+			for (int rayIdx = 0; rayIdx < c_maxRayPacketSize; ++rayIdx)
+			{
+				closestHit[rayIdx] = t_max;
+				closestSphereIdx[rayIdx] = -1;
+				if (rayMask & (1u << rayIdx))
+				{
+					rayInvD[rayIdx] = getSafeInvD(rays[rayIdx].D);
+				}
+			}
+
+			// Rays that hit the node bounds closer than their current closest hit, `minT` receives the nearest entry
+			auto getNodeRayMask = [&](const scene::BVHNode & node, uint32_t nodeRayMask, float * minT)
+			{
+				uint32_t hitRayMask = 0;
+				for (int rayIdx = 0; rayIdx < c_maxRayPacketSize; ++rayIdx)
+				{
+					if ((nodeRayMask & (1u << rayIdx)) == 0)
+						continue;
+
+					float t = hitAABB(node.boundsMin, node.boundsMax, rays[rayIdx].O, rayInvD[rayIdx], t_min, closestHit[rayIdx]);
+					if (t < closestHit[rayIdx])
+					{
+						if (minT)
+						{
+							*minT = std::min(*minT, t);
+						}
+						hitRayMask |= (1u << rayIdx);
+					}
+				}
+				return hitRayMask;
+			};
+
+			const scene::BVHNode * nodes = ubo.nodes;
+
+			int stack[BVH_STACK_SIZE];
+			uint32_t stackRayMask[BVH_STACK_SIZE];
+			int stackSize = 0;
+
+			int nodeIdx = 0;
+			uint32_t nodeRayMask = getNodeRayMask(nodes[0], rayMask, nullptr);
+			while (true)
+			{
+				const scene::BVHNode & node = nodes[nodeIdx];
+				if (nodeRayMask == 0)
+				{
+					// Nothing to do in this node
+				}
+				else if (node.count > 0)
+				{
+					const int leafEnd = node.rightOrFirst + node.count;
+					for (int sphereIdx = node.rightOrFirst; sphereIdx < leafEnd; ++sphereIdx)
+					{
+						const scene::Sphere & sphere = ubo.spheres[sphereIdx];
+						const float center[3] = { sphere.center.x, sphere.center.y, sphere.center.z };
+						uint32_t sphereRayMask = ubo.kernels->hitSpherePacket(packet, nodeRayMask, center, sphere.radius, t_min, closestHit);
+						for (int rayIdx = 0; sphereRayMask != 0; ++rayIdx, sphereRayMask >>= 1)
+						{
+							if (sphereRayMask & 1)
+							{
+								closestSphereIdx[rayIdx] = sphereIdx;
+							}
+						}
+					}
+				}
+				else
+				{
+					// Child with the nearest entry point across the rays goes first
+					int childNear = nodeIdx + 1;
+					int childFar = node.rightOrFirst;
+					float tNear = t_max, tFar = t_max;
+					uint32_t nearRayMask = getNodeRayMask(nodes[childNear], nodeRayMask, &tNear);
+					uint32_t farRayMask = getNodeRayMask(nodes[childFar], nodeRayMask, &tFar);
+					if (farRayMask != 0 && (nearRayMask == 0 || tFar < tNear))
+					{
+						std::swap(childNear, childFar);
+						std::swap(nearRayMask, farRayMask);
+					}
+
+					if (nearRayMask != 0)
+					{
+						if (farRayMask != 0)
+						{
+							assert(stackSize < BVH_STACK_SIZE);
+							stack[stackSize] = childFar;
+							stackRayMask[stackSize] = farRayMask;
+							++stackSize;
+						}
+						nodeIdx = childNear;
+						nodeRayMask = nearRayMask;
+						continue;
+					}
+				}
+
+				if (stackSize == 0)
+					break;
+
+				// Rays could have found closer hits since the node was pushed
+				--stackSize;
+				nodeIdx = stack[stackSize];
+				nodeRayMask = getNodeRayMask(nodes[nodeIdx], stackRayMask[stackSize], nullptr);
+			}
+
+			uint32_t hitRayMask = 0;
+			for (int rayIdx = 0; rayIdx < c_maxRayPacketSize; ++rayIdx)
+			{
+				if (closestSphereIdx[rayIdx] < 0)
+					continue;
+
+				hitData[rayIdx] = getSphereHitData(ubo, rays[rayIdx], closestSphereIdx[rayIdx], closestHit[rayIdx]);
+				hitRayMask |= (1u << rayIdx);
+			}
+			return hitRayMask;
+		}
+
+		const vec3 AMBIENT_COLOR = { 0.1f, 0.1f, 0.1f };
+
+		vec3 getPathTerminationColor(vec3 dissipation, vec3 rayD)
+		{
+			vec3 nrmD = normalize(rayD);
+			float t = clamp(0.5f*(nrmD.y + 1.0f), 0.0f, 1.0f);
+			return dissipation*((1-t)*vec3C(1.0f, 1.0f, 1.0f) + t*vec3C(0.5f, 0.7f, 1.0f)) + AMBIENT_COLOR;
+		}
+
+		bool russianRoulette(const FrameConstants & ubo, vec3 & dissipation, uint32_t depth, SamplerState & samplerState)
+		{
+			if (depth < ubo.rrMinDepth)
+				return true;
+
+			float survivalProb = std::min(std::max(dissipation.x, std::max(dissipation.y, dissipation.z)), 0.95f);
+			if (survivalProb <= 0.0f || getBounceSample1D(samplerState) >= survivalProb)
+				return false;
+
+			dissipation /= survivalProb;
+			return true;
+		}
+
+		// Primary ray hit is supplied by the caller, so that the primary rays could be traced in packets
+		vec3 getColorWithPrimaryHit(const FrameConstants & ubo, const Ray & r, bool isPrimaryHit, const HitData & primaryHitData, SamplerState samplerState)
+		{
+			Ray curRay = r;
+			bool needRayCast = true;
+			HitData hitData = primaryHitData;
+			float recastCount = 0.0f;
+
+			vec3 dissipation = vec3C(1.0f, 1.0f, 1.0f);
+
+			while (needRayCast)
+			{
+				recastCount += 1.0f;
+				if (recastCount > float(ubo.maxBounces))
+					break;
+
+				bool isAnythingHit = (recastCount == 1.0f) ? isPrimaryHit : hitWorld(ubo, curRay, hitData);
+				if (isAnythingHit)
+				{
+					Ray inRay = curRay;
+					vec3 attenuation = vec3C(1.0f, 1.0f, 1.0f);
+					setSamplerBounce(samplerState, uint32_t(recastCount) - 1);
+					needRayCast = materialScatterRay(ubo, hitData.materialIndex, inRay, hitData, samplerState, attenuation, curRay);
+					dissipation *= attenuation;
+
+					const uint32_t depth = uint32_t(recastCount);
+					if (needRayCast && depth < ubo.maxBounces && !russianRoulette(ubo, dissipation, depth, samplerState))
+					{
+						return AMBIENT_COLOR;
+					}
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			return getPathTerminationColor(dissipation, curRay.D);
+		}
+
+		Ray generateCameraRay(const FrameConstants & ubo, vec2 uv, const SamplerState & samplerState)
+		{
+			const float width = float(ubo.renderWidth);
+			const float height = float(ubo.renderHeight);
+
+			vec3 origin = ubo.cameraOrigin;
+			vec3 llc = ubo.cameraLowerLeftCorner;
+			vec3 axisX = ubo.cameraAxisX;
+			vec3 axisY = ubo.cameraAxisY;
+
+			vec2 rndDisk = randOnDisk(getSample2D(ubo, samplerState, SAMPLER_PAIR_LENS));
+			vec3 offset = ubo.cameraLensX*rndDisk.x + ubo.cameraLensY*rndDisk.y;
+			vec2 rndJitter = getSample2D(ubo, samplerState, SAMPLER_PAIR_PIXEL);
+			vec3 rayTarget = llc + (uv.x + rndJitter.x/width) * axisX + (uv.y + rndJitter.y/height) * axisY;
+			return getRay(origin + offset, rayTarget - origin - offset);
+		}
+
+		// Sum of the frame samples for the pixel
+		vec3 tracePixel(const FrameConstants & ubo, int pixelX, int pixelY, vec2 uv)
+		{
+			const int numSubSamples = int(ubo.samplesPerFrame);
+			vec3 color = vec3C(0.0f, 0.0f, 0.0f);
+
+			// Camera rays of the pixel are coherent, so they are traced in packets; the rest of the path is scalar
+			for (int packetBeg = 0; packetBeg < numSubSamples; packetBeg += c_maxRayPacketSize)
+			{
+				const int packetSize = std::min(numSubSamples - packetBeg, c_maxRayPacketSize);
+				const uint32_t packetRayMask = (1u << packetSize) - 1;
+
+				Ray rays[c_maxRayPacketSize];
+				SamplerState samplerStates[c_maxRayPacketSize];
+				RayPacket packet = {};
+				for (int rayIdx = 0; rayIdx < packetSize; ++rayIdx)
+				{
+					samplerStates[rayIdx] = getSamplerState(ubo, pixelX, pixelY, ubo.accumSampleCount + uint32_t(packetBeg + rayIdx));
+					Ray r = generateCameraRay(ubo, uv, samplerStates[rayIdx]);
+					rays[rayIdx] = r;
+					packet.originX[rayIdx] = r.O.x;
+					packet.originY[rayIdx] = r.O.y;
+					packet.originZ[rayIdx] = r.O.z;
+					packet.dirX[rayIdx] = r.D.x;
+					packet.dirY[rayIdx] = r.D.y;
+					packet.dirZ[rayIdx] = r.D.z;
+				}
+
+				HitData primaryHitData[c_maxRayPacketSize] = {};
+				const uint32_t primaryHitMask = hitWorldPacket(ubo, rays, packet, packetRayMask, primaryHitData);
+
+				for (int rayIdx = 0; rayIdx < packetSize; ++rayIdx)
+				{
+					const bool isPrimaryHit = (primaryHitMask & (1u << rayIdx)) != 0;
+					color += getColorWithPrimaryHit(ubo, rays[rayIdx], isPrimaryHit, primaryHitData[rayIdx], samplerStates[rayIdx]);
+				}
+			}
+			return color;
+		}
+	}
+
+	PathTracer::PathTracer()
+	{
+		image::generateBlueNoise(image::c_blueNoiseSize, 4, 0, &m_blueNoise);
+	}
+
+	void PathTracer::setScene(const scene::Scene & scene, const scene::BVHBuildParams & bvhBuildParams)
+	{
+		std::vector<uint32_t> primIndices;
+		scene::buildBVH(scene.spheres, bvhBuildParams, &m_bvhNodes, &primIndices);
+
+		m_spheres.resize(primIndices.size());
+		for (size_t primIdx = 0, primIdxEnd = primIndices.size(); primIdx < primIdxEnd; ++primIdx)
+		{
+			m_spheres[primIdx] = scene.spheres[primIndices[primIdx]];
+		}
+		m_materials = scene.materials;
+
+		const size_t numSpheresPadded = m_spheres.size() + c_sphereSoAPadding;
+		m_sphereCenterX.assign(numSpheresPadded, 0.0f);
+		m_sphereCenterY.assign(numSpheresPadded, 0.0f);
+		m_sphereCenterZ.assign(numSpheresPadded, 0.0f);
+		m_sphereRadius.assign(numSpheresPadded, 0.0f);
+		for (size_t sphereIdx = 0, sphereIdxEnd = m_spheres.size(); sphereIdx < sphereIdxEnd; ++sphereIdx)
+		{
+			const scene::Sphere & sphere = m_spheres[sphereIdx];
+			m_sphereCenterX[sphereIdx] = sphere.center.x;
+			m_sphereCenterY[sphereIdx] = sphere.center.y;
+			m_sphereCenterZ[sphereIdx] = sphere.center.z;
+			m_sphereRadius[sphereIdx] = sphere.radius;
+		}
+	}
+
+	void PathTracer::setCamera(const scene::Camera & camera)
+	{
+		scene::computeCameraRayGenParams(camera, &m_cameraRayGenParams);
+	}
+
+	void PathTracer::render(const RenderParams & params, ThreadPool * threadPool, std::vector<float> * pixels, RenderStats * stats) const
+	{
+		if (pixels == nullptr || params.width <= 0 || params.height <= 0)
+			return;
+
+		const int width = params.width;
+		const int height = params.height;
+		pixels->assign((size_t)width * height * 3, 0.0f);
+
+		FrameConstants ubo;
+		ubo.spheres = m_spheres.data();
+		ubo.numHitObjects = (uint32_t)m_spheres.size();
+		ubo.materials = m_materials.data();
+		ubo.numMaterials = (uint32_t)m_materials.size();
+		ubo.nodes = m_bvhNodes.data();
+		ubo.sphereSoA.centerX = m_sphereCenterX.data();
+		ubo.sphereSoA.centerY = m_sphereCenterY.data();
+		ubo.sphereSoA.centerZ = m_sphereCenterZ.data();
+		ubo.sphereSoA.radius = m_sphereRadius.data();
+		ubo.kernels = &getSphereKernels(params.isa);
+		ubo.cameraOrigin = vec3C(m_cameraRayGenParams.origin);
+		ubo.cameraLowerLeftCorner = vec3C(m_cameraRayGenParams.lowerLeftCorner);
+		ubo.cameraAxisX = vec3C(m_cameraRayGenParams.axisX);
+		ubo.cameraAxisY = vec3C(m_cameraRayGenParams.axisY);
+		ubo.cameraLensX = vec3C(m_cameraRayGenParams.lensX);
+		ubo.cameraLensY = vec3C(m_cameraRayGenParams.lensY);
+		ubo.randomSeed = params.randomSeed;
+		// Single accumulation, started by the first frame
+		ubo.accumStartFrame = 0;
+		ubo.blueNoise = m_blueNoise.data();
+		ubo.samplesPerFrame = params.samplesPerFrame;
+		ubo.renderWidth = (uint32_t)width;
+		ubo.renderHeight = (uint32_t)height;
+		ubo.maxBounces = params.maxBounces;
+		ubo.rrMinDepth = params.rrMinDepth;
+
+		typedef std::chrono::steady_clock Clock;
+		auto getElapsedMS = [](Clock::time_point start, Clock::time_point end)
+		{
+			return std::chrono::duration<double, std::milli>(end - start).count();
+		};
+
+		const int numThreads = (threadPool != nullptr) ? threadPool->getNumThreads() : 1;
+
+		TileScheduler tileScheduler;
+		tileScheduler.init(width, height, params.tileWidth, params.tileHeight, numThreads, params.isWorkStealingEnabled);
+
+		std::vector<double> threadBusyTimesMS(numThreads, 0.0);
+
+		float * pixelData = pixels->data();
+		auto renderTiles = [&ubo, &tileScheduler, &threadBusyTimesMS, &getElapsedMS, width, height, pixelData](int threadIdx)
+		{
+			// Accumulated locally, so that the threads don't write into the same cache line after each tile
+			double busyTimeMS = 0.0;
+
+			Tile tile;
+			while (tileScheduler.getNextTile(threadIdx, &tile))
+			{
+				const Clock::time_point tileStart = Clock::now();
+				for (int y = tile.y0; y < tile.y1; ++y)
+				{
+					for (int x = tile.x0; x < tile.x1; ++x)
+					{
+						// Match the texture coordinates of the fullscreen quad: pixel centers, with V pointing up
+						vec2 uv = vec2C((x + 0.5f) / float(width), 1.0f - (y + 0.5f) / float(height));
+						vec3 color = tracePixel(ubo, x, y, uv);
+
+						float * pixel = pixelData + ((size_t)y * width + x) * 3;
+						pixel[0] += color.x;
+						pixel[1] += color.y;
+						pixel[2] += color.z;
+					}
+				}
+				busyTimeMS += getElapsedMS(tileStart, Clock::now());
+			}
+			threadBusyTimesMS[threadIdx] += busyTimeMS;
+		};
+
+		const Clock::time_point renderStart = Clock::now();
+		for (int frameIdx = 0; frameIdx < params.numFrames; ++frameIdx)
+		{
+			ubo.frameIdx = (uint32_t)frameIdx;
+			ubo.accumSampleCount = (uint32_t)frameIdx * params.samplesPerFrame;
+
+			tileScheduler.reset();
+			if (threadPool == nullptr)
+			{
+				renderTiles(0);
+				continue;
+			}
+
+			threadPool->run(
+				[&renderTiles](int threadIdx, int)
+				{
+					renderTiles(threadIdx);
+				}
+				);
+		}
+		const double totalTimeMS = getElapsedMS(renderStart, Clock::now());
+
+		if (stats)
+		{
+			// Everything that isn't spent on the tiles is the time thread waits for the frame to finish
+			stats->totalTimeMS = totalTimeMS;
+			stats->threads.resize(numThreads);
+			for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+			{
+				const TileScheduler::ThreadStats & schedulerStats = tileScheduler.getThreadStats(threadIdx);
+
+				RenderThreadStats & threadStats = stats->threads[threadIdx];
+				threadStats.busyTimeMS = threadBusyTimesMS[threadIdx];
+				threadStats.idleTimeMS = std::max(totalTimeMS - threadBusyTimesMS[threadIdx], 0.0);
+				threadStats.numTiles = schedulerStats.numTiles;
+				threadStats.numStolenTiles = schedulerStats.numStolenTiles;
+				threadStats.numSteals = schedulerStats.numSteals;
+			}
+		}
+
+		const uint64_t numSamples = (uint64_t)std::max(params.numFrames, 1) * params.samplesPerFrame;
+		const float invNumSamples = (numSamples > 0) ? 1.0f / (float)numSamples : 0.0f;
+		for (float & value : *pixels)
+		{
+			value *= invNumSamples;
+		}
+	}
+
+	bool saveImagePPM(const char * filename, int width, int height, const std::vector<float> & pixels)
+	{
+		if (width <= 0 || height <= 0 || pixels.size() < (size_t)width * height * 3)
+		{
+			printf("Wrong image supplied to the saveImagePPM!\n");
+			return false;
+		}
+
+		std::vector<unsigned char> imageData(pixels.size());
+		for (size_t valueIdx = 0, valueIdxEnd = pixels.size(); valueIdx < valueIdxEnd; ++valueIdx)
+		{
+			imageData[valueIdx] = (unsigned char)(clamp(pixels[valueIdx], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+
+		return image::writePPM(filename, width, height, 3, imageData.data());
+	}
+}
\ No newline at end of file
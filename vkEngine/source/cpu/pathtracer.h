@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "scene/camera.h"
+#include "scene/scene.h"
+#include "scene/bvh.h"
+#include "cpu/simd_kernels.h"
+
+namespace cpu
+{
+	class ThreadPool;
+
+	struct RenderParams
+	{
+		int width = 800;
+		int height = 600;
+		// Frames are accumulated the same way the GPU backends do, each frame continues the sample sequences
+		int numFrames = 1;
+		uint32_t samplesPerFrame = 32;
+		// See `vulkan::Wrapper::m_maxBounces` and `m_russianRouletteMinDepth`
+		uint32_t maxBounces = 16;
+		uint32_t rrMinDepth = 3;
+		// See `vulkan::Wrapper::m_randomSeed`
+		uint32_t randomSeed = 0;
+		// Instruction set of the intersection kernels, capped by the one the CPU supports
+		SimdIsa isa = SimdIsa::eAuto;
+		// Image is split into tiles that threads pick up dynamically, see `TileScheduler`
+		int tileWidth = 16;
+		int tileHeight = 16;
+		// Disabling the stealing turns the scheduling static, which is mostly useful to measure the difference
+		bool isWorkStealingEnabled = true;
+	};
+
+	struct RenderThreadStats
+	{
+		// Time spent rendering the tiles
+		double busyTimeMS = 0.0;
+		// Time spent waiting for the other threads to finish the frame
+		double idleTimeMS = 0.0;
+		uint32_t numTiles = 0;
+		uint32_t numStolenTiles = 0;
+		uint32_t numSteals = 0;
+	};
+
+	struct RenderStats
+	{
+		double totalTimeMS = 0.0;
+		std::vector<RenderThreadStats> threads;
+	};
+
+	// Reference path tracer, mirrors `pathtracer.glsl`: intersection routines, materials, path termination,
+	//	camera model and even the random number generator are the same, so that its output could be compared
+	//	against the GPU backends on the machines without any GPU
+	class PathTracer
+	{
+	public:
+		// Generates the sampler blue noise, same as `vulkan::Wrapper::initTextureImage`
+		PathTracer();
+
+		// Builds the BVH, same as `vulkan::Wrapper::uploadScene`
+		void setScene(const scene::Scene & scene, const scene::BVHBuildParams & bvhBuildParams = scene::BVHBuildParams());
+		void setCamera(const scene::Camera & camera);
+
+		// Renders RGB float image, top row first; image tiles are distributed between the threads of the pool,
+		//	`threadPool` could be nullptr, in which case the image is rendered on the calling thread;
+		//	`stats` is optional, and receives per-thread utilization
+		void render(const RenderParams & params, ThreadPool * threadPool, std::vector<float> * pixels, RenderStats * stats = nullptr) const;
+
+	private:
+		// Spheres are reordered to match the BVH leaves
+		std::vector<scene::Sphere> m_spheres;
+		std::vector<scene::Material> m_materials;
+		std::vector<scene::BVHNode> m_bvhNodes;
+		// Same spheres in the layout of the intersection kernels, see `SphereSoA`
+		std::vector<float> m_sphereCenterX;
+		std::vector<float> m_sphereCenterY;
+		std::vector<float> m_sphereCenterZ;
+		std::vector<float> m_sphereRadius;
+		scene::CameraRayGenParams m_cameraRayGenParams = {};
+		// Sampler Cranley-Patterson rotations, RGBA
+		std::vector<unsigned char> m_blueNoise;
+	};
+
+	// Converts the float RGB image into 8 bits per channel the same way the UNORM render target does,
+	//	and saves it as PPM file
+	bool saveImagePPM(const char * filename, int width, int height, const std::vector<float> & pixels);
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include <math.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include "cpu/simd_kernels.h"
+
+namespace cpu
+{
+	// Defined in the translation units compiled with the corresponding instruction set enabled,
+	//	return nullptr if the compiler doesn't support the instruction set
+	const SphereKernels * getSphereKernelsAVX2();
+	const SphereKernels * getSphereKernelsAVX512();
+
+	namespace
+	{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+		void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+		{
+#if defined(_MSC_VER)
+			int cpuInfo[4];
+			__cpuidex(cpuInfo, (int)leaf, (int)subleaf);
+			for (int regIdx = 0; regIdx < 4; ++regIdx)
+			{
+				regs[regIdx] = (uint32_t)cpuInfo[regIdx];
+			}
+#else
+			__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		}
+
+		// Register state the OS saves on the context switch
+		uint64_t getXCR0()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t eax, edx;
+			__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return ((uint64_t)edx << 32) | eax;
+#endif
+		}
+
+		SimdIsa detectSimdIsaImpl()
+		{
+			uint32_t regs[4];
+			cpuid(0, 0, regs);
+			const uint32_t maxLeaf = regs[0];
+			if (maxLeaf < 7)
+				return SimdIsa::eScalar;
+
+			cpuid(1, 0, regs);
+			const bool hasOSXSAVE = (regs[2] & (1u << 27)) != 0;
+			const bool hasAVX = (regs[2] & (1u << 28)) != 0;
+			if (!hasOSXSAVE || !hasAVX)
+				return SimdIsa::eScalar;
+
+			// XMM and YMM state
+			const uint64_t xcr0 = getXCR0();
+			if ((xcr0 & 0x06) != 0x06)
+				return SimdIsa::eScalar;
+
+			cpuid(7, 0, regs);
+			const bool hasAVX2 = (regs[1] & (1u << 5)) != 0;
+			const bool hasAVX512F = (regs[1] & (1u << 16)) != 0;
+			if (!hasAVX2)
+				return SimdIsa::eScalar;
+
+			// Opmask, upper halves of ZMM0-15 and ZMM16-31 state
+			if (hasAVX512F && (xcr0 & 0xE6) == 0xE6)
+				return SimdIsa::eAVX512;
+
+			return SimdIsa::eAVX2;
+		}
+#else
+		SimdIsa detectSimdIsaImpl()
+		{
+			return SimdIsa::eScalar;
+		}
+#endif
+
+		// Same as `hitSphere` in the `pathtracer.glsl`, returns t_max if the sphere isn't hit
+		inline float hitSphereT(float centerX, float centerY, float centerZ, float radius, const float rayO[3], const float rayD[3], float t_min, float t_max)
+		{
+			const float rayO2sphCX = rayO[0] - centerX;
+			const float rayO2sphCY = rayO[1] - centerY;
+			const float rayO2sphCZ = rayO[2] - centerZ;
+			const float a = rayD[0]*rayD[0] + rayD[1]*rayD[1] + rayD[2]*rayD[2];
+			const float b = 2.0f * (rayD[0]*rayO2sphCX + rayD[1]*rayO2sphCY + rayD[2]*rayO2sphCZ);
+			const float c = (rayO2sphCX*rayO2sphCX + rayO2sphCY*rayO2sphCY + rayO2sphCZ*rayO2sphCZ) - radius*radius;
+			const float discriminant = b*b - 4*a*c;
+
+			if (discriminant < 0)
+				return t_max;
+
+			const float sqrtD_div2a = sqrtf(discriminant) / (2*a);
+			const float negB_div2a = -b / (2*a);
+
+			const float hitT1 = negB_div2a - sqrtD_div2a;
+			if (hitT1 > t_min && hitT1 < t_max)
+				return hitT1;
+
+			const float hitT2 = negB_div2a + sqrtD_div2a;
+			if (hitT2 > t_min && hitT2 < t_max)
+				return hitT2;
+
+			return t_max;
+		}
+
+		int hitSpheresScalar(const SphereSoA & spheres, int first, int count, const float rayO[3], const float rayD[3], float t_min, float t_max, float * hitT)
+		{
+			int closestSphereIdx = -1;
+			float closestHit = t_max;
+			for (int sphereIdx = first, sphereIdxEnd = first + count; sphereIdx < sphereIdxEnd; ++sphereIdx)
+			{
+				const float t = hitSphereT(spheres.centerX[sphereIdx], spheres.centerY[sphereIdx], spheres.centerZ[sphereIdx], spheres.radius[sphereIdx], rayO, rayD, t_min, closestHit);
+				if (t < closestHit)
+				{
+					closestHit = t;
+					closestSphereIdx = sphereIdx;
+				}
+			}
+			*hitT = closestHit;
+			return closestSphereIdx;
+		}
+
+		uint32_t hitSpherePacketScalar(const RayPacket & rays, uint32_t rayMask, const float center[3], float radius, float t_min, float * hitT)
+		{
+			uint32_t hitMask = 0;
+			for (int rayIdx = 0; rayIdx < c_maxRayPacketSize; ++rayIdx)
+			{
+				if ((rayMask & (1u << rayIdx)) == 0)
+					continue;
+
+				const float rayO[3] = { rays.originX[rayIdx], rays.originY[rayIdx], rays.originZ[rayIdx] };
+				const float rayD[3] = { rays.dirX[rayIdx], rays.dirY[rayIdx], rays.dirZ[rayIdx] };
+				const float t = hitSphereT(center[0], center[1], center[2], radius, rayO, rayD, t_min, hitT[rayIdx]);
+				if (t < hitT[rayIdx])
+				{
+					hitT[rayIdx] = t;
+					hitMask |= (1u << rayIdx);
+				}
+			}
+			return hitMask;
+		}
+
+		const SphereKernels c_sphereKernelsScalar =
+		{
+			SimdIsa::eScalar,
+			hitSpheresScalar,
+			hitSpherePacketScalar
+		};
+	}
+
+	SimdIsa detectSimdIsa()
+	{
+		// CPU doesn't change while the app is running
+		static const SimdIsa detectedIsa = detectSimdIsaImpl();
+		return detectedIsa;
+	}
+
+	const char * getSimdIsaName(SimdIsa isa)
+	{
+		switch (isa)
+		{
+			case SimdIsa::eAuto: return "auto";
+			case SimdIsa::eScalar: return "scalar";
+			case SimdIsa::eAVX2: return "avx2";
+			case SimdIsa::eAVX512: return "avx512";
+		}
+		return "unknown";
+	}
+
+	const SphereKernels & getSphereKernels(SimdIsa isa)
+	{
+		const SimdIsa supportedIsa = detectSimdIsa();
+		if (isa == SimdIsa::eAuto || isa > supportedIsa)
+		{
+			isa = supportedIsa;
+		}
+
+		const SphereKernels * kernels = nullptr;
+		if (isa == SimdIsa::eAVX512)
+		{
+			kernels = getSphereKernelsAVX512();
+			if (kernels == nullptr)
+			{
+				isa = SimdIsa::eAVX2;
+			}
+		}
+		if (isa == SimdIsa::eAVX2)
+		{
+			kernels = getSphereKernelsAVX2();
+		}
+
+		return (kernels != nullptr) ? *kernels : c_sphereKernelsScalar;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+// Ray-sphere intersection kernels of the CPU tracer
+//	all the variants evaluate exactly the same expressions as `hitSphere` of `pathtracer.glsl` in the same order
+//	(no FMA contraction), so that the results are bit-identical regardless of the instruction set used;
+//	compilers contract the multiply-adds (even the intrinsics) into FMA when allowed, so the translation units
+//	with the kernels and the scalar code pin the contraction off with the pragmas, equivalent of `-ffp-contract=off`
+
+namespace cpu
+{
+	enum class SimdIsa
+	{
+		// Best instruction set supported by both the CPU and the OS
+		eAuto = 0,
+		eScalar,
+		eAVX2,
+		eAVX512,
+	};
+
+	SimdIsa detectSimdIsa();
+	const char * getSimdIsaName(SimdIsa isa);
+
+	// Sphere arrays should be padded with this amount of elements past the last sphere, so that the kernels
+	//	could always load full vectors
+	const int c_sphereSoAPadding = 16;
+
+	// Spheres in the structure-of-arrays layout
+	struct SphereSoA
+	{
+		const float * centerX;
+		const float * centerY;
+		const float * centerZ;
+		const float * radius;
+	};
+
+	const int c_maxRayPacketSize = 16;
+
+	// Up to `c_maxRayPacketSize` rays in the structure-of-arrays layout
+	struct RayPacket
+	{
+		alignas(64) float originX[c_maxRayPacketSize];
+		alignas(64) float originY[c_maxRayPacketSize];
+		alignas(64) float originZ[c_maxRayPacketSize];
+		alignas(64) float dirX[c_maxRayPacketSize];
+		alignas(64) float dirY[c_maxRayPacketSize];
+		alignas(64) float dirZ[c_maxRayPacketSize];
+	};
+
+	struct SphereKernels
+	{
+		SimdIsa isa;
+
+		// One ray vs `count` spheres starting at `first`, returns index of the closest sphere hit within
+		//	(t_min; t_max) or -1; same as calling `hitSphere` for each of the spheres in order, including
+		//	the tie-breaking: out of the spheres hit at the same distance, the first one wins
+		int (*hitSpheres)(const SphereSoA & spheres, int first, int count, const float rayO[3], const float rayD[3], float t_min, float t_max, float * hitT);
+
+		// Rays of the packet selected by `rayMask` vs one sphere; `hitT` holds per-ray closest hit distance
+		//	which serves as t_max, and is updated for the rays that hit the sphere closer; returns mask of such rays
+		uint32_t (*hitSpherePacket)(const RayPacket & rays, uint32_t rayMask, const float center[3], float radius, float t_min, float * hitT);
+	};
+
+	// Requested instruction set is capped by the one supported, so that it is always safe to call the kernels
+	const SphereKernels & getSphereKernels(SimdIsa isa);
+}
\ No newline at end of file
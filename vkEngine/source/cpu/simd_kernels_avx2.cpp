@@ -0,0 +1,180 @@
+// Kernels are only bit-identical without the FMA contraction, see `simd_kernels.h`
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include <immintrin.h>
+
+#include "cpu/simd_kernels.h"
+
+// This file is compiled with AVX2 code generation enabled, and should only be entered through the kernel table
+//	after the runtime check; it intentionally doesn't include any standard library headers, since their inline
+//	functions instantiated here could be picked by the linker for the rest of the program
+
+namespace cpu
+{
+	namespace
+	{
+		const int c_simdWidth = 8;
+
+		// Computes the same values as `hitSphere`, returns t_max for the lanes that miss
+		inline __m256 hitSphereT8(
+			__m256 centerX, __m256 centerY, __m256 centerZ, __m256 radius,
+			__m256 rayOX, __m256 rayOY, __m256 rayOZ,
+			__m256 rayDX, __m256 rayDY, __m256 rayDZ,
+			__m256 t_min, __m256 t_max
+			)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 two = _mm256_set1_ps(2.0f);
+			const __m256 four = _mm256_set1_ps(4.0f);
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+			const __m256 rayO2sphCX = _mm256_sub_ps(rayOX, centerX);
+			const __m256 rayO2sphCY = _mm256_sub_ps(rayOY, centerY);
+			const __m256 rayO2sphCZ = _mm256_sub_ps(rayOZ, centerZ);
+
+			const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rayDX, rayDX), _mm256_mul_ps(rayDY, rayDY)), _mm256_mul_ps(rayDZ, rayDZ));
+			const __m256 dotDO2C = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rayDX, rayO2sphCX), _mm256_mul_ps(rayDY, rayO2sphCY)), _mm256_mul_ps(rayDZ, rayO2sphCZ));
+			const __m256 b = _mm256_mul_ps(two, dotDO2C);
+			const __m256 dotO2C = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rayO2sphCX, rayO2sphCX), _mm256_mul_ps(rayO2sphCY, rayO2sphCY)), _mm256_mul_ps(rayO2sphCZ, rayO2sphCZ));
+			const __m256 c = _mm256_sub_ps(dotO2C, _mm256_mul_ps(radius, radius));
+			const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_mul_ps(four, a), c));
+
+			const __m256 twoA = _mm256_mul_ps(two, a);
+			const __m256 sqrtD_div2a = _mm256_div_ps(_mm256_sqrt_ps(discriminant), twoA);
+			const __m256 negB_div2a = _mm256_div_ps(_mm256_xor_ps(b, signMask), twoA);
+
+			const __m256 hitT1 = _mm256_sub_ps(negB_div2a, sqrtD_div2a);
+			const __m256 hitT2 = _mm256_add_ps(negB_div2a, sqrtD_div2a);
+
+			const __m256 isDiscriminantValid = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+			const __m256 isHitT1Valid = _mm256_and_ps(_mm256_cmp_ps(hitT1, t_min, _CMP_GT_OQ), _mm256_cmp_ps(hitT1, t_max, _CMP_LT_OQ));
+			const __m256 isHitT2Valid = _mm256_and_ps(_mm256_cmp_ps(hitT2, t_min, _CMP_GT_OQ), _mm256_cmp_ps(hitT2, t_max, _CMP_LT_OQ));
+
+			__m256 hitT = _mm256_blendv_ps(t_max, hitT2, isHitT2Valid);
+			hitT = _mm256_blendv_ps(hitT, hitT1, isHitT1Valid);
+			return _mm256_blendv_ps(t_max, hitT, isDiscriminantValid);
+		}
+
+		int hitSpheresAVX2(const SphereSoA & spheres, int first, int count, const float rayO[3], const float rayD[3], float t_min, float t_max, float * hitT)
+		{
+			const __m256 rayOX = _mm256_set1_ps(rayO[0]);
+			const __m256 rayOY = _mm256_set1_ps(rayO[1]);
+			const __m256 rayOZ = _mm256_set1_ps(rayO[2]);
+			const __m256 rayDX = _mm256_set1_ps(rayD[0]);
+			const __m256 rayDY = _mm256_set1_ps(rayD[1]);
+			const __m256 rayDZ = _mm256_set1_ps(rayD[2]);
+			const __m256 vecTMin = _mm256_set1_ps(t_min);
+			const __m256 vecTMax = _mm256_set1_ps(t_max);
+			const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+			// Per-lane closest hit; lanes only take strictly closer hits, so earlier spheres win the ties
+			__m256 closestHit = vecTMax;
+			__m256i closestSphereIdx = _mm256_set1_epi32(-1);
+			for (int offset = 0; offset < count; offset += c_simdWidth)
+			{
+				const int sphereIdx = first + offset;
+				const __m256 t = hitSphereT8(
+					_mm256_loadu_ps(spheres.centerX + sphereIdx),
+					_mm256_loadu_ps(spheres.centerY + sphereIdx),
+					_mm256_loadu_ps(spheres.centerZ + sphereIdx),
+					_mm256_loadu_ps(spheres.radius + sphereIdx),
+					rayOX, rayOY, rayOZ,
+					rayDX, rayDY, rayDZ,
+					vecTMin, vecTMax
+					);
+
+				// Lanes past the end of the range hold padding or spheres of the other leaves
+				const __m256 isLaneActive = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count - offset), laneIndices));
+				const __m256 isCloser = _mm256_and_ps(_mm256_cmp_ps(t, closestHit, _CMP_LT_OQ), isLaneActive);
+
+				closestHit = _mm256_blendv_ps(closestHit, t, isCloser);
+				closestSphereIdx = _mm256_castps_si256(
+					_mm256_blendv_ps(
+						_mm256_castsi256_ps(closestSphereIdx),
+						_mm256_castsi256_ps(_mm256_add_epi32(_mm256_set1_epi32(sphereIdx), laneIndices)),
+						isCloser
+						)
+					);
+			}
+
+			alignas(32) float laneClosestHit[c_simdWidth];
+			alignas(32) int laneClosestSphereIdx[c_simdWidth];
+			_mm256_store_ps(laneClosestHit, closestHit);
+			_mm256_store_si256(reinterpret_cast<__m256i *>(laneClosestSphereIdx), closestSphereIdx);
+
+			int resultSphereIdx = -1;
+			float resultHit = t_max;
+			for (int laneIdx = 0; laneIdx < c_simdWidth; ++laneIdx)
+			{
+				const int laneSphereIdx = laneClosestSphereIdx[laneIdx];
+				if (laneSphereIdx < 0)
+					continue;
+
+				if (laneClosestHit[laneIdx] < resultHit || (laneClosestHit[laneIdx] == resultHit && laneSphereIdx < resultSphereIdx))
+				{
+					resultHit = laneClosestHit[laneIdx];
+					resultSphereIdx = laneSphereIdx;
+				}
+			}
+
+			*hitT = resultHit;
+			return resultSphereIdx;
+		}
+
+		uint32_t hitSpherePacketAVX2(const RayPacket & rays, uint32_t rayMask, const float center[3], float radius, float t_min, float * hitT)
+		{
+			const __m256 centerX = _mm256_set1_ps(center[0]);
+			const __m256 centerY = _mm256_set1_ps(center[1]);
+			const __m256 centerZ = _mm256_set1_ps(center[2]);
+			const __m256 vecRadius = _mm256_set1_ps(radius);
+			const __m256 vecTMin = _mm256_set1_ps(t_min);
+			const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+			uint32_t hitMask = 0;
+			for (int rayOffset = 0; rayOffset < c_maxRayPacketSize; rayOffset += c_simdWidth)
+			{
+				const uint32_t chunkRayMask = (rayMask >> rayOffset) & 0xFF;
+				if (chunkRayMask == 0)
+					continue;
+
+				const __m256 closestHit = _mm256_loadu_ps(hitT + rayOffset);
+				const __m256 t = hitSphereT8(
+					centerX, centerY, centerZ, vecRadius,
+					_mm256_load_ps(rays.originX + rayOffset),
+					_mm256_load_ps(rays.originY + rayOffset),
+					_mm256_load_ps(rays.originZ + rayOffset),
+					_mm256_load_ps(rays.dirX + rayOffset),
+					_mm256_load_ps(rays.dirY + rayOffset),
+					_mm256_load_ps(rays.dirZ + rayOffset),
+					vecTMin, closestHit
+					);
+
+				const __m256i chunkRayMaskBits = _mm256_and_si256(_mm256_set1_epi32((int)chunkRayMask), laneBits);
+				const __m256 isLaneActive = _mm256_castsi256_ps(_mm256_cmpeq_epi32(chunkRayMaskBits, laneBits));
+				const __m256 isCloser = _mm256_and_ps(_mm256_cmp_ps(t, closestHit, _CMP_LT_OQ), isLaneActive);
+
+				_mm256_storeu_ps(hitT + rayOffset, _mm256_blendv_ps(closestHit, t, isCloser));
+				hitMask |= (uint32_t)_mm256_movemask_ps(isCloser) << rayOffset;
+			}
+			return hitMask;
+		}
+
+		const SphereKernels c_sphereKernelsAVX2 =
+		{
+			SimdIsa::eAVX2,
+			hitSpheresAVX2,
+			hitSpherePacketAVX2
+		};
+	}
+
+	const SphereKernels * getSphereKernelsAVX2()
+	{
+		return &c_sphereKernelsAVX2;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+// Kernels are only bit-identical without the FMA contraction, see `simd_kernels.h`
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include <immintrin.h>
+
+#include "cpu/simd_kernels.h"
+
+// This file is compiled with AVX-512 code generation enabled, see `simd_kernels_avx2.cpp` for the restrictions;
+//	only AVX-512F is used, and older compilers without AVX-512 intrinsics fall back to the AVX2 kernels
+#if defined(__AVX512F__) || (defined(_MSC_VER) && (_MSC_VER >= 1911))
+#define CPU_SIMD_AVX512_SUPPORTED 1
+#else
+#define CPU_SIMD_AVX512_SUPPORTED 0
+#endif
+
+namespace cpu
+{
+#if (CPU_SIMD_AVX512_SUPPORTED == 1)
+	namespace
+	{
+		const int c_simdWidth = 16;
+
+		// Computes the same values as `hitSphere`, returns t_max for the lanes that miss
+		inline __m512 hitSphereT16(
+			__m512 centerX, __m512 centerY, __m512 centerZ, __m512 radius,
+			__m512 rayOX, __m512 rayOY, __m512 rayOZ,
+			__m512 rayDX, __m512 rayDY, __m512 rayDZ,
+			__m512 t_min, __m512 t_max
+			)
+		{
+			const __m512 zero = _mm512_setzero_ps();
+			const __m512 two = _mm512_set1_ps(2.0f);
+			const __m512 four = _mm512_set1_ps(4.0f);
+			// Float XOR requires AVX-512DQ
+			const __m512i signMask = _mm512_set1_epi32((int)0x80000000);
+
+			const __m512 rayO2sphCX = _mm512_sub_ps(rayOX, centerX);
+			const __m512 rayO2sphCY = _mm512_sub_ps(rayOY, centerY);
+			const __m512 rayO2sphCZ = _mm512_sub_ps(rayOZ, centerZ);
+
+			const __m512 a = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(rayDX, rayDX), _mm512_mul_ps(rayDY, rayDY)), _mm512_mul_ps(rayDZ, rayDZ));
+			const __m512 dotDO2C = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(rayDX, rayO2sphCX), _mm512_mul_ps(rayDY, rayO2sphCY)), _mm512_mul_ps(rayDZ, rayO2sphCZ));
+			const __m512 b = _mm512_mul_ps(two, dotDO2C);
+			const __m512 dotO2C = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(rayO2sphCX, rayO2sphCX), _mm512_mul_ps(rayO2sphCY, rayO2sphCY)), _mm512_mul_ps(rayO2sphCZ, rayO2sphCZ));
+			const __m512 c = _mm512_sub_ps(dotO2C, _mm512_mul_ps(radius, radius));
+			const __m512 discriminant = _mm512_sub_ps(_mm512_mul_ps(b, b), _mm512_mul_ps(_mm512_mul_ps(four, a), c));
+
+			const __m512 twoA = _mm512_mul_ps(two, a);
+			const __m512 sqrtD_div2a = _mm512_div_ps(_mm512_sqrt_ps(discriminant), twoA);
+			const __m512 negB_div2a = _mm512_div_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(b), signMask)), twoA);
+
+			const __m512 hitT1 = _mm512_sub_ps(negB_div2a, sqrtD_div2a);
+			const __m512 hitT2 = _mm512_add_ps(negB_div2a, sqrtD_div2a);
+
+			const __mmask16 isDiscriminantValid = _mm512_cmp_ps_mask(discriminant, zero, _CMP_GE_OQ);
+			const __mmask16 isHitT1Valid = _mm512_cmp_ps_mask(hitT1, t_min, _CMP_GT_OQ) & _mm512_cmp_ps_mask(hitT1, t_max, _CMP_LT_OQ);
+			const __mmask16 isHitT2Valid = _mm512_cmp_ps_mask(hitT2, t_min, _CMP_GT_OQ) & _mm512_cmp_ps_mask(hitT2, t_max, _CMP_LT_OQ);
+
+			__m512 hitT = _mm512_mask_blend_ps(isDiscriminantValid & isHitT2Valid, t_max, hitT2);
+			return _mm512_mask_blend_ps(isDiscriminantValid & isHitT1Valid, hitT, hitT1);
+		}
+
+		int hitSpheresAVX512(const SphereSoA & spheres, int first, int count, const float rayO[3], const float rayD[3], float t_min, float t_max, float * hitT)
+		{
+			const __m512 rayOX = _mm512_set1_ps(rayO[0]);
+			const __m512 rayOY = _mm512_set1_ps(rayO[1]);
+			const __m512 rayOZ = _mm512_set1_ps(rayO[2]);
+			const __m512 rayDX = _mm512_set1_ps(rayD[0]);
+			const __m512 rayDY = _mm512_set1_ps(rayD[1]);
+			const __m512 rayDZ = _mm512_set1_ps(rayD[2]);
+			const __m512 vecTMin = _mm512_set1_ps(t_min);
+			const __m512 vecTMax = _mm512_set1_ps(t_max);
+			const __m512i laneIndices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+			// Per-lane closest hit; lanes only take strictly closer hits, so earlier spheres win the ties
+			__m512 closestHit = vecTMax;
+			__m512i closestSphereIdx = _mm512_set1_epi32(-1);
+			for (int offset = 0; offset < count; offset += c_simdWidth)
+			{
+				const int sphereIdx = first + offset;
+				const int numActiveLanes = count - offset;
+				const __mmask16 isLaneActive = (numActiveLanes >= c_simdWidth) ? (__mmask16)0xFFFF : (__mmask16)((1u << numActiveLanes) - 1);
+
+				const __m512 t = hitSphereT16(
+					_mm512_maskz_loadu_ps(isLaneActive, spheres.centerX + sphereIdx),
+					_mm512_maskz_loadu_ps(isLaneActive, spheres.centerY + sphereIdx),
+					_mm512_maskz_loadu_ps(isLaneActive, spheres.centerZ + sphereIdx),
+					_mm512_maskz_loadu_ps(isLaneActive, spheres.radius + sphereIdx),
+					rayOX, rayOY, rayOZ,
+					rayDX, rayDY, rayDZ,
+					vecTMin, vecTMax
+					);
+
+				const __mmask16 isCloser = _mm512_mask_cmp_ps_mask(isLaneActive, t, closestHit, _CMP_LT_OQ);
+				closestHit = _mm512_mask_mov_ps(closestHit, isCloser, t);
+				closestSphereIdx = _mm512_mask_mov_epi32(closestSphereIdx, isCloser, _mm512_add_epi32(_mm512_set1_epi32(sphereIdx), laneIndices));
+			}
+
+			const __mmask16 isLaneHit = _mm512_cmp_epi32_mask(closestSphereIdx, _mm512_setzero_si512(), _MM_CMPINT_NLT);
+			if (isLaneHit == 0)
+			{
+				*hitT = t_max;
+				return -1;
+			}
+
+			// Out of the lanes with the closest hit, pick the lowest sphere index
+			const float resultHit = _mm512_mask_reduce_min_ps(isLaneHit, closestHit);
+			const __mmask16 isLaneClosest = _mm512_mask_cmp_ps_mask(isLaneHit, closestHit, _mm512_set1_ps(resultHit), _CMP_EQ_OQ);
+			const int resultSphereIdx = _mm512_mask_reduce_min_epi32(isLaneClosest, closestSphereIdx);
+
+			*hitT = resultHit;
+			return resultSphereIdx;
+		}
+
+		uint32_t hitSpherePacketAVX512(const RayPacket & rays, uint32_t rayMask, const float center[3], float radius, float t_min, float * hitT)
+		{
+			const __mmask16 isLaneActive = (__mmask16)(rayMask & 0xFFFF);
+			if (isLaneActive == 0)
+				return 0;
+
+			const __m512 closestHit = _mm512_loadu_ps(hitT);
+			const __m512 t = hitSphereT16(
+				_mm512_set1_ps(center[0]),
+				_mm512_set1_ps(center[1]),
+				_mm512_set1_ps(center[2]),
+				_mm512_set1_ps(radius),
+				_mm512_load_ps(rays.originX),
+				_mm512_load_ps(rays.originY),
+				_mm512_load_ps(rays.originZ),
+				_mm512_load_ps(rays.dirX),
+				_mm512_load_ps(rays.dirY),
+				_mm512_load_ps(rays.dirZ),
+				_mm512_set1_ps(t_min), closestHit
+				);
+
+			const __mmask16 isCloser = _mm512_mask_cmp_ps_mask(isLaneActive, t, closestHit, _CMP_LT_OQ);
+			_mm512_mask_storeu_ps(hitT, isCloser, t);
+			return (uint32_t)isCloser;
+		}
+
+		const SphereKernels c_sphereKernelsAVX512 =
+		{
+			SimdIsa::eAVX512,
+			hitSpheresAVX512,
+			hitSpherePacketAVX512
+		};
+	}
+
+	const SphereKernels * getSphereKernelsAVX512()
+	{
+		return &c_sphereKernelsAVX512;
+	}
+#else
+	const SphereKernels * getSphereKernelsAVX512()
+	{
+		return nullptr;
+	}
+#endif
+}
\ No newline at end of file
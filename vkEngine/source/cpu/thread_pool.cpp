@@ -0,0 +1,81 @@
+#include "cpu/thread_pool.h"
+
+namespace cpu
+{
+	ThreadPool::ThreadPool(int numThreads)
+	{
+		if (numThreads <= 0)
+		{
+			numThreads = (int)std::thread::hardware_concurrency();
+		}
+		if (numThreads <= 0)
+		{
+			numThreads = 1;
+		}
+
+		// Workers read the amount of threads right away, so it should be set before they are started
+		m_numThreads = numThreads;
+		m_threads.reserve(numThreads);
+		for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+		{
+			m_threads.push_back(std::thread(&ThreadPool::workerLoop, this, threadIdx));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isExitting = true;
+		}
+		m_jobStartedCV.notify_all();
+
+		for (std::thread & thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::run(const Job & job)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_numThreadsRunning = m_numThreads;
+		++m_jobGeneration;
+		m_jobStartedCV.notify_all();
+
+		m_jobFinishedCV.wait(lock, [this]() { return m_numThreadsRunning == 0; });
+		m_job = nullptr;
+	}
+
+	void ThreadPool::workerLoop(int threadIdx)
+	{
+		const int numThreads = m_numThreads;
+
+		uint64_t lastJobGeneration = 0;
+		while (true)
+		{
+			const Job * job = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobStartedCV.wait(lock, [this, lastJobGeneration]() { return m_isExitting || m_jobGeneration != lastJobGeneration; });
+				if (m_isExitting)
+					return;
+
+				lastJobGeneration = m_jobGeneration;
+				job = m_job;
+			}
+
+			(*job)(threadIdx, numThreads);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_numThreadsRunning;
+				if (m_numThreadsRunning == 0)
+				{
+					m_jobFinishedCV.notify_one();
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace cpu
+{
+	// Fixed set of worker threads that execute the same job, each receiving its own thread index
+	//	threads are kept alive between the jobs, so that the frames don't pay for the thread creation
+	class ThreadPool
+	{
+	public:
+		typedef std::function<void(int threadIdx, int numThreads)> Job;
+
+		// 0 means amount of the hardware threads
+		explicit ThreadPool(int numThreads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool & operator = (const ThreadPool &) = delete;
+
+		int getNumThreads() const { return m_numThreads; }
+
+		// Runs the job on all the worker threads, and blocks until every thread finishes it
+		void run(const Job & job);
+
+	private:
+		void workerLoop(int threadIdx);
+
+		int m_numThreads = 0;
+		std::vector<std::thread> m_threads;
+
+		std::mutex m_mutex;
+		std::condition_variable m_jobStartedCV;
+		std::condition_variable m_jobFinishedCV;
+		const Job * m_job = nullptr;
+		// Incremented each time new job is submitted, so that workers don't run the same job twice
+		uint64_t m_jobGeneration = 0;
+		int m_numThreadsRunning = 0;
+		bool m_isExitting = false;
+	};
+}
\ No newline at end of file
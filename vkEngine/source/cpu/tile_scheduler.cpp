@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#include "cpu/tile_scheduler.h"
+
+namespace cpu
+{
+	namespace
+	{
+		// Interleaves lower 16 bits of x and y
+		uint32_t encodeMorton2D(uint32_t x, uint32_t y)
+		{
+			auto spreadBits = [](uint32_t v)
+			{
+				v &= 0x0000FFFF;
+				v = (v | (v << 8)) & 0x00FF00FF;
+				v = (v | (v << 4)) & 0x0F0F0F0F;
+				v = (v | (v << 2)) & 0x33333333;
+				v = (v | (v << 1)) & 0x55555555;
+				return v;
+			};
+			return spreadBits(x) | (spreadBits(y) << 1);
+		}
+	}
+
+	void TileScheduler::init(int width, int height, int tileWidth, int tileHeight, int numThreads, bool isStealingEnabled)
+	{
+		tileWidth = std::max(tileWidth, 1);
+		tileHeight = std::max(tileHeight, 1);
+		const int numTilesX = (width + tileWidth - 1) / tileWidth;
+		const int numTilesY = (height + tileHeight - 1) / tileHeight;
+
+		std::vector<uint32_t> tileMortonCodes;
+		tileMortonCodes.reserve((size_t)numTilesX * numTilesY);
+		for (int tileY = 0; tileY < numTilesY; ++tileY)
+		{
+			for (int tileX = 0; tileX < numTilesX; ++tileX)
+			{
+				tileMortonCodes.push_back(encodeMorton2D((uint32_t)tileX, (uint32_t)tileY));
+			}
+		}
+
+		std::vector<uint32_t> tileOrder(tileMortonCodes.size());
+		for (size_t tileIdx = 0, tileIdxEnd = tileOrder.size(); tileIdx < tileIdxEnd; ++tileIdx)
+		{
+			tileOrder[tileIdx] = (uint32_t)tileIdx;
+		}
+		std::sort(tileOrder.begin(), tileOrder.end(), [&tileMortonCodes](uint32_t tileIdx0, uint32_t tileIdx1) { return tileMortonCodes[tileIdx0] < tileMortonCodes[tileIdx1]; });
+
+		m_tiles.resize(tileOrder.size());
+		for (size_t tileIdx = 0, tileIdxEnd = tileOrder.size(); tileIdx < tileIdxEnd; ++tileIdx)
+		{
+			const int tileX = (int)tileOrder[tileIdx] % numTilesX;
+			const int tileY = (int)tileOrder[tileIdx] / numTilesX;
+
+			Tile & tile = m_tiles[tileIdx];
+			tile.x0 = tileX * tileWidth;
+			tile.y0 = tileY * tileHeight;
+			tile.x1 = std::min(tile.x0 + tileWidth, width);
+			tile.y1 = std::min(tile.y0 + tileHeight, height);
+		}
+
+		m_numThreads = std::max(numThreads, 1);
+		m_isStealingEnabled = isStealingEnabled;
+		m_threads.reset(new ThreadData[m_numThreads]);
+
+		reset();
+	}
+
+	void * TileScheduler::ThreadData::operator new[](size_t size)
+	{
+		void * ptr = nullptr;
+#if defined(_MSC_VER)
+		ptr = _aligned_malloc(size, alignof(ThreadData));
+#else
+		if (posix_memalign(&ptr, alignof(ThreadData), size) != 0)
+		{
+			ptr = nullptr;
+		}
+#endif
+		if (ptr == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		return ptr;
+	}
+	void TileScheduler::ThreadData::operator delete[](void * ptr)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	void TileScheduler::reset()
+	{
+		const uint64_t numTiles = (uint64_t)m_tiles.size();
+		for (int threadIdx = 0; threadIdx < m_numThreads; ++threadIdx)
+		{
+			const uint32_t rangeBegin = (uint32_t)(numTiles * threadIdx / m_numThreads);
+			const uint32_t rangeEnd = (uint32_t)(numTiles * (threadIdx + 1) / m_numThreads);
+			m_threads[threadIdx].range.store(packRange(rangeBegin, rangeEnd), std::memory_order_relaxed);
+		}
+	}
+
+	bool TileScheduler::getNextTile(int threadIdx, Tile * tile)
+	{
+		ThreadData & threadData = m_threads[threadIdx];
+
+		uint32_t tileIdx = 0;
+		bool isTileFound = false;
+
+		uint64_t range = threadData.range.load(std::memory_order_relaxed);
+		while (getRangeBegin(range) < getRangeEnd(range))
+		{
+			// Thieves could shrink the range concurrently, CAS reloads it on failure
+			if (threadData.range.compare_exchange_weak(range, packRange(getRangeBegin(range) + 1, getRangeEnd(range)), std::memory_order_relaxed))
+			{
+				tileIdx = getRangeBegin(range);
+				isTileFound = true;
+				break;
+			}
+		}
+
+		if (!isTileFound && m_isStealingEnabled)
+		{
+			isTileFound = stealTiles(threadIdx, &tileIdx);
+		}
+
+		if (!isTileFound)
+			return false;
+
+		*tile = m_tiles[tileIdx];
+		++threadData.stats.numTiles;
+		return true;
+	}
+
+	bool TileScheduler::stealTiles(int threadIdx, uint32_t * tileIdx)
+	{
+		while (true)
+		{
+			// Largest range is the one most likely to hold the thread that finishes last
+			int victimIdx = -1;
+			uint64_t victimRange = 0;
+			uint32_t victimRangeSize = 0;
+			for (int otherThreadIdx = 0; otherThreadIdx < m_numThreads; ++otherThreadIdx)
+			{
+				if (otherThreadIdx == threadIdx)
+					continue;
+
+				const uint64_t range = m_threads[otherThreadIdx].range.load(std::memory_order_relaxed);
+				const uint32_t rangeSize = (getRangeEnd(range) > getRangeBegin(range)) ? getRangeEnd(range) - getRangeBegin(range) : 0;
+				if (rangeSize > victimRangeSize)
+				{
+					victimIdx = otherThreadIdx;
+					victimRange = range;
+					victimRangeSize = rangeSize;
+				}
+			}
+
+			if (victimIdx < 0)
+				return false;
+
+			// Back half is taken, since the victim works from the front
+			const uint32_t numStolenTiles = (victimRangeSize + 1) / 2;
+			const uint32_t stolenBegin = getRangeEnd(victimRange) - numStolenTiles;
+			if (!m_threads[victimIdx].range.compare_exchange_strong(victimRange, packRange(getRangeBegin(victimRange), stolenBegin), std::memory_order_relaxed))
+			{
+				// Victim range changed in the meantime, pick the victim again
+				continue;
+			}
+
+			// Own range is empty, so nobody else modifies it until it is replaced
+			ThreadData & threadData = m_threads[threadIdx];
+			threadData.range.store(packRange(stolenBegin + 1, stolenBegin + numStolenTiles), std::memory_order_relaxed);
+			threadData.stats.numStolenTiles += numStolenTiles;
+			++threadData.stats.numSteals;
+
+			*tileIdx = stolenBegin;
+			return true;
+		}
+	}
+}
\ No newline at end of file
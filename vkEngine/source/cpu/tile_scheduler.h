@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace cpu
+{
+	struct Tile
+	{
+		int x0, y0;
+		int x1, y1;
+	};
+
+	// Image tiles are laid out in the Morton order and split into contiguous per-thread ranges, so that each
+	//	thread starts with a compact region of the image. Threads take tiles from the front of their own range,
+	//	and once it is exhausted, steal the back half of the largest range left, which keeps both the stolen
+	//	and the remaining tiles spatially coherent
+	class TileScheduler
+	{
+	public:
+		struct ThreadStats
+		{
+			uint32_t numTiles = 0;
+			// Tiles that were initially assigned to the other threads
+			uint32_t numStolenTiles = 0;
+			uint32_t numSteals = 0;
+		};
+
+		// Without stealing, each thread only renders its initial range, i.e. the image is split statically
+		void init(int width, int height, int tileWidth, int tileHeight, int numThreads, bool isStealingEnabled);
+
+		// Restores initial per-thread ranges, should be called before each frame while no thread is rendering;
+		//	statistics are accumulated until the next `init`
+		void reset();
+
+		// Returns false when there is no work left for the thread
+		bool getNextTile(int threadIdx, Tile * tile);
+
+		int getNumThreads() const { return m_numThreads; }
+		int getNumTiles() const { return (int)m_tiles.size(); }
+		const ThreadStats & getThreadStats(int threadIdx) const { return m_threads[threadIdx].stats; }
+
+	private:
+		// [begin; end) tile indices packed into single word, so that the owner and the thieves could
+		//	update the range with a single CAS
+		static uint64_t packRange(uint32_t begin, uint32_t end) { return ((uint64_t)end << 32) | begin; }
+		static uint32_t getRangeBegin(uint64_t range) { return (uint32_t)range; }
+		static uint32_t getRangeEnd(uint64_t range) { return (uint32_t)(range >> 32); }
+
+		bool stealTiles(int threadIdx, uint32_t * tileIdx);
+
+		// Range that other threads poll and the stats written by the owner are on separate cache lines,
+		//	and so are the neighbouring threads
+		struct alignas(64) ThreadData
+		{
+			std::atomic<uint64_t> range;
+			alignas(64) ThreadStats stats;
+
+			// Global operator new only respects the over-alignment since C++17
+			static void * operator new[](size_t size);
+			static void operator delete[](void * ptr);
+		};
+
+		std::vector<Tile> m_tiles;
+		std::unique_ptr<ThreadData[]> m_threads;
+		int m_numThreads = 0;
+		bool m_isStealingEnabled = true;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <math.h>
+#include <algorithm>
+
+#include "image/blue_noise.h"
+
+namespace image
+{
+	namespace
+	{
+		// Integer hash (Wellons' lowbias32), the generator shouldn't depend on the CRT `rand` state
+		uint32_t hashUint(uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		class VoidAndCluster
+		{
+		public:
+			VoidAndCluster(int size):
+				m_size(size),
+				m_numTexels(size * size)
+			{
+				// Distances wrap around, so that the pattern tiles without seams
+				const float sigma = 1.5f;
+				m_splat.resize(m_numTexels);
+				for (int dy = 0; dy < size; ++dy)
+				{
+					const int wrappedDY = std::min(dy, size - dy);
+					for (int dx = 0; dx < size; ++dx)
+					{
+						const int wrappedDX = std::min(dx, size - dx);
+						m_splat[dy * size + dx] = expf(-(float)(wrappedDX*wrappedDX + wrappedDY*wrappedDY) / (2.0f * sigma*sigma));
+					}
+				}
+			}
+
+			void generate(uint32_t seed, std::vector<uint32_t> * ranks)
+			{
+				ranks->assign(m_numTexels, 0);
+
+				// Initial binary pattern: about a tenth of the texels set at random
+				std::vector<unsigned char> initialPattern(m_numTexels, 0);
+				std::vector<float> initialEnergy(m_numTexels, 0.0f);
+				const int numInitialOnes = std::max(m_numTexels / 10, 1);
+				for (uint32_t counter = 0, numOnes = 0; (int)numOnes < numInitialOnes; ++counter)
+				{
+					const int texelIdx = (int)(hashUint(seed ^ hashUint(counter)) % (uint32_t)m_numTexels);
+					if (initialPattern[texelIdx] != 0)
+						continue;
+					setTexel(&initialPattern, &initialEnergy, texelIdx, 1);
+					++numOnes;
+				}
+
+				// Relaxation: texel from the tightest cluster is moved into the largest void, until it is
+				//	put back into the same place; iterations are capped in case the moves cycle
+				for (int iteration = 0; iteration < m_numTexels; ++iteration)
+				{
+					const int clusterIdx = findTightestCluster(initialPattern, initialEnergy);
+					setTexel(&initialPattern, &initialEnergy, clusterIdx, 0);
+					const int voidIdx = findLargestVoid(initialPattern, initialEnergy);
+					setTexel(&initialPattern, &initialEnergy, voidIdx, 1);
+					if (voidIdx == clusterIdx)
+						break;
+				}
+
+				// Texels of the initial pattern are ranked by removing the tightest clusters one by one
+				std::vector<unsigned char> pattern = initialPattern;
+				std::vector<float> energy = initialEnergy;
+				int rank = numInitialOnes;
+				while (rank > 0)
+				{
+					const int clusterIdx = findTightestCluster(pattern, energy);
+					setTexel(&pattern, &energy, clusterIdx, 0);
+					(*ranks)[clusterIdx] = (uint32_t)--rank;
+				}
+
+				// The rest are ranked by filling the largest voids one by one
+				pattern = initialPattern;
+				energy = initialEnergy;
+				rank = numInitialOnes;
+				while (rank < m_numTexels)
+				{
+					const int voidIdx = findLargestVoid(pattern, energy);
+					setTexel(&pattern, &energy, voidIdx, 1);
+					(*ranks)[voidIdx] = (uint32_t)rank++;
+				}
+			}
+
+		private:
+			// Updates the texel, and the energy of every texel by its Gaussian splat
+			void setTexel(std::vector<unsigned char> * pattern, std::vector<float> * energy, int texelIdx, unsigned char value)
+			{
+				const float sign = (value != 0) ? 1.0f : -1.0f;
+				(*pattern)[texelIdx] = value;
+
+				const int centerX = texelIdx % m_size;
+				const int centerY = texelIdx / m_size;
+				float * energyData = energy->data();
+				for (int y = 0; y < m_size; ++y)
+				{
+					const float * splatRow = m_splat.data() + ((y - centerY + m_size) % m_size) * m_size;
+					float * energyRow = energyData + y * m_size;
+					// Row is split at the center, so that the inner loops don't need to wrap the offset
+					for (int x = 0; x < centerX; ++x)
+					{
+						energyRow[x] += sign * splatRow[x - centerX + m_size];
+					}
+					for (int x = centerX; x < m_size; ++x)
+					{
+						energyRow[x] += sign * splatRow[x - centerX];
+					}
+				}
+			}
+
+			int findTightestCluster(const std::vector<unsigned char> & pattern, const std::vector<float> & energy) const
+			{
+				int clusterIdx = -1;
+				for (int texelIdx = 0; texelIdx < m_numTexels; ++texelIdx)
+				{
+					if (pattern[texelIdx] != 0 && (clusterIdx < 0 || energy[texelIdx] > energy[clusterIdx]))
+						clusterIdx = texelIdx;
+				}
+				return clusterIdx;
+			}
+			int findLargestVoid(const std::vector<unsigned char> & pattern, const std::vector<float> & energy) const
+			{
+				int voidIdx = -1;
+				for (int texelIdx = 0; texelIdx < m_numTexels; ++texelIdx)
+				{
+					if (pattern[texelIdx] == 0 && (voidIdx < 0 || energy[texelIdx] < energy[voidIdx]))
+						voidIdx = texelIdx;
+				}
+				return voidIdx;
+			}
+
+			int m_size;
+			int m_numTexels;
+			// Energy contribution of the set texel, indexed by the offset from it
+			std::vector<float> m_splat;
+		};
+	}
+
+	void generateBlueNoise(int size, int numChannels, uint32_t seed, std::vector<unsigned char> * texels)
+	{
+		if (texels == nullptr || size <= 0 || numChannels <= 0)
+			return;
+
+		const int numTexels = size * size;
+		texels->resize((size_t)numTexels * numChannels);
+
+		VoidAndCluster voidAndCluster(size);
+		std::vector<uint32_t> ranks;
+		for (int channelIdx = 0; channelIdx < numChannels; ++channelIdx)
+		{
+			voidAndCluster.generate(hashUint(seed + (uint32_t)channelIdx * 0x9e3779b9u), &ranks);
+			for (int texelIdx = 0; texelIdx < numTexels; ++texelIdx)
+			{
+				(*texels)[(size_t)texelIdx * numChannels + channelIdx] = (unsigned char)(((uint64_t)ranks[texelIdx] * 256) / numTexels);
+			}
+		}
+	}
+}
\ No newline at end of file
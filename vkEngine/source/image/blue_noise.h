@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace image
+{
+	// Size of the blue noise texture the sampler tiles over the screen, should match `BLUE_NOISE_SIZE` in `sampler.glsl`
+	const int c_blueNoiseSize = 64;
+
+	// Void-and-cluster blue noise (Ulichney 1993): each of the `numChannels` channels is an independent
+	//	`size`x`size` pattern that tiles without seams, texels store the ranks remapped to [0, 255], so that
+	//	any threshold selects evenly spread texels; output is interleaved and deterministic for the given seed
+	void generateBlueNoise(int size, int numChannels, uint32_t seed, std::vector<unsigned char> * texels);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <vector>
+
+#include "image/ppm.h"
+
+namespace image
+{
+	bool writePPM(const char * filename, int width, int height, int numChannels, const unsigned char * pixels)
+	{
+		if (filename == nullptr || pixels == nullptr || width <= 0 || height <= 0 || numChannels < 3)
+		{
+			printf("Wrong parameters supplied to the writePPM!\n");
+			return false;
+		}
+
+		FILE * fp = nullptr;
+		if (fopen_s(&fp, filename, "wb") != 0 || fp == nullptr)
+		{
+			printf("Failed to open %s for writing!\n", filename);
+			return false;
+		}
+
+		fprintf(fp, "P6\n%d %d\n255\n", width, height);
+
+		std::vector<unsigned char> rowData(width * 3);
+		for (int y = 0; y < height; ++y)
+		{
+			const unsigned char * rowPixels = pixels + (size_t)y * width * numChannels;
+			for (int x = 0; x < width; ++x)
+			{
+				rowData[x*3  ] = rowPixels[x*numChannels  ];
+				rowData[x*3+1] = rowPixels[x*numChannels+1];
+				rowData[x*3+2] = rowPixels[x*numChannels+2];
+			}
+			fwrite(rowData.data(), 1, rowData.size(), fp);
+		}
+
+		fclose(fp);
+		return true;
+	}
+}
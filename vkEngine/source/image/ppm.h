@@ -0,0 +1,8 @@
+#pragma once
+
+namespace image
+{
+	// Writes binary PPM (P6), only first three channels of each pixel are stored
+	//	pixels are expected to be tightly packed, top row first
+	bool writePPM(const char * filename, int width, int height, int numChannels, const unsigned char * pixels);
+}
@@ -1,6 +1,13 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
 #include "windows/timer.h"
 #include "windows/window.h"
 #include "vulkan/basic.h"
+#include "cpu/pathtracer.h"
+#include "cpu/thread_pool.h"
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 	VkDebugReportFlagsEXT flags,
@@ -59,12 +66,20 @@ void keyStateCallback(void * pUserData, windows::KeyCode keyCode, windows::KeySt
 			}
 			break;
 		}
-#if (DBG_KEY_TESTING == 1)
 		case KeyCode::eEnter:
 		{
+#if (DBG_KEY_TESTING == 1)
 			printf("Enter %s\n", keyStatus);
+#endif
+			// Pausing the camera allows the image to progressively converge
+			if (pUserData && keyState == KeyState::ePressed)
+			{
+				vulkan::Wrapper * wrapper = reinterpret_cast<vulkan::Wrapper *>(pUserData);
+				wrapper->setIsCameraAnimated(!wrapper->getIsCameraAnimated());
+			}
 			break;
 		}
+#if (DBG_KEY_TESTING == 1)
 		case KeyCode::eLCtrl:
 		{
 			printf("LCtrl %s\n", keyStatus);
@@ -104,14 +119,850 @@ void keyStateCallback(void * pUserData, windows::KeyCode keyCode, windows::KeySt
 	}
 }
 
-int main()
+struct CommandLineParams
+{
+	bool isHeadless = false;
+	int width = 800;
+	int height = 600;
+	int numFrames = 64;
+	const char * outputFilename = "output.ppm";
+	vulkan::Wrapper::TracerBackend tracerBackend = vulkan::Wrapper::TracerBackend::eFragment;
+	// Headless only: renders with the CPU reference tracer instead of any Vulkan backend
+	bool useCPUTracer = false;
+	// CPU tracer thread count, 0 means amount of the hardware threads
+	int numThreads = 0;
+	// CPU tracer intersection kernels instruction set
+	cpu::SimdIsa cpuIsa = cpu::SimdIsa::eAuto;
+	// CPU tracer splits the image statically between the threads instead of the work stealing
+	bool cpuStaticScheduling = false;
+	// 0 means default
+	int workgroupSizeX = 0, workgroupSizeY = 0;
+	int tileSizeX = 0, tileSizeY = 0;
+	// Adds grid of 100 small spheres to the default scene
+	bool manyObjects = false;
+	// Amount of random small spheres added to the default scene
+	int numRandomSpheres = 0;
+	// 0 means default
+	int maxBounces = 0;
+	// Negative means default
+	int rrMinDepth = -1;
+	// Positive value enables adaptive sampling with this error threshold
+	float adaptiveThreshold = 0.0f;
+	// 0 means default
+	int adaptiveMinSamples = 0;
+	// Headless only: renders the same frames with every tracer backend and reports their timings
+	bool compareBackends = false;
+	// Prints averaged GPU pass timings to stdout periodically (windowed mode), headless runs always print them
+	bool printGpuTimings = false;
+	// Logs GPU pass timings of every frame into the CSV file
+	const char * gpuTimingsFilename = nullptr;
+	// Offsets the random sequences, see `vulkan::Wrapper::m_randomSeed`
+	uint32_t randomSeed = 0;
+	// Benchmark mode: renders fixed amount of frames with the animated camera driven by the virtual time,
+	//	and writes frame time statistics into the JSON file
+	const char * benchmarkFilename = nullptr;
+	// Frames rendered before the measurements start, e.g. to let the driver finish the lazy initialization
+	int numWarmupFrames = 8;
+	// Virtual time advanced per frame in the benchmark mode, replaces the wall clock frame time
+	double benchmarkFrameTimeMS = 1000.0 / 60.0;
+	// Pipeline cache file, nullptr means default and empty string disables the file
+	const char * pipelineCacheFilename = nullptr;
+	// Windowed only: positive value enables the dynamic resolution with this GPU frame time target
+	double dynamicResolutionTargetMS = 0.0;
+	// Positive value enables the temporal reprojection with the history capped at this amount of frames
+	int temporalMaxHistoryFrames = 0;
+};
+
+static void parseCommandLine(int argc, char ** argv, CommandLineParams * params)
+{
+	for (int argIdx = 1; argIdx < argc; ++argIdx)
+	{
+		const char * arg = argv[argIdx];
+		const bool hasValue = (argIdx + 1 < argc);
+
+		if (strcmp(arg, "--headless") == 0)
+		{
+			params->isHeadless = true;
+		}
+		else if (strcmp(arg, "--compare-backends") == 0)
+		{
+			params->isHeadless = true;
+			params->compareBackends = true;
+		}
+		else if (strcmp(arg, "--gpu-timings") == 0)
+		{
+			params->printGpuTimings = true;
+		}
+		else if (strcmp(arg, "--gpu-timings-csv") == 0 && hasValue)
+		{
+			params->gpuTimingsFilename = argv[++argIdx];
+		}
+		else if (strcmp(arg, "--benchmark") == 0 && hasValue)
+		{
+			params->isHeadless = true;
+			params->benchmarkFilename = argv[++argIdx];
+		}
+		else if (strcmp(arg, "--warmup") == 0 && hasValue)
+		{
+			params->numWarmupFrames = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--frame-time") == 0 && hasValue)
+		{
+			params->benchmarkFrameTimeMS = atof(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--seed") == 0 && hasValue)
+		{
+			params->randomSeed = (uint32_t)strtoul(argv[++argIdx], nullptr, 10);
+		}
+		else if (strcmp(arg, "--pipeline-cache") == 0 && hasValue)
+		{
+			params->pipelineCacheFilename = argv[++argIdx];
+		}
+		else if (strcmp(arg, "--dynamic-resolution") == 0 && hasValue)
+		{
+			params->dynamicResolutionTargetMS = atof(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--no-pipeline-cache") == 0)
+		{
+			params->pipelineCacheFilename = "";
+		}
+		else if (strcmp(arg, "--width") == 0 && hasValue)
+		{
+			params->width = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--height") == 0 && hasValue)
+		{
+			params->height = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--frames") == 0 && hasValue)
+		{
+			params->numFrames = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--output") == 0 && hasValue)
+		{
+			params->outputFilename = argv[++argIdx];
+		}
+		else if (strcmp(arg, "--many-objects") == 0)
+		{
+			params->manyObjects = true;
+		}
+		else if (strcmp(arg, "--spheres") == 0 && hasValue)
+		{
+			params->numRandomSpheres = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--max-bounces") == 0 && hasValue)
+		{
+			params->maxBounces = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--rr-min-depth") == 0 && hasValue)
+		{
+			params->rrMinDepth = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--adaptive") == 0 && hasValue)
+		{
+			params->adaptiveThreshold = (float)atof(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--adaptive-min-samples") == 0 && hasValue)
+		{
+			params->adaptiveMinSamples = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--temporal") == 0 && hasValue)
+		{
+			params->temporalMaxHistoryFrames = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--backend") == 0 && hasValue)
+		{
+			const char * backendName = argv[++argIdx];
+			if (strcmp(backendName, "cpu") == 0)
+			{
+				params->isHeadless = true;
+				params->useCPUTracer = true;
+			}
+			else if (strcmp(backendName, "fragment") == 0)
+			{
+				params->tracerBackend = vulkan::Wrapper::TracerBackend::eFragment;
+			}
+			else if (strcmp(backendName, "compute") == 0)
+			{
+				params->tracerBackend = vulkan::Wrapper::TracerBackend::eCompute;
+			}
+			else if (strcmp(backendName, "wavefront") == 0)
+			{
+				params->tracerBackend = vulkan::Wrapper::TracerBackend::eWavefront;
+			}
+			else
+			{
+				printf("Unknown tracer backend %s\n", backendName);
+			}
+		}
+		else if (strcmp(arg, "--threads") == 0 && hasValue)
+		{
+			params->numThreads = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--cpu-no-steal") == 0)
+		{
+			params->cpuStaticScheduling = true;
+		}
+		else if (strcmp(arg, "--cpu-isa") == 0 && hasValue)
+		{
+			const char * isaName = argv[++argIdx];
+			if (strcmp(isaName, "auto") == 0)
+			{
+				params->cpuIsa = cpu::SimdIsa::eAuto;
+			}
+			else if (strcmp(isaName, "scalar") == 0)
+			{
+				params->cpuIsa = cpu::SimdIsa::eScalar;
+			}
+			else if (strcmp(isaName, "avx2") == 0)
+			{
+				params->cpuIsa = cpu::SimdIsa::eAVX2;
+			}
+			else if (strcmp(isaName, "avx512") == 0)
+			{
+				params->cpuIsa = cpu::SimdIsa::eAVX512;
+			}
+			else
+			{
+				printf("Unknown CPU instruction set %s\n", isaName);
+			}
+		}
+		else if (strcmp(arg, "--workgroup") == 0 && (argIdx + 2 < argc))
+		{
+			params->workgroupSizeX = atoi(argv[++argIdx]);
+			params->workgroupSizeY = atoi(argv[++argIdx]);
+		}
+		else if (strcmp(arg, "--tile") == 0 && (argIdx + 2 < argc))
+		{
+			params->tileSizeX = atoi(argv[++argIdx]);
+			params->tileSizeY = atoi(argv[++argIdx]);
+		}
+		else
+		{
+			printf("Unknown command line argument %s\n", arg);
+		}
+	}
+}
+
+static const char * getTracerBackendName(vulkan::Wrapper::TracerBackend backend)
+{
+	switch (backend)
+	{
+		case vulkan::Wrapper::TracerBackend::eFragment: return "fragment";
+		case vulkan::Wrapper::TracerBackend::eCompute: return "compute";
+		case vulkan::Wrapper::TracerBackend::eWavefront: return "wavefront";
+		default: return "unknown";
+	}
+}
+
+// Gathers GPU timings read back by the wrapper: accumulates averages for the periodic reports,
+//	and optionally logs every frame into the CSV file
+class GpuTimingsLog
+{
+public:
+	typedef vulkan::Wrapper::GpuTimer GpuTimer;
+	static const int c_numTimers = vulkan::Wrapper::eGpuTimerCount;
+
+	GpuTimingsLog()
+	{
+		resetAverages();
+	}
+	~GpuTimingsLog()
+	{
+		if (m_csvFile)
+		{
+			fclose(m_csvFile);
+		}
+	}
+
+	bool openCSV(const char * filename)
+	{
+		if (fopen_s(&m_csvFile, filename, "w") != 0 || m_csvFile == nullptr)
+		{
+			printf("Failed to open GPU timings file %s!\n", filename);
+			m_csvFile = nullptr;
+			return false;
+		}
+
+		fprintf(m_csvFile, "label,frame");
+		for (int timerIdx = 0; timerIdx < c_numTimers; ++timerIdx)
+		{
+			fprintf(m_csvFile, ",%s_ms", vulkan::Wrapper::getGpuTimerName((GpuTimer)timerIdx));
+		}
+		fprintf(m_csvFile, "\n");
+		return true;
+	}
+
+	// Should be called each frame, so that the wrapper doesn't drop the timings
+	void gather(vulkan::Wrapper * app, const char * label)
+	{
+		m_frameTimings.resize(0);
+		app->popGpuFrameTimings(&m_frameTimings);
+
+		for (const vulkan::Wrapper::GpuFrameTimings & frameTimings : m_frameTimings)
+		{
+			if (m_csvFile)
+			{
+				fprintf(m_csvFile, "%s,%llu", label, (unsigned long long)frameTimings.frameNumber);
+			}
+			for (int timerIdx = 0; timerIdx < c_numTimers; ++timerIdx)
+			{
+				const double timeMS = frameTimings.timesMS[timerIdx];
+				if (timeMS < 0.0)
+				{
+					// Timer wasn't recorded in this frame, the field is left empty
+					if (m_csvFile)
+					{
+						fprintf(m_csvFile, ",");
+					}
+					continue;
+				}
+
+				if (m_csvFile)
+				{
+					fprintf(m_csvFile, ",%.4f", timeMS);
+				}
+				m_sumTimesMS[timerIdx] += timeMS;
+				++m_numSamples[timerIdx];
+			}
+			if (m_csvFile)
+			{
+				fprintf(m_csvFile, "\n");
+			}
+		}
+	}
+
+	// Timings fetched by the last `gather` call
+	const std::vector<vulkan::Wrapper::GpuFrameTimings> & getLastFrameTimings() const { return m_frameTimings; }
+
+	// Negative if there were no samples since the last reset
+	double getAverageMS(GpuTimer timer) const
+	{
+		return (m_numSamples[timer] > 0) ? m_sumTimesMS[timer] / m_numSamples[timer] : -1.0;
+	}
+
+	void printAverages() const
+	{
+		if (m_numSamples[vulkan::Wrapper::eGpuTimerFrame] == 0)
+			return;
+
+		printf("GPU average over %d frames:", m_numSamples[vulkan::Wrapper::eGpuTimerFrame]);
+		for (int timerIdx = 0; timerIdx < c_numTimers; ++timerIdx)
+		{
+			if (m_numSamples[timerIdx] > 0)
+			{
+				printf(" %s %.3f ms", vulkan::Wrapper::getGpuTimerName((GpuTimer)timerIdx), getAverageMS((GpuTimer)timerIdx));
+			}
+		}
+		printf("\n");
+	}
+
+	void resetAverages()
+	{
+		for (int timerIdx = 0; timerIdx < c_numTimers; ++timerIdx)
+		{
+			m_sumTimesMS[timerIdx] = 0.0;
+			m_numSamples[timerIdx] = 0;
+		}
+		if (m_csvFile)
+		{
+			fflush(m_csvFile);
+		}
+	}
+
+private:
+	FILE * m_csvFile = nullptr;
+	std::vector<vulkan::Wrapper::GpuFrameTimings> m_frameTimings;
+	double m_sumTimesMS[c_numTimers];
+	int m_numSamples[c_numTimers];
+};
+
+static void buildScene(const CommandLineParams & params, scene::Scene * scene)
+{
+	scene::buildDefaultScene(scene, params.manyObjects);
+	if (params.numRandomSpheres > 0)
+	{
+		scene::addRandomSpheres(scene, params.numRandomSpheres, 1);
+	}
+}
+
+static void applyTracerParams(const CommandLineParams & params, vulkan::Wrapper * app)
+{
+	if (params.pipelineCacheFilename)
+	{
+		app->setPipelineCacheFilename(params.pipelineCacheFilename);
+	}
+	app->setTracerBackend(params.tracerBackend);
+	if (params.workgroupSizeX > 0 && params.workgroupSizeY > 0)
+	{
+		app->setComputeWorkgroupSize((uint32_t)params.workgroupSizeX, (uint32_t)params.workgroupSizeY);
+	}
+	if (params.tileSizeX >= 0 && params.tileSizeY >= 0)
+	{
+		app->setComputeTileSize((uint32_t)params.tileSizeX, (uint32_t)params.tileSizeY);
+	}
+
+	if (params.maxBounces > 0)
+	{
+		app->setMaxBounces((uint32_t)params.maxBounces);
+	}
+	if (params.rrMinDepth >= 0)
+	{
+		app->setRussianRouletteMinDepth((uint32_t)params.rrMinDepth);
+	}
+
+	if (params.adaptiveThreshold > 0.0f)
+	{
+		app->setAdaptiveSampling(true);
+		app->setAdaptiveErrorThreshold(params.adaptiveThreshold);
+	}
+	if (params.adaptiveMinSamples > 0)
+	{
+		app->setAdaptiveMinSamples((uint32_t)params.adaptiveMinSamples);
+	}
+	if (params.temporalMaxHistoryFrames > 0)
+	{
+		app->setTemporalReprojection(true);
+		app->setTemporalMaxHistoryFrames((uint32_t)params.temporalMaxHistoryFrames);
+	}
+	app->setRandomSeed(params.randomSeed);
+
+	scene::Scene scene;
+	buildScene(params, &scene);
+	app->setScene(scene);
+}
+
+// Renders fixed amount of frames without any window, and saves the last one into the file
+//	returns total time spent rendering, in milliseconds
+static double renderHeadless(const CommandLineParams & params, const char * outputFilename, GpuTimingsLog * gpuTimingsLog)
 {
 	using namespace windows;
 
+	vulkan::Wrapper testApp;
+	testApp.setDebugCallback(debugCallback);
+	// Still camera, so that the frames are accumulated into the final image
+	testApp.setIsCameraAnimated(false);
+	applyTracerParams(params, &testApp);
+	testApp.initHeadless(params.width, params.height);
+
+	Timer perfTimer;
+	perfTimer.start();
+
+	double totalTimeMS = 0.0;
+	double dtMS = 0.0;
+	for (int frameIdx = 0; frameIdx < params.numFrames; ++frameIdx)
+	{
+		testApp.update(dtMS);
+		testApp.render();
+		dtMS = perfTimer.time();
+		totalTimeMS += dtMS;
+		gpuTimingsLog->gather(&testApp, getTracerBackendName(params.tracerBackend));
+		perfTimer.start();
+	}
+
+	// Waits for the last frame to finish
+	testApp.saveOffscreenImage(outputFilename);
+	totalTimeMS += perfTimer.time();
+
+	// Last frames in flight are not read back yet
+	testApp.flushGpuTimers();
+	gpuTimingsLog->gather(&testApp, getTracerBackendName(params.tracerBackend));
+	gpuTimingsLog->printAverages();
+	gpuTimingsLog->resetAverages();
+
+	if (testApp.getAdaptiveSampling())
+	{
+		const uint64_t numPixels = (uint64_t)params.width * params.height;
+		const uint64_t numUniformSamples = numPixels * testApp.getSamplesPerFrame() * testApp.getAccumFrameCount();
+		const uint64_t numSamples = testApp.countAccumulatedSamples();
+		printf("Adaptive sampling: %llu samples (%.1f per pixel), uniform sampling would take %llu (%.2fx more)\n",
+			numSamples,
+			(numPixels > 0) ? numSamples / (double)numPixels : 0.0,
+			numUniformSamples,
+			(numSamples > 0) ? numUniformSamples / (double)numSamples : 0.0
+			);
+	}
+
+	testApp.deinit();
+
+	return totalTimeMS;
+}
+
+// Same as `renderHeadless`, but with the CPU reference tracer, no Vulkan instance or device is created
+static double renderCPU(const CommandLineParams & params, const char * outputFilename, cpu::RenderStats * renderStats, cpu::SimdIsa * isaUsed)
+{
+	using namespace windows;
+
+	scene::Scene scene;
+	buildScene(params, &scene);
+
+	// Still camera, same as the headless GPU rendering
+	scene::Camera camera;
+	scene::buildDefaultCamera(&camera, 0.0, params.width / (float)params.height);
+
+	cpu::PathTracer pathTracer;
+	pathTracer.setScene(scene);
+	pathTracer.setCamera(camera);
+
+	// Rest of the render parameters defaults match the GPU backends
+	cpu::RenderParams renderParams;
+	renderParams.width = params.width;
+	renderParams.height = params.height;
+	renderParams.numFrames = params.numFrames;
+	renderParams.isa = params.cpuIsa;
+	renderParams.isWorkStealingEnabled = !params.cpuStaticScheduling;
+	renderParams.randomSeed = params.randomSeed;
+	// Same option as the compute backend tiles, 0 means default
+	if (params.tileSizeX > 0 && params.tileSizeY > 0)
+	{
+		renderParams.tileWidth = params.tileSizeX;
+		renderParams.tileHeight = params.tileSizeY;
+	}
+	if (params.maxBounces > 0)
+	{
+		renderParams.maxBounces = (uint32_t)params.maxBounces;
+	}
+	if (params.rrMinDepth >= 0)
+	{
+		renderParams.rrMinDepth = (uint32_t)params.rrMinDepth;
+	}
+
+	cpu::ThreadPool threadPool(params.numThreads);
+	if (isaUsed)
+	{
+		*isaUsed = cpu::getSphereKernels(renderParams.isa).isa;
+	}
+
+	Timer perfTimer;
+	perfTimer.start();
+
+	std::vector<float> pixels;
+	pathTracer.render(renderParams, &threadPool, &pixels, renderStats);
+
+	double totalTimeMS = perfTimer.time();
+
+	cpu::saveImagePPM(outputFilename, params.width, params.height, pixels);
+
+	return totalTimeMS;
+}
+
+struct FrameTimeStats
+{
+	int numFrames = 0;
+	double minMS = 0.0;
+	double avgMS = 0.0;
+	double p50MS = 0.0;
+	double p95MS = 0.0;
+	double p99MS = 0.0;
+	double maxMS = 0.0;
+};
+
+// Percentiles use the nearest rank, i.e. they are always one of the measured times
+static FrameTimeStats computeFrameTimeStats(std::vector<double> timesMS)
+{
+	FrameTimeStats stats;
+	if (timesMS.empty())
+		return stats;
+
+	std::sort(timesMS.begin(), timesMS.end());
+	const size_t numTimes = timesMS.size();
+	auto getPercentile = [&timesMS, numTimes](double percentile) -> double
+	{
+		const size_t rank = (size_t)ceil(percentile * 0.01 * numTimes);
+		return timesMS[std::min(std::max(rank, (size_t)1), numTimes) - 1];
+	};
+
+	double sumMS = 0.0;
+	for (double timeMS : timesMS)
+	{
+		sumMS += timeMS;
+	}
+
+	stats.numFrames = (int)numTimes;
+	stats.minMS = timesMS.front();
+	stats.avgMS = sumMS / numTimes;
+	stats.p50MS = getPercentile(50.0);
+	stats.p95MS = getPercentile(95.0);
+	stats.p99MS = getPercentile(99.0);
+	stats.maxMS = timesMS.back();
+	return stats;
+}
+
+static void writeFrameTimeStatsJSON(FILE * file, const FrameTimeStats & stats)
+{
+	fprintf(file, "{ \"frames\": %d, \"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+		stats.numFrames, stats.minMS, stats.avgMS, stats.p50MS, stats.p95MS, stats.p99MS, stats.maxMS
+		);
+}
+
+// Renders the same frames in each run: the camera orbit is driven by the virtual time derived from the frame
+//	index instead of the wall clock, random sequences by the frame index and the fixed random seed; warm-up frames are
+//	rendered the same way but excluded from the statistics, which are written into the JSON file
+static int runBenchmark(const CommandLineParams & params, GpuTimingsLog * gpuTimingsLog)
+{
+	using namespace windows;
+
+	const char * backendName = getTracerBackendName(params.tracerBackend);
+	const int numWarmupFrames = std::max(params.numWarmupFrames, 0);
+	const int numMeasuredFrames = std::max(params.numFrames, 0);
+
+	vulkan::Wrapper testApp;
+	testApp.setDebugCallback(debugCallback);
+	// Scripted camera path, each frame restarts the accumulation so that the work per frame is constant
+	testApp.setIsCameraAnimated(true);
+	applyTracerParams(params, &testApp);
+	testApp.initHeadless(params.width, params.height);
+
+	std::vector<double> frameTimesMS;
+	frameTimesMS.reserve(numMeasuredFrames);
+	std::vector<double> gpuTimesMS[GpuTimingsLog::c_numTimers];
+	auto gatherGpuTimings = [&]()
+	{
+		gpuTimingsLog->gather(&testApp, backendName);
+		for (const vulkan::Wrapper::GpuFrameTimings & frameTimings : gpuTimingsLog->getLastFrameTimings())
+		{
+			// Frame numbers count every recorded frame, warm-up ones included
+			if (frameTimings.frameNumber < (uint64_t)numWarmupFrames)
+				continue;
+
+			for (int timerIdx = 0; timerIdx < GpuTimingsLog::c_numTimers; ++timerIdx)
+			{
+				if (frameTimings.timesMS[timerIdx] >= 0.0)
+				{
+					gpuTimesMS[timerIdx].push_back(frameTimings.timesMS[timerIdx]);
+				}
+			}
+		}
+	};
+
+	Timer perfTimer;
+	double totalTimeMS = 0.0;
+	for (int frameIdx = 0; frameIdx < numWarmupFrames + numMeasuredFrames; ++frameIdx)
+	{
+		perfTimer.start();
+		// Virtual time of the first frame is zero, same as in the CPU tracer
+		testApp.update((frameIdx > 0) ? params.benchmarkFrameTimeMS : 0.0);
+		testApp.render();
+		const double frameTimeMS = perfTimer.time();
+
+		if (frameIdx >= numWarmupFrames)
+		{
+			frameTimesMS.push_back(frameTimeMS);
+			totalTimeMS += frameTimeMS;
+		}
+		gatherGpuTimings();
+	}
+
+	// Frames still in flight only count towards the total time
+	perfTimer.start();
+	testApp.waitIdle();
+	totalTimeMS += perfTimer.time();
+
+	testApp.flushGpuTimers();
+	gatherGpuTimings();
+	gpuTimingsLog->resetAverages();
+
+	testApp.saveOffscreenImage(params.outputFilename);
+
+	const uint64_t numSamples = (uint64_t)params.width * params.height * testApp.getSamplesPerFrame() * numMeasuredFrames;
+	const double samplesPerSecond = (totalTimeMS > 0.0) ? numSamples / (totalTimeMS * 0.001) : 0.0;
+	const FrameTimeStats frameTimeStats = computeFrameTimeStats(frameTimesMS);
+	const FrameTimeStats gpuFrameTimeStats = computeFrameTimeStats(gpuTimesMS[vulkan::Wrapper::eGpuTimerFrame]);
+
+	vulkan::MemoryAllocatorStats memoryStats;
+	testApp.getMemoryStats(&memoryStats);
+
+	testApp.deinit();
+
+	printf("Benchmark %s, %d frames (%dx%d) after %d warm-up frames, seed %u:\n",
+		backendName, numMeasuredFrames, params.width, params.height, numWarmupFrames, params.randomSeed
+		);
+	printf("  frame time: min %.3f ms, avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms\n",
+		frameTimeStats.minMS, frameTimeStats.avgMS, frameTimeStats.p50MS, frameTimeStats.p95MS, frameTimeStats.p99MS
+		);
+	if (gpuFrameTimeStats.numFrames > 0)
+	{
+		printf("  GPU time:   min %.3f ms, avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms\n",
+			gpuFrameTimeStats.minMS, gpuFrameTimeStats.avgMS, gpuFrameTimeStats.p50MS, gpuFrameTimeStats.p95MS, gpuFrameTimeStats.p99MS
+			);
+	}
+	printf("  %.1f Msamples/s\n", samplesPerSecond * 1e-6);
+	printf("  device memory: %.1f MB in use, %.1f MB in %u blocks (%u dedicated), fragmentation %.3f\n",
+		memoryStats.bytesInUse / (1024.0 * 1024.0), memoryStats.bytesAllocated / (1024.0 * 1024.0),
+		memoryStats.numBlocks, memoryStats.numDedicatedBlocks, memoryStats.fragmentation
+		);
+
+	FILE * jsonFile = nullptr;
+	if (fopen_s(&jsonFile, params.benchmarkFilename, "w") != 0 || jsonFile == nullptr)
+	{
+		printf("Failed to open benchmark file %s!\n", params.benchmarkFilename);
+		return 1;
+	}
+
+	fprintf(jsonFile, "{\n");
+	fprintf(jsonFile, "\t\"backend\": \"%s\",\n", backendName);
+	fprintf(jsonFile, "\t\"width\": %d,\n", params.width);
+	fprintf(jsonFile, "\t\"height\": %d,\n", params.height);
+	fprintf(jsonFile, "\t\"frames\": %d,\n", numMeasuredFrames);
+	fprintf(jsonFile, "\t\"warmup_frames\": %d,\n", numWarmupFrames);
+	fprintf(jsonFile, "\t\"seed\": %u,\n", params.randomSeed);
+	fprintf(jsonFile, "\t\"virtual_frame_time_ms\": %.4f,\n", params.benchmarkFrameTimeMS);
+	fprintf(jsonFile, "\t\"total_time_ms\": %.4f,\n", totalTimeMS);
+	fprintf(jsonFile, "\t\"samples\": %llu,\n", (unsigned long long)numSamples);
+	fprintf(jsonFile, "\t\"samples_per_sec\": %.1f,\n", samplesPerSecond);
+	fprintf(jsonFile, "\t\"frame_time_ms\": ");
+	writeFrameTimeStatsJSON(jsonFile, frameTimeStats);
+	fprintf(jsonFile, ",\n");
+	// Timers that weren't recorded by the backend, or all of them when timestamps aren't supported, are omitted
+	fprintf(jsonFile, "\t\"gpu_time_ms\": {");
+	bool isFirstTimer = true;
+	for (int timerIdx = 0; timerIdx < GpuTimingsLog::c_numTimers; ++timerIdx)
+	{
+		if (gpuTimesMS[timerIdx].empty())
+			continue;
+
+		fprintf(jsonFile, "%s\n\t\t\"%s\": ", isFirstTimer ? "" : ",", vulkan::Wrapper::getGpuTimerName((GpuTimingsLog::GpuTimer)timerIdx));
+		writeFrameTimeStatsJSON(jsonFile, computeFrameTimeStats(gpuTimesMS[timerIdx]));
+		isFirstTimer = false;
+	}
+	fprintf(jsonFile, "%s},\n", isFirstTimer ? "" : "\n\t");
+	fprintf(jsonFile, "\t\"device_memory\": { \"blocks\": %u, \"dedicated_blocks\": %u, \"allocated_bytes\": %llu, \"allocations\": %u, \"bytes_in_use\": %llu, ",
+		memoryStats.numBlocks, memoryStats.numDedicatedBlocks, (unsigned long long)memoryStats.bytesAllocated,
+		memoryStats.numAllocations, (unsigned long long)memoryStats.bytesInUse
+		);
+	fprintf(jsonFile, "\"free_ranges\": %u, \"largest_free_range\": %llu, \"fragmentation\": %.4f, \"staging_ring_bytes\": %llu, \"staging_fallbacks\": %u }\n",
+		memoryStats.numFreeRanges, (unsigned long long)memoryStats.largestFreeRange, memoryStats.fragmentation,
+		(unsigned long long)memoryStats.stagingRingSize, memoryStats.numStagingFallbacks
+		);
+	fprintf(jsonFile, "}\n");
+	fclose(jsonFile);
+
+	printf("Benchmark results saved to %s\n", params.benchmarkFilename);
+	return 0;
+}
+
+static int runHeadless(const CommandLineParams & params)
+{
+	if (params.useCPUTracer)
+	{
+		if (params.benchmarkFilename)
+		{
+			printf("Benchmark mode requires one of the GPU backends\n");
+			return 1;
+		}
+
+		cpu::RenderStats renderStats;
+		cpu::SimdIsa isa = cpu::SimdIsa::eScalar;
+		double totalTimeMS = renderCPU(params, params.outputFilename, &renderStats, &isa);
+		const int numThreads = (int)renderStats.threads.size();
+		printf("Rendered %d frames (%dx%d) on CPU with %d threads (%s) in %.1f ms (%.3f ms per frame), saved to %s\n",
+			params.numFrames, params.width, params.height, numThreads, cpu::getSimdIsaName(isa), totalTimeMS,
+			(params.numFrames > 0) ? totalTimeMS / params.numFrames : 0.0,
+			params.outputFilename
+			);
+
+		// Idle time is what the threads spend waiting for the slowest one at the end of each frame
+		double totalBusyTimeMS = 0.0;
+		for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+		{
+			const cpu::RenderThreadStats & threadStats = renderStats.threads[threadIdx];
+			printf("  thread %2d: busy %8.1f ms, idle %8.1f ms, %5u tiles (%u stolen in %u steals)\n",
+				threadIdx, threadStats.busyTimeMS, threadStats.idleTimeMS,
+				threadStats.numTiles, threadStats.numStolenTiles, threadStats.numSteals
+				);
+			totalBusyTimeMS += threadStats.busyTimeMS;
+		}
+		if (numThreads > 0 && renderStats.totalTimeMS > 0.0)
+		{
+			printf("Thread utilization %.1f%% (%s scheduling)\n",
+				100.0 * totalBusyTimeMS / (numThreads * renderStats.totalTimeMS),
+				params.cpuStaticScheduling ? "static" : "work stealing"
+				);
+		}
+		return 0;
+	}
+
+	GpuTimingsLog gpuTimingsLog;
+	if (params.gpuTimingsFilename)
+	{
+		gpuTimingsLog.openCSV(params.gpuTimingsFilename);
+	}
+
+	if (params.benchmarkFilename)
+	{
+		return runBenchmark(params, &gpuTimingsLog);
+	}
+
+	if (!params.compareBackends)
+	{
+		double totalTimeMS = renderHeadless(params, params.outputFilename, &gpuTimingsLog);
+		printf("Rendered %d frames (%dx%d) in %.1f ms (%.3f ms per frame), saved to %s\n",
+			params.numFrames, params.width, params.height, totalTimeMS,
+			(params.numFrames > 0) ? totalTimeMS / params.numFrames : 0.0,
+			params.outputFilename
+			);
+		return 0;
+	}
+
+	struct BackendDesc
+	{
+		vulkan::Wrapper::TracerBackend backend;
+		const char * name;
+	};
+	const BackendDesc backends[] =
+	{
+		{ vulkan::Wrapper::TracerBackend::eFragment, "fragment" },
+		{ vulkan::Wrapper::TracerBackend::eCompute, "compute" },
+		{ vulkan::Wrapper::TracerBackend::eWavefront, "wavefront" },
+	};
+	const int numBackends = (int)(sizeof(backends) / sizeof(backends[0]));
+
+	double backendTimesMS[numBackends];
+	for (int backendIdx = 0; backendIdx < numBackends; ++backendIdx)
+	{
+		CommandLineParams backendParams = params;
+		backendParams.tracerBackend = backends[backendIdx].backend;
+
+		// Each backend result is saved separately, so that the images could be compared as well
+		const int filenameBufSize = 256;
+		char outputFilename[filenameBufSize];
+		sprintf_s(outputFilename, filenameBufSize, "%s_%s.ppm", params.outputFilename, backends[backendIdx].name);
+
+		backendTimesMS[backendIdx] = renderHeadless(backendParams, outputFilename, &gpuTimingsLog);
+	}
+
+	// Fragment shader megakernel is the baseline
+	printf("Backends comparison, %d frames (%dx%d):\n", params.numFrames, params.width, params.height);
+	for (int backendIdx = 0; backendIdx < numBackends; ++backendIdx)
+	{
+		printf("  %-10s %10.1f ms total, %8.3f ms per frame, %5.2fx speedup vs %s\n",
+			backends[backendIdx].name,
+			backendTimesMS[backendIdx],
+			(params.numFrames > 0) ? backendTimesMS[backendIdx] / params.numFrames : 0.0,
+			(backendTimesMS[backendIdx] > 0.0) ? backendTimesMS[0] / backendTimesMS[backendIdx] : 0.0,
+			backends[0].name
+			);
+	}
+
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	using namespace windows;
+
+	CommandLineParams commandLineParams;
+	parseCommandLine(argc, argv, &commandLineParams);
+
+	if (commandLineParams.isHeadless)
+	{
+		return runHeadless(commandLineParams);
+	}
+
 	Timer perfTimer;
 
 	Window window;
-	window.setParameters(800, 600, Window::Kind::eWindowed);
+	window.setParameters(commandLineParams.width, commandLineParams.height, Window::Kind::eWindowed);
 	window.init();
 
 	MSG msg;
@@ -120,12 +971,27 @@ int main()
 	setUserDataPointer(&testApp);
 
 	testApp.setDebugCallback(debugCallback);
+	applyTracerParams(commandLineParams, &testApp);
+	if (commandLineParams.dynamicResolutionTargetMS > 0.0)
+	{
+		if (commandLineParams.tracerBackend == vulkan::Wrapper::TracerBackend::eFragment)
+		{
+			printf("Dynamic resolution requires compute or wavefront backend, ignored\n");
+		}
+		testApp.setDynamicResolution(true, commandLineParams.dynamicResolutionTargetMS);
+	}
 	testApp.init(window.getHWnd(), window.getWidth(), window.getHeight());
 
 	setResizeCallback(resizeCallback);
 	setChangeFocusCallback(chageFocusCallback);
 	setKeyStateCallback(keyStateCallback);
 
+	GpuTimingsLog gpuTimingsLog;
+	if (commandLineParams.gpuTimingsFilename)
+	{
+		gpuTimingsLog.openCSV(commandLineParams.gpuTimingsFilename);
+	}
+
 	double accumTime = 0.0;
 	int accumFrames = 0;
 	perfTimer.start();
@@ -160,9 +1026,21 @@ int main()
 		dtMS = perfTimer.time();
 		accumTime += dtMS;
 		++accumFrames;
+		gpuTimingsLog.gather(&testApp, getTracerBackendName(testApp.getTracerBackend()));
 		if (accumTime > 500.0)
 		{
-			testApp.setDTime(accumTime / (float)accumFrames);
+			// CPU frame time includes presentation and vsync waits, GPU frame time is what the passes take
+			testApp.setDTime(accumTime / (float)accumFrames, gpuTimingsLog.getAverageMS(vulkan::Wrapper::eGpuTimerFrame));
+			if (commandLineParams.printGpuTimings)
+			{
+				gpuTimingsLog.printAverages();
+				if (testApp.getDynamicResolution())
+				{
+					const VkExtent2D renderExtent = testApp.getRenderExtent();
+					printf("Render extent %ux%u\n", renderExtent.width, renderExtent.height);
+				}
+			}
+			gpuTimingsLog.resetAverages();
 			accumTime = 0.0;
 			accumFrames = 0;
 		}
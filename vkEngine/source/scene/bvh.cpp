@@ -0,0 +1,286 @@
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#include "scene/bvh.h"
+
+namespace scene
+{
+	using namespace math;
+
+	struct AABB
+	{
+		float min[3];
+		float max[3];
+
+		void reset()
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = FLT_MAX;
+				max[axis] = -FLT_MAX;
+			}
+		}
+		void grow(const AABB & other)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], other.min[axis]);
+				max[axis] = std::max(max[axis], other.max[axis]);
+			}
+		}
+		void grow(const float point[3])
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], point[axis]);
+				max[axis] = std::max(max[axis], point[axis]);
+			}
+		}
+		float halfArea() const
+		{
+			if (min[0] > max[0])
+				return 0.0f;
+			float ex = max[0] - min[0], ey = max[1] - min[1], ez = max[2] - min[2];
+			return ex*ey + ey*ez + ez*ex;
+		}
+	};
+
+	struct PrimInfo
+	{
+		AABB bounds;
+		float centroid[3];
+	};
+
+	struct BuildTask
+	{
+		uint32_t start;
+		uint32_t end;
+		// Interior node which should reference this one as the right child, -1 if none
+		int32_t parentIdx;
+		// Root is at depth 0
+		uint32_t depth;
+	};
+
+	// Amount of levels that the subtree over `count` primitives needs at least, i.e. with the median splits
+	static uint32_t getMinSubtreeDepth(uint32_t count, uint32_t maxLeafSize)
+	{
+		uint32_t depth = 1;
+		while (count > maxLeafSize)
+		{
+			count = (count + 1) / 2;
+			++depth;
+		}
+		return depth;
+	}
+
+	void buildBVH(
+			const std::vector<Sphere> & spheres,
+			const BVHBuildParams & buildParams,
+			std::vector<BVHNode> * nodes,
+			std::vector<uint32_t> * primIndices
+			)
+	{
+		nodes->resize(0);
+		primIndices->resize(0);
+
+		const uint32_t numPrims = (uint32_t)spheres.size();
+		if (numPrims == 0)
+			return;
+
+		std::vector<PrimInfo> primInfos(numPrims);
+		for (uint32_t primIdx = 0; primIdx < numPrims; ++primIdx)
+		{
+			const Sphere & sphere = spheres[primIdx];
+			const float center[3] = { sphere.center.x, sphere.center.y, sphere.center.z };
+			const float radius = fabsf(sphere.radius);
+
+			PrimInfo & primInfo = primInfos[primIdx];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				primInfo.bounds.min[axis] = center[axis] - radius;
+				primInfo.bounds.max[axis] = center[axis] + radius;
+				primInfo.centroid[axis] = center[axis];
+			}
+		}
+
+		primIndices->resize(numPrims);
+		for (uint32_t primIdx = 0; primIdx < numPrims; ++primIdx)
+		{
+			(*primIndices)[primIdx] = primIdx;
+		}
+		uint32_t * indices = primIndices->data();
+
+		// Binary tree with at least one primitive per leaf
+		nodes->reserve(2 * numPrims - 1);
+
+		const uint32_t maxLeafSize = (uint32_t)std::max(buildParams.maxLeafSize, 1);
+		const int numBins = std::max(buildParams.numBins, 2);
+		std::vector<AABB> binBounds(numBins);
+		std::vector<uint32_t> binCounts(numBins);
+		std::vector<float> rightCosts(numBins);
+
+		// Explicit stack instead of recursion, since degenerate inputs could produce very deep trees
+		std::vector<BuildTask> buildStack;
+		buildStack.push_back({ 0, numPrims, -1, 0 });
+		while (!buildStack.empty())
+		{
+			BuildTask task = buildStack.back();
+			buildStack.pop_back();
+
+			// Splits below keep enough levels for the median splits of the children
+			assert(task.depth < (uint32_t)c_bvhMaxDepth && "BVH is deeper than the traversal stack!");
+			const uint32_t numChildLevels = (uint32_t)c_bvhMaxDepth - task.depth - 1;
+
+			const int32_t nodeIdx = (int32_t)nodes->size();
+			if (task.parentIdx >= 0)
+			{
+				(*nodes)[task.parentIdx].rightOrFirst = nodeIdx;
+			}
+			nodes->push_back(BVHNode());
+
+			AABB nodeBounds, centroidBounds;
+			nodeBounds.reset();
+			centroidBounds.reset();
+			for (uint32_t i = task.start; i < task.end; ++i)
+			{
+				const PrimInfo & primInfo = primInfos[indices[i]];
+				nodeBounds.grow(primInfo.bounds);
+				centroidBounds.grow(primInfo.centroid);
+			}
+
+			const uint32_t count = task.end - task.start;
+
+			// Find the best split among all axes using binned SAH
+			int bestAxis = -1;
+			int bestSplitBin = -1;
+			float bestCost = FLT_MAX;
+			if (count > (uint32_t)buildParams.minLeafSize)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const float axisMin = centroidBounds.min[axis];
+					const float axisExtent = centroidBounds.max[axis] - axisMin;
+					if (axisExtent <= 0.0f)
+						continue;
+
+					const float binScale = numBins / axisExtent;
+					for (int binIdx = 0; binIdx < numBins; ++binIdx)
+					{
+						binBounds[binIdx].reset();
+						binCounts[binIdx] = 0;
+					}
+					for (uint32_t i = task.start; i < task.end; ++i)
+					{
+						const PrimInfo & primInfo = primInfos[indices[i]];
+						int binIdx = std::min((int)((primInfo.centroid[axis] - axisMin) * binScale), numBins - 1);
+						binBounds[binIdx].grow(primInfo.bounds);
+						++binCounts[binIdx];
+					}
+
+					// Sweep from the right to get costs of the right partitions, then from the left
+					AABB accumBounds;
+					accumBounds.reset();
+					uint32_t accumCount = 0;
+					for (int binIdx = numBins - 1; binIdx > 0; --binIdx)
+					{
+						accumBounds.grow(binBounds[binIdx]);
+						accumCount += binCounts[binIdx];
+						rightCosts[binIdx] = accumCount * accumBounds.halfArea();
+					}
+					accumBounds.reset();
+					accumCount = 0;
+					for (int binIdx = 0; binIdx < numBins - 1; ++binIdx)
+					{
+						accumBounds.grow(binBounds[binIdx]);
+						accumCount += binCounts[binIdx];
+						if (accumCount == 0 || accumCount == count)
+							continue;
+
+						// Lopsided (e.g. 1 vs N-1) splits are only allowed while the depth limit can still be met
+						if (getMinSubtreeDepth(std::max(accumCount, count - accumCount), maxLeafSize) > numChildLevels)
+							continue;
+
+						// Split happens after `binIdx`
+						float cost = accumCount * accumBounds.halfArea() + rightCosts[binIdx + 1];
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplitBin = binIdx;
+						}
+					}
+				}
+			}
+
+			const float nodeHalfArea = nodeBounds.halfArea();
+			const float leafCost = count * nodeHalfArea;
+			const float splitCost = buildParams.traversalCost * nodeHalfArea + bestCost;
+
+			bool makeLeaf = (bestAxis < 0);
+			if (!makeLeaf && count <= maxLeafSize && splitCost >= leafCost)
+			{
+				makeLeaf = true;
+			}
+
+			uint32_t mid = task.start;
+			if (makeLeaf && count > maxLeafSize)
+			{
+				// Too many primitives for a leaf, but no SAH split is possible (e.g. coincident centroids, or
+				//	the depth limit), split the range in half around the median centroid along the widest axis
+				mid = task.start + count / 2;
+				makeLeaf = false;
+
+				int widestAxis = 0;
+				for (int axis = 1; axis < 3; ++axis)
+				{
+					if (centroidBounds.max[axis] - centroidBounds.min[axis] > centroidBounds.max[widestAxis] - centroidBounds.min[widestAxis])
+					{
+						widestAxis = axis;
+					}
+				}
+				std::nth_element(indices + task.start, indices + mid, indices + task.end,
+					[&](uint32_t primIdxL, uint32_t primIdxR)
+					{
+						return primInfos[primIdxL].centroid[widestAxis] < primInfos[primIdxR].centroid[widestAxis];
+					});
+			}
+			else if (!makeLeaf)
+			{
+				const float axisMin = centroidBounds.min[bestAxis];
+				const float binScale = numBins / (centroidBounds.max[bestAxis] - axisMin);
+				uint32_t * midPtr = std::partition(indices + task.start, indices + task.end,
+					[&](uint32_t primIdx)
+					{
+						int binIdx = std::min((int)((primInfos[primIdx].centroid[bestAxis] - axisMin) * binScale), numBins - 1);
+						return binIdx <= bestSplitBin;
+					});
+				mid = (uint32_t)(midPtr - indices);
+			}
+
+			BVHNode & node = (*nodes)[nodeIdx];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				node.boundsMin[axis] = nodeBounds.min[axis];
+				node.boundsMax[axis] = nodeBounds.max[axis];
+			}
+
+			if (makeLeaf)
+			{
+				node.rightOrFirst = (int32_t)task.start;
+				node.count = (int32_t)count;
+			}
+			else
+			{
+				// Right child index is filled when the right child is built
+				node.rightOrFirst = -1;
+				node.count = 0;
+
+				// Left child is pushed last so that it is built right after the parent
+				buildStack.push_back({ mid, task.end, nodeIdx, task.depth + 1 });
+				buildStack.push_back({ task.start, mid, -1, task.depth + 1 });
+			}
+		}
+	}
+}
\ No newline at end of file
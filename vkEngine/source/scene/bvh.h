@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "scene/scene.h"
+
+namespace scene
+{
+	// Flattened BVH node, layout should match `BVHNode` (std430) in `pathtracer.glsl`
+	//	nodes are stored depth-first, so left child of the interior node always immediately follows it
+	struct BVHNode
+	{
+		float boundsMin[3];
+		// Interior node: index of the right child; leaf: index of the first primitive
+		int32_t rightOrFirst;
+		float boundsMax[3];
+		// Interior node: 0; leaf: number of primitives
+		int32_t count;
+	};
+
+	// Builder never produces trees deeper than this, so that the traversal stacks never overflow;
+	//	should match `BVH_STACK_SIZE` in `pathtracer.glsl`
+	static const int c_bvhMaxDepth = 64;
+
+	struct BVHBuildParams
+	{
+		// Number of buckets that primitive centroids are binned into along each axis to evaluate SAH
+		int numBins = 16;
+		// Leaves with this or fewer primitives are never split
+		int minLeafSize = 1;
+		// Leaves with more primitives are always split, even if SAH suggests otherwise
+		int maxLeafSize = 8;
+		// Cost of traversing the interior node relative to the cost of primitive intersection
+		float traversalCost = 1.0f;
+	};
+
+	// Builds binned-SAH BVH over the sphere bounds
+	//	`primIndices` receives the order in which primitives should be laid out, so that leaves reference
+	//	contiguous primitive ranges
+	void buildBVH(
+			const std::vector<Sphere> & spheres,
+			const BVHBuildParams & buildParams,
+			std::vector<BVHNode> * nodes,
+			std::vector<uint32_t> * primIndices
+			);
+}
\ No newline at end of file
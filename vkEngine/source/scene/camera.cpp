@@ -0,0 +1,93 @@
+#include <math.h>
+
+#include "scene/camera.h"
+
+namespace scene
+{
+	using namespace math;
+
+	static Vec3 vec3Sub(const Vec3 & v0, const Vec3 & v1)
+	{
+		return Vec3C(v0.x - v1.x, v0.y - v1.y, v0.z - v1.z);
+	}
+	static Vec3 vec3Scale(const Vec3 & v, float s)
+	{
+		return Vec3C(v.x * s, v.y * s, v.z * s);
+	}
+	static Vec3 vec3Cross(const Vec3 & v0, const Vec3 & v1)
+	{
+		return Vec3C(v0.y*v1.z - v0.z*v1.y, v0.z*v1.x - v0.x*v1.z, v0.x*v1.y - v0.y*v1.x);
+	}
+	static float vec3Len(const Vec3 & v)
+	{
+		return sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
+	}
+	static Vec3 vec3Normalize(const Vec3 & v)
+	{
+		return vec3Scale(v, 1.0f / vec3Len(v));
+	}
+
+	void buildDefaultCamera(Camera * camera, double animTimeMS, float aspect)
+	{
+		if (camera == nullptr)
+			return;
+
+		camera->viewpoint = Vec3C(-2.0f * sinf((float)animTimeMS * 0.001f), 1.0f, 1.0f);
+		camera->viewtarget = Vec3C(0.0f, 0.0f, -1.0f);
+		camera->viewup = Vec3C(0.0f, 1.0f, 0.0f);
+		camera->fov = 90.0f * (3.14159265358979323846f / 180.0f);
+		camera->aspect = aspect;
+		camera->aperture = 0.25f;
+	}
+
+	void computeCameraRayGenParams(const Camera & camera, CameraRayGenParams * rayGenParams)
+	{
+		if (rayGenParams == nullptr)
+			return;
+
+		// Basis vectors
+		Vec3 basZ = vec3Normalize(vec3Sub(camera.viewpoint, camera.viewtarget));
+		Vec3 basX = vec3Normalize(vec3Cross(camera.viewup, basZ));
+		Vec3 basY = vec3Normalize(vec3Cross(basZ, basX));
+
+		// Since range is [-1; 1]
+		float fovTan = tanf(camera.fov / 2.0f);
+		Vec3 axisX = vec3Scale(basX, camera.aspect * fovTan);
+		Vec3 axisY = vec3Scale(basY, fovTan);
+
+		float lensRad = camera.aperture / 2.0f;
+		float focusDist = vec3Len(vec3Sub(camera.viewpoint, camera.viewtarget));
+
+		rayGenParams->origin = camera.viewpoint;
+		rayGenParams->axisX = vec3Scale(axisX, focusDist);
+		rayGenParams->axisY = vec3Scale(axisY, focusDist);
+		rayGenParams->lensX = vec3Scale(basX, lensRad);
+		rayGenParams->lensY = vec3Scale(basY, lensRad);
+
+		// Lower left corner
+		rayGenParams->lowerLeftCorner =
+			vec3Sub(
+				vec3Sub(
+					vec3Sub(camera.viewpoint, vec3Scale(rayGenParams->axisX, 0.5f)),
+					vec3Scale(rayGenParams->axisY, 0.5f)
+					),
+				vec3Scale(basZ, focusDist)
+				);
+	}
+
+	bool isCameraEqual(const Camera & camera0, const Camera & camera1)
+	{
+		auto isVec3Equal = [](const Vec3 & v0, const Vec3 & v1) -> bool
+		{
+			return (v0.x == v1.x) && (v0.y == v1.y) && (v0.z == v1.z);
+		};
+
+		return
+			isVec3Equal(camera0.viewpoint, camera1.viewpoint) &&
+			isVec3Equal(camera0.viewtarget, camera1.viewtarget) &&
+			isVec3Equal(camera0.viewup, camera1.viewup) &&
+			(camera0.fov == camera1.fov) &&
+			(camera0.aspect == camera1.aspect) &&
+			(camera0.aperture == camera1.aperture);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "math/vec3.h"
+
+namespace scene
+{
+	struct Camera
+	{
+		math::Vec3 viewpoint;
+		math::Vec3 viewtarget;
+		math::Vec3 viewup;
+
+		// Field of view, in radians
+		float fov;
+		float aspect;
+		// Lens diameter, focus distance is the distance between viewpoint and viewtarget
+		float aperture;
+	};
+
+	// Values required to generate primary rays, derived from the camera description
+	//	primary ray for the image point (u, v) in [0; 1] is:
+	//		O = origin + lensX*disk.x + lensY*disk.y
+	//		D = (lowerLeftCorner + u*axisX + v*axisY) - O
+	struct CameraRayGenParams
+	{
+		math::Vec3 origin;
+		math::Vec3 lowerLeftCorner;
+		// Image plane spans, already scaled by the focus distance
+		math::Vec3 axisX;
+		math::Vec3 axisY;
+		// Lens basis, already scaled by the lens radius
+		math::Vec3 lensX;
+		math::Vec3 lensY;
+	};
+
+	// Camera of the default scene, orbiting around it as the animation time goes
+	void buildDefaultCamera(Camera * camera, double animTimeMS, float aspect);
+
+	void computeCameraRayGenParams(const Camera & camera, CameraRayGenParams * rayGenParams);
+
+	bool isCameraEqual(const Camera & camera0, const Camera & camera1);
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+#include <algorithm>
+
+#include "scene/scene.h"
+
+namespace scene
+{
+	using namespace math;
+
+	void buildDefaultScene(Scene * scene, bool addSpheresGrid)
+	{
+		scene->clear();
+
+		scene->addMaterial(MaterialType::eLambert, Vec3C(0.1f, 0.2f, 0.4f));
+		scene->addMaterial(MaterialType::eMetal, Vec3C(0.45f, 0.45f, 0.45f), 0.55f);
+		scene->addMaterial(MaterialType::eMetal, Vec3C(0.75f, 0.45f, 0.05f), 0.1f);
+		scene->addMaterial(MaterialType::eGlass, Vec3C(0.95f, 0.95f, 0.95f), 0.0f, 1.5f);
+		scene->addMaterial(MaterialType::eLambert, Vec3C(0.5f, 0.45f, 0.05f));
+
+		scene->addSphere(Vec3C( 0.0f,    0.0f, -1.0f),   0.5f, eMaterialIdxBlueLambert);
+		scene->addSphere(Vec3C( 0.0f, -100.5f, -1.0f), 100.0f, eMaterialIdxOrangeLambert);
+		scene->addSphere(Vec3C( 1.0f,    0.0f, -1.0f),   0.5f, eMaterialIdxOrangeMetal2);
+		scene->addSphere(Vec3C(-1.0f,    0.0f, -1.0f),   0.5f, eMaterialIdxGlass);
+		scene->addSphere(Vec3C( 0.0f,   -0.5f, -2.0f),   0.5f, eMaterialIdxGreyMetal);
+		scene->addSphere(Vec3C( 0.0f,   -0.5f,  0.0f),   0.5f, eMaterialIdxGreyMetal);
+
+		if (!addSpheresGrid)
+			return;
+
+		// Pseudo-random offsets to break the grid regularity
+		const int numOffsets = 6;
+		const Vec3 offsets[numOffsets] =
+		{
+			Vec3C(-0.25f,  0.15f,  0.88f),
+			Vec3C( 0.12f, -0.73f, -0.45f),
+			Vec3C(-0.49f,  0.33f, -0.57f),
+			Vec3C( 0.92f, -0.15f,  0.41f),
+			Vec3C( 0.26f,  0.53f,  0.29f),
+			Vec3C(-0.39f, -0.25f, -0.72f),
+		};
+
+		int offsetCnt = 0;
+		for (int i = 0; i < 10; ++i)
+		{
+			for (int j = 0; j < 10; ++j)
+			{
+				++offsetCnt;
+				if (offsetCnt >= numOffsets)
+					offsetCnt = 0;
+
+				Vec3 offset = offsets[offsetCnt];
+				if (j < 5)
+					offset.z -= 0.5f;
+				else
+					offset.z += 0.5f;
+
+				Vec3 center = Vec3C(
+					(i*0.1f - 0.5f)*7.5f + 0.3f*offset.x,
+					-0.3f + 0.1f*offset.y,
+					(j*0.1f - 0.5f)*7.5f + 0.3f*offset.z
+					);
+				scene->addSphere(center, 0.1f, (i+j+1) & 3);
+			}
+		}
+	}
+
+	void addRandomSpheres(Scene * scene, int numSpheres, uint32_t seed)
+	{
+		// Simple LCG, so that the scene is the same across platforms for the same seed
+		uint32_t rngState = seed;
+		auto randFloat = [&rngState]() -> float
+		{
+			rngState = rngState * 1664525u + 1013904223u;
+			return (rngState >> 8) * (1.0f / 16777216.0f);
+		};
+
+		// Spheres density is kept roughly constant, so the scattering area grows with the amount of spheres
+		const float radius = 0.02f;
+		const float areaHalfSize = 0.1f * sqrtf((float)numSpheres);
+		for (int sphereIdx = 0; sphereIdx < numSpheres; ++sphereIdx)
+		{
+			Vec3 center = Vec3C(
+				(2.0f * randFloat() - 1.0f) * areaHalfSize,
+				-0.5f + radius + randFloat() * 0.5f,
+				-1.0f + (2.0f * randFloat() - 1.0f) * areaHalfSize
+				);
+			const int numMaterials = std::max((int)scene->materials.size(), 1);
+			int materialIndex = (int)(randFloat() * numMaterials);
+			scene->addSphere(center, radius, std::min(materialIndex, numMaterials - 1));
+		}
+	}
+}
\ No newline at end of file
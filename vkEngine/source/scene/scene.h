@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "math/vec3.h"
+
+namespace scene
+{
+	// Should match material type defines in `pathtracer.glsl`
+	enum class MaterialType : int
+	{
+		eLambert = 1,
+		eMetal = 2,
+		eGlass = 3,
+	};
+
+	struct Material
+	{
+		MaterialType type;
+		math::Vec3 albedo;
+		// Metal: fuzziness of the reflection; glass: fuzziness of the refraction
+		float roughness;
+		// Glass only: index of refraction
+		float refIdx;
+	};
+
+	// Materials of the default scene, in order they are added by `buildDefaultScene`
+	enum MaterialIdx : int
+	{
+		eMaterialIdxBlueLambert = 0,
+		eMaterialIdxGreyMetal = 1,
+		eMaterialIdxOrangeMetal2 = 2,
+		eMaterialIdxGlass = 3,
+		eMaterialIdxOrangeLambert = 4,
+	};
+
+	struct Sphere
+	{
+		math::Vec3 center;
+		float radius;
+		int materialIndex;
+	};
+
+	struct Scene
+	{
+		std::vector<Sphere> spheres;
+		std::vector<Material> materials;
+
+		void clear()
+		{
+			spheres.resize(0);
+			materials.resize(0);
+		}
+		// Returns index of the material that spheres should reference
+		int addMaterial(MaterialType type, const math::Vec3 & albedo, float roughness = 0.0f, float refIdx = 1.5f)
+		{
+			Material material;
+			material.type = type;
+			material.albedo = albedo;
+			material.roughness = roughness;
+			material.refIdx = refIdx;
+			materials.push_back(material);
+			return (int)materials.size() - 1;
+		}
+		void addSphere(const math::Vec3 & center, float radius, int materialIndex)
+		{
+			Sphere sphere;
+			sphere.center = center;
+			sphere.radius = radius;
+			sphere.materialIndex = materialIndex;
+			spheres.push_back(sphere);
+		}
+	};
+
+	// Test scene: several spheres on top of the huge "ground" sphere,
+	//	optionally with the grid of 100 small spheres around them
+	void buildDefaultScene(Scene * scene, bool addSpheresGrid = false);
+
+	// Adds the given amount of small spheres with random materials scattered on the ground of the default scene,
+	//	intended to stress-test the acceleration structure
+	void addRandomSpheres(Scene * scene, int numSpheres, uint32_t seed);
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "vulkan/basic.h"
+
+// Adaptive sampling
+//	tracing shaders accumulate per-pixel sample count, the mean luminance and the mean squared luminance of
+//	the individual samples (moments image); accumulation image alpha also counts the reprojected history. After the frame is traced, the mask
+//	pass estimates the relative error of each pixel mean, and writes the amount of samples the pixel should
+//	take in the next frame into the sample count image: the full per-frame amount if the error is above the
+//	threshold, or zero if the pixel is converged and should be skipped
+
+namespace vulkan
+{
+	void Wrapper::initAdaptiveSamplingImages()
+	{
+		const uint32_t width = m_vkSwapchainData.extent.width;
+		const uint32_t height = m_vkSwapchainData.extent.height;
+
+		createImage(
+			width,
+			height,
+			m_vkMomentsImageFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_vkMomentsImage,
+			&m_vkMomentsImageAllocation
+			);
+		createImage(
+			width,
+			height,
+			m_vkSampleCountImageFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_vkSampleCountImage,
+			&m_vkSampleCountImageAllocation
+			);
+
+		// Same as the accumulation image, contents are undefined, but they are not read until the first
+		//	frame after the accumulation restart fills them
+		initStorageImageLayout(m_vkMomentsImage, m_vkMomentsImageFormat);
+		initStorageImageLayout(m_vkSampleCountImage, m_vkSampleCountImageFormat);
+
+		m_vkMomentsImageView = createImageView2D(m_vkLogicalDeviceData.vkHandle, m_vkMomentsImage, m_vkMomentsImageFormat);
+		m_vkSampleCountImageView = createImageView2D(m_vkLogicalDeviceData.vkHandle, m_vkSampleCountImage, m_vkSampleCountImageFormat);
+
+		resetAccumulation();
+	}
+	void Wrapper::deinitAdaptiveSamplingImages()
+	{
+		vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkSampleCountImageView, nullptr);
+		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkSampleCountImage, nullptr);
+		m_memoryAllocator.free(&m_vkSampleCountImageAllocation);
+
+		vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkMomentsImageView, nullptr);
+		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkMomentsImage, nullptr);
+		m_memoryAllocator.free(&m_vkMomentsImageAllocation);
+	}
+
+	void Wrapper::initAdaptiveMaskPipeline()
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &m_vkUBODescriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(m_vkLogicalDeviceData.vkHandle, &pipelineLayoutCreateInfo, nullptr, &m_vkAdaptiveMaskPipelineLayout) != VK_SUCCESS)
+		{
+			printf("Failed to create adaptive mask pipeline layout!\n");
+		}
+
+		// Pipeline is created regardless of the adaptive sampling state, so that it could be toggled at runtime
+		VkShaderModule maskShaderModule = loadShaderModule("shaders/bin/adaptive_mask.cs.spv");
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePipelineCreateInfo.stage.module = maskShaderModule;
+		computePipelineCreateInfo.stage.pName = "main";
+		computePipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+		computePipelineCreateInfo.layout = m_vkAdaptiveMaskPipelineLayout;
+		computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		computePipelineCreateInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_vkAdaptiveMaskPipeline) != VK_SUCCESS)
+		{
+			printf("Failed to create adaptive mask pipeline!\n");
+		}
+
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, maskShaderModule, nullptr);
+	}
+	void Wrapper::deinitAdaptiveMaskPipeline()
+	{
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkAdaptiveMaskPipeline, nullptr);
+		vkDestroyPipelineLayout(m_vkLogicalDeviceData.vkHandle, m_vkAdaptiveMaskPipelineLayout, nullptr);
+	}
+
+	void Wrapper::recordAdaptiveMask(VkCommandBuffer commandBuffer, uint32_t frameIdx)
+	{
+		// Statistics are written by either fragment or compute tracing stages
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkAdaptiveMaskPipeline);
+		const uint32_t uboDynamicOffset = getUBODynamicOffset(frameIdx);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_vkAdaptiveMaskPipelineLayout,
+			0,
+			1,
+			&m_frames[frameIdx].descriptorSet,
+			1,
+			&uboDynamicOffset
+			);
+
+		// Should match the workgroup size in `adaptive_mask.cs`
+		const uint32_t maskWorkgroupSize = 8;
+		const uint32_t numGroupsX = (m_renderExtent.width + maskWorkgroupSize - 1) / maskWorkgroupSize;
+		const uint32_t numGroupsY = (m_renderExtent.height + maskWorkgroupSize - 1) / maskWorkgroupSize;
+		vkCmdDispatch(commandBuffer, numGroupsX, numGroupsY, 1);
+
+		// Next frame reads the mask, which is covered by the barrier at the beginning of its command buffer
+	}
+
+	uint64_t Wrapper::countAccumulatedSamples()
+	{
+		// Readback submission is ordered after the frames in flight, and its fence waits for them as well
+		// Only the render extent part of the accumulation image is traced
+		const uint32_t width = m_renderExtent.width;
+		const uint32_t height = m_renderExtent.height;
+		const size_t numPixels = (size_t)width * height;
+		const size_t readbackBufferSize = numPixels * 4 * sizeof(float);
+
+		VkBuffer readbackBuffer;
+		MemoryAllocation readbackBufferAllocation;
+		createStagingBuffer(
+			(VkDeviceSize)readbackBufferSize,
+			&readbackBuffer,
+			&readbackBufferAllocation
+			);
+
+		VkCommandBuffer transientCommandBuffer = beginTransientCommandBuffer();
+		{
+			// Moments image stays in the general layout, it only needs the shader writes to be visible
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			vkCmdPipelineBarrier(
+				transientCommandBuffer,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr
+				);
+
+			VkBufferImageCopy bufferImageCopyRegion = {};
+			bufferImageCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferImageCopyRegion.imageSubresource.mipLevel = 0;
+			bufferImageCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferImageCopyRegion.imageSubresource.layerCount = 1;
+			bufferImageCopyRegion.imageOffset = {0, 0, 0};
+			bufferImageCopyRegion.imageExtent = {width, height, 1};
+
+			vkCmdCopyImageToBuffer(
+				transientCommandBuffer,
+				m_vkMomentsImage,
+				VK_IMAGE_LAYOUT_GENERAL,
+				readbackBuffer,
+				1,
+				&bufferImageCopyRegion
+				);
+		}
+		endTransientCommandBuffer(transientCommandBuffer);
+
+		uint64_t numSamples = 0;
+
+		const float * momentsPixels = reinterpret_cast<const float *>(readbackBufferAllocation.mappedData);
+		for (size_t pixelIdx = 0; pixelIdx < numPixels; ++pixelIdx)
+		{
+			// Blue channel holds the per-pixel amount of the traced samples, unlike the accumulation alpha
+			//	it doesn't count the reprojected history
+			numSamples += (uint64_t)momentsPixels[pixelIdx * 4 + 2];
+		}
+
+		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, readbackBuffer, nullptr);
+		m_memoryAllocator.free(&readbackBufferAllocation);
+
+		return numSamples;
+	}
+}
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include <fstream>
+#include <math.h>
 #include <assert.h>
 
 #include "vulkan/basic.h"
+#include "image/ppm.h"
+#include "image/blue_noise.h"
 
 namespace vulkan
 {
@@ -50,7 +53,8 @@ namespace vulkan
 			VK_KHR_SURFACE_EXTENSION_NAME,			//"VK_KHR_surface",
 			VK_KHR_WIN32_SURFACE_EXTENSION_NAME		//"VK_KHR_win32_surface"
 		};
-		const uint32_t requiredExtensionCount = (uint32_t)(sizeof(requiredExtensions) / sizeof(const char *));
+		// Headless mode doesn't present anything, and hence doesn't need any of the surface extensions
+		const uint32_t requiredExtensionCount = m_isHeadless ? 0 : (uint32_t)(sizeof(requiredExtensions) / sizeof(const char *));
 
 		for (uint32_t i = 0; i < requiredExtensionCount; ++i)
 		{
@@ -229,7 +233,8 @@ namespace vulkan
 			{
 				hasGraphics = true;
 			}
-			if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT))
+			// Graphics and compute queues support transfers even if they don't report VK_QUEUE_TRANSFER_BIT
+			if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
 			{
 				hasMemoryTransfer = true;
 			}
@@ -238,11 +243,15 @@ namespace vulkan
 				hasCompute = true;
 			}
 
-			VkBool32 isPresentSupported = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(physDev, (uint32_t)qIdx, surface, &isPresentSupported);
-			if (queueFamily.queueCount > 0 && isPresentSupported)
+			// Presentation support could only be queried when there is a surface (i.e. not in headless mode)
+			if (surface != VK_NULL_HANDLE)
 			{
-				hasPresent = true;
+				VkBool32 isPresentSupported = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(physDev, (uint32_t)qIdx, surface, &isPresentSupported);
+				if (queueFamily.queueCount > 0 && isPresentSupported)
+				{
+					hasPresent = true;
+				}
 			}
 		}
 
@@ -284,10 +293,14 @@ namespace vulkan
 		VkPhysicalDeviceFeatures deviceFeatures;
 		vkGetPhysicalDeviceFeatures(physDev, &deviceFeatures);
 
-		// Only allowed to run on physical GPUs
-		//	(but maybe allow to run on CPUs as well? not important atm)
+		// Null surface means headless mode, which doesn't need presentation
+		const bool isHeadless = (surface == VK_NULL_HANDLE);
+
+		// Only allowed to run on physical GPUs in windowed mode
+		//	headless mode is also allowed to run on CPU implementations (e.g. lavapipe), to allow batch renders on machines without GPUs
 		if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-			deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
+			deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU &&
+			!(isHeadless && deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU))
 		{
 			return false;
 		}
@@ -295,11 +308,16 @@ namespace vulkan
 		{
 			return false;
 		}
+		// Path tracer writes into the accumulation storage image from the fragment shader
+		if (!deviceFeatures.fragmentStoresAndAtomics)
+		{
+			return false;
+		}
 
 		// TODO:
 		//	* prefer discrete over integrated
 		//	* prefer devices with presentable queue == graphics queue (possibly increased performance?)
-		if (!checkQueuesPresence(physDev, surface, true, true, false, false))
+		if (!checkQueuesPresence(physDev, surface, true, !isHeadless, true, false))
 		{
 			return false;
 		}
@@ -308,11 +326,10 @@ namespace vulkan
 		std::vector<VkExtensionProperties> curDeviceSupportedExtensions;
 		getGenericSupportedDeviceExtensionsList(physDev, &curDeviceSupportedExtensions);
 
-		bool anyExtensionNotFound = false;
-		for (const VkExtensionProperties & curDevProp : curDeviceSupportedExtensions)
+		for (const char * reqExtName : requiredExtensionNamesList)
 		{
 			bool extensionFound = false;
-			for (const char * reqExtName : requiredExtensionNamesList)
+			for (const VkExtensionProperties & curDevProp : curDeviceSupportedExtensions)
 			{
 				if (strcmp(curDevProp.extensionName, reqExtName) == 0)
 				{
@@ -323,14 +340,13 @@ namespace vulkan
 
 			if (!extensionFound)
 			{
-				anyExtensionNotFound = true;
-				break;
+				return false;
 			}
 		}
 
-		if (!anyExtensionNotFound)
+		if (isHeadless)
 		{
-			return false;
+			return true;
 		}
 
 		// Check for surface parameters support
@@ -429,17 +445,48 @@ namespace vulkan
 			return -1;
 		};
 
+		// Transfer-only queue families map to the copy engines that run alongside the graphics work
+		auto getTransferQueueFamilyIndex = [](const VkPhysicalDevice & physDev) -> int
+		{
+			uint32_t queueFamilyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(physDev, &queueFamilyCount, nullptr);
+
+			std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(physDev, &queueFamilyCount, queueFamilies.data());
+
+			for (size_t qIdx = 0, qIdxEnd = queueFamilies.size(); qIdx < qIdxEnd; ++qIdx)
+			{
+				const VkQueueFamilyProperties & queueFamily = queueFamilies[qIdx];
+
+				if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+					!(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				{
+					return (int)qIdx;
+				}
+			}
+
+			return -1;
+		};
+
 		VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
 		physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
+		physicalDeviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
 
 		float queuePriority = 1.0f;
 		int graphicsQueueFamilyIndex = getQueueFamilyIndex(m_vkPhysicalDeviceData.vkHandle, VK_QUEUE_GRAPHICS_BIT);
-		int presentingQueueFamilyIndex = getPresentingQueueFamilyIndex(m_vkPhysicalDeviceData.vkHandle);
+		// Nothing is presented in headless mode, so the graphics queue will be used in place of the presenting one
+		int presentingQueueFamilyIndex = m_isHeadless ? graphicsQueueFamilyIndex : getPresentingQueueFamilyIndex(m_vkPhysicalDeviceData.vkHandle);
+		// Uploads fall back to the graphics queue when there is no dedicated transfer queue
+		int transferQueueFamilyIndex = getTransferQueueFamilyIndex(m_vkPhysicalDeviceData.vkHandle);
+		if (transferQueueFamilyIndex < 0)
+			transferQueueFamilyIndex = graphicsQueueFamilyIndex;
 
 		std::vector<int> queuesRequired;
 		queuesRequired.push_back(graphicsQueueFamilyIndex);
 		if (presentingQueueFamilyIndex != graphicsQueueFamilyIndex)
 			queuesRequired.push_back(presentingQueueFamilyIndex);
+		if (transferQueueFamilyIndex != graphicsQueueFamilyIndex && transferQueueFamilyIndex != presentingQueueFamilyIndex)
+			queuesRequired.push_back(transferQueueFamilyIndex);
 
 		std::vector<VkDeviceQueueCreateInfo> logicalDeviceQueueCreateInfos;
 		for (const auto & qIdx : queuesRequired)
@@ -478,8 +525,10 @@ namespace vulkan
 
 		m_vkLogicalDeviceData.graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
 		m_vkLogicalDeviceData.presentingQueueFamilyIndex = presentingQueueFamilyIndex;
+		m_vkLogicalDeviceData.transferQueueFamilyIndex = transferQueueFamilyIndex;
 		vkGetDeviceQueue(m_vkLogicalDeviceData.vkHandle, m_vkLogicalDeviceData.graphicsQueueFamilyIndex, 0, &m_vkLogicalDeviceData.graphicsQueue);
 		vkGetDeviceQueue(m_vkLogicalDeviceData.vkHandle, m_vkLogicalDeviceData.presentingQueueFamilyIndex, 0, &m_vkLogicalDeviceData.presentingQueue);
+		vkGetDeviceQueue(m_vkLogicalDeviceData.vkHandle, m_vkLogicalDeviceData.transferQueueFamilyIndex, 0, &m_vkLogicalDeviceData.transferQueue);
 	}
 	void Wrapper::deinitLogicalDevice()
 	{
@@ -554,7 +603,8 @@ namespace vulkan
 		{
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME			//"VK_KHR_swapchain"
 		};
-		const uint32_t requiredExtensionCount = (uint32_t)(sizeof(requiredExtensions) / sizeof(const char *));
+		// Headless mode renders into the offscreen image instead of the swapchain
+		const uint32_t requiredExtensionCount = m_isHeadless ? 0 : (uint32_t)(sizeof(requiredExtensions) / sizeof(const char *));
 
 		for (uint32_t i = 0; i < requiredExtensionCount; ++i)
 		{
@@ -633,8 +683,86 @@ namespace vulkan
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
+	void Wrapper::initOffscreenTarget()
+	{
+		// Single offscreen image pretends to be the swapchain, so that the rest of the code
+		//	(framebuffers, command buffers, etc.) doesn't need to care about the headless mode
+		m_vkSwapchainData.format = VK_FORMAT_R8G8B8A8_UNORM;
+		m_vkSwapchainData.extent = { (uint32_t)m_windowWidth, (uint32_t)m_windowHeight };
+		m_vkSwapchainData.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+		VkImage offscreenImage;
+		createImage(
+			m_vkSwapchainData.extent.width,
+			m_vkSwapchainData.extent.height,
+			m_vkSwapchainData.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&offscreenImage,
+			&m_vkOffscreenImageAllocation
+			);
+
+		m_vkSwapchainData.images.resize(1);
+		m_vkSwapchainData.images[0] = offscreenImage;
+
+		m_vkSwapchainData.imageViews.resize(1);
+		m_vkSwapchainData.imageViews[0] = createImageView2D(m_vkLogicalDeviceData.vkHandle, offscreenImage, m_vkSwapchainData.format);
+	}
+	void Wrapper::deinitOffscreenTarget()
+	{
+		vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.imageViews[0], nullptr);
+		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.images[0], nullptr);
+		m_memoryAllocator.free(&m_vkOffscreenImageAllocation);
+	}
+
+	bool Wrapper::saveOffscreenImage(const char * filename)
+	{
+		if (!m_isHeadless)
+		{
+			printf("Offscreen image is only available in headless mode!\n");
+			return false;
+		}
+
+		const uint32_t width = m_vkSwapchainData.extent.width;
+		const uint32_t height = m_vkSwapchainData.extent.height;
+		const size_t imgBufferSize = width*height*4*sizeof(unsigned char);
+
+		VkBuffer readbackBuffer;
+		MemoryAllocation readbackBufferAllocation;
+		createStagingBuffer(
+			(VkDeviceSize)imgBufferSize,
+			&readbackBuffer,
+			&readbackBufferAllocation
+			);
+
+		// Render pass leaves offscreen image in the VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL layout, and its outgoing
+		//	dependency orders the attachment writes before the transfer reads of the later submissions; the copy
+		//	waits for all the submitted frames to finish
+		copyImageToBuffer(width, height, m_vkSwapchainData.images[0], readbackBuffer);
+
+		bool isSaved = image::writePPM(filename, (int)width, (int)height, 4, reinterpret_cast<const unsigned char *>(readbackBufferAllocation.mappedData));
+
+		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, readbackBuffer, nullptr);
+		m_memoryAllocator.free(&readbackBufferAllocation);
+
+		if (!isSaved)
+		{
+			// TODO: error
+			printf("Failed to save offscreen image to %s!\n", filename);
+		}
+
+		return isSaved;
+	}
+
 	void Wrapper::initSwapchain()
 	{
+		if (m_isHeadless)
+		{
+			initOffscreenTarget();
+			return;
+		}
+
 		m_vkPhysicalDeviceData.surfaceInfo = queryDeviceSurfaceInfo(m_vkPhysicalDeviceData.vkHandle, m_vkPresentableSurface);
 
 		VkExtent2D presentableSurfaceExtents = selectPresentableSurfaceExtents(m_vkPhysicalDeviceData.surfaceInfo.capabilities, (uint32_t)m_windowWidth, (uint32_t)m_windowHeight);
@@ -686,7 +814,8 @@ namespace vulkan
 		swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		swapchainCreateInfo.presentMode = presentMode;
 		swapchainCreateInfo.clipped = VK_TRUE;
-		swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+		// Non-null when the swapchain is recreated, allows the presentation engine to reuse its resources
+		swapchainCreateInfo.oldSwapchain = m_vkSwapchainData.vkHandle;
 
 		if (vkCreateSwapchainKHR(m_vkLogicalDeviceData.vkHandle, &swapchainCreateInfo, nullptr, &m_vkSwapchainData.vkHandle) != VK_SUCCESS)
 		{
@@ -718,11 +847,91 @@ namespace vulkan
 	}
 	void Wrapper::deinitSwapchain()
 	{
+		if (m_isHeadless)
+		{
+			deinitOffscreenTarget();
+			return;
+		}
+
 		for (uint32_t imgIdx = 0, imgIdxEnd = (uint32_t)m_vkSwapchainData.imageViews.size(); imgIdx < imgIdxEnd; ++imgIdx)
 		{
 			vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.imageViews[imgIdx], nullptr);
 		}
+		m_vkSwapchainData.imageViews.resize(0);
 		vkDestroySwapchainKHR(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.vkHandle, nullptr);
+		m_vkSwapchainData.vkHandle = VK_NULL_HANDLE;
+	}
+
+	void Wrapper::reinitSwapchain()
+	{
+		if (m_isHeadless)
+		{
+			// Offscreen target never changes its size, so there is no point in optimizing this path
+			vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle);
+			deinitSwapchainFramebuffers();
+			deinitSwapchain();
+			initSwapchain();
+			initSwapchainFramebuffers();
+			return;
+		}
+
+		RetiredResources & retiredResources = getRetiredResources();
+
+		// Swapchain images are still going to be presented by the frames in flight
+		const VkFormat prevSwapchainFormat = m_vkSwapchainData.format;
+		const VkSwapchainKHR prevSwapchain = m_vkSwapchainData.vkHandle;
+		retiredResources.framebuffers.insert(retiredResources.framebuffers.end(), m_vkSwapchainData.framebuffers.begin(), m_vkSwapchainData.framebuffers.end());
+		retiredResources.imageViews.insert(retiredResources.imageViews.end(), m_vkSwapchainData.imageViews.begin(), m_vkSwapchainData.imageViews.end());
+		m_vkSwapchainData.framebuffers.resize(0);
+		m_vkSwapchainData.imageViews.resize(0);
+
+		// Old swapchain is passed as `oldSwapchain`, and is retired (but not yet destroyed) after that
+		initSwapchain();
+		retiredResources.swapchains.push_back(prevSwapchain);
+		// Keeps the current render scale, accumulation is restarted with the accumulation image recreation anyway
+		updateRenderExtent();
+
+		if (m_vkSwapchainData.format != prevSwapchainFormat)
+		{
+			// Viewport and scissor are dynamic states, so the pipeline only depends on the render pass, which
+			//	in turn only depends on the swapchain format; format change is rare enough to just wait here
+			vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle);
+			deinitPipelineState();
+			deinitRenderPass();
+			initRenderPass();
+			initPipelineState();
+		}
+
+		// Accumulation image (and the adaptive sampling images) have the size of the swapchain, and hence need
+		//	recreation as well; frames in flight keep using the old ones through their descriptor sets
+		retireImage(m_vkAccumImage, m_vkAccumImageView, m_vkAccumImageAllocation);
+		initAccumImage();
+		retireImage(m_vkMomentsImage, m_vkMomentsImageView, m_vkMomentsImageAllocation);
+		retireImage(m_vkSampleCountImage, m_vkSampleCountImageView, m_vkSampleCountImageAllocation);
+		initAdaptiveSamplingImages();
+		retireImage(m_vkHistoryImage, m_vkHistoryImageView, m_vkHistoryImageAllocation);
+		for (int surfaceIdx = 0; surfaceIdx < 2; ++surfaceIdx)
+		{
+			retireImage(m_vkSurfaceImages[surfaceIdx], m_vkSurfaceImageViews[surfaceIdx], m_vkSurfaceImagesAllocations[surfaceIdx]);
+		}
+		initTemporalImages();
+		if (m_tracerBackend == TracerBackend::eWavefront)
+		{
+			// Wavefront buffers are sized by the amount of pixels
+			for (int bufferIdx = 0; bufferIdx < eWavefrontBufferCount; ++bufferIdx)
+			{
+				retireBuffer(m_vkWavefrontBuffers[bufferIdx], m_vkWavefrontBuffersAllocations[bufferIdx]);
+			}
+			initWavefrontBuffers();
+		}
+
+		// Descriptor sets of the frames in flight can't be updated until those frames finish
+		for (FrameData & frame : m_frames)
+		{
+			frame.areDescriptorSetsDirty = true;
+		}
+
+		initSwapchainFramebuffers();
 	}
 
 	VkShaderModule Wrapper::initShaderModule(const std::vector<char> & shaderByteCode)
@@ -741,6 +950,11 @@ namespace vulkan
 
 		return shaderModule;
 	}
+	VkShaderModule Wrapper::loadShaderModule(const std::string & filename)
+	{
+		std::vector<char> shaderByteCode = readShaderFile(filename);
+		return initShaderModule(shaderByteCode);
+	}
 	void Wrapper::deinitShaderModules()
 	{
 		for (const VkShaderModule & vkShaderModule : m_vkShaderModules)
@@ -759,7 +973,8 @@ namespace vulkan
 		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// Offscreen image is only read back in the headless mode
+		attachmentDescription.finalLayout = m_isHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentRef = {};
 		colorAttachmentRef.attachment = 0;
@@ -770,13 +985,31 @@ namespace vulkan
 		subpassDescription.colorAttachmentCount = 1;
 		subpassDescription.pColorAttachments = &colorAttachmentRef;
 
-		VkSubpassDependency subpassDependency = {};
-		subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		subpassDependency.dstSubpass = 0;
-		subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependency.srcAccessMask = 0;
-		subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		VkSubpassDependency subpassDependencies[2] = {};
+		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		subpassDependencies[0].dstSubpass = 0;
+		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subpassDependencies[0].srcAccessMask = 0;
+		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		uint32_t numSubpassDependencies = 1;
+		if (m_isHeadless)
+		{
+			// Swapchain images are ordered by the acquire semaphore, but all the frames in flight render into the
+			//	same offscreen image, so the previous frame writes (and the readback copy) should be finished first
+			subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+			subpassDependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+			// Attachment writes should be visible to the readback copy, see `saveOffscreenImage`
+			subpassDependencies[1].srcSubpass = 0;
+			subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			subpassDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			++numSubpassDependencies;
+		}
 
 		VkRenderPassCreateInfo renderPassCreateInfo = {};
 		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -784,8 +1017,8 @@ namespace vulkan
 		renderPassCreateInfo.pAttachments = &attachmentDescription;
 		renderPassCreateInfo.subpassCount = 1;
 		renderPassCreateInfo.pSubpasses = &subpassDescription;
-		renderPassCreateInfo.dependencyCount = 1;
-		renderPassCreateInfo.pDependencies = &subpassDependency;
+		renderPassCreateInfo.dependencyCount = numSubpassDependencies;
+		renderPassCreateInfo.pDependencies = subpassDependencies;
 
 		if (vkCreateRenderPass(m_vkLogicalDeviceData.vkHandle, &renderPassCreateInfo, nullptr, &m_vkRenderPass) != VK_SUCCESS)
 		{
@@ -865,24 +1098,21 @@ namespace vulkan
 		pipelineInputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		pipelineInputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)m_vkSwapchainData.extent.width;
-		viewport.height = (float)m_vkSwapchainData.extent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = m_vkSwapchainData.extent;
-
+		// Viewport and scissor are dynamic, see `recordCommandBuffer`, so that the pipeline doesn't depend
+		//	on the swapchain extent and survives the window resizes
 		VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo = {};
 		pipelineViewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		pipelineViewportStateCreateInfo.viewportCount = 1;
-		pipelineViewportStateCreateInfo.pViewports = &viewport;
+		pipelineViewportStateCreateInfo.pViewports = nullptr;
 		pipelineViewportStateCreateInfo.scissorCount = 1;
-		pipelineViewportStateCreateInfo.pScissors = &scissor;
+		pipelineViewportStateCreateInfo.pScissors = nullptr;
+
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo = {};
+		pipelineDynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		pipelineDynamicStateCreateInfo.dynamicStateCount = (uint32_t)(sizeof(dynamicStates) / sizeof(dynamicStates[0]));
+		pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates;
 
 		VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo = {};
 		pipelineRasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -953,14 +1183,14 @@ namespace vulkan
 		graphicsPipelineCreateInfo.pMultisampleState = &pipelineMultisampleStateCreateInfo;
 		graphicsPipelineCreateInfo.pDepthStencilState = nullptr;
 		graphicsPipelineCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
-		graphicsPipelineCreateInfo.pDynamicState = nullptr;
+		graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
 		graphicsPipelineCreateInfo.layout = m_vkPipelineLayout;
 		graphicsPipelineCreateInfo.renderPass = m_vkRenderPass;
 		graphicsPipelineCreateInfo.subpass = 0;
 		graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 		graphicsPipelineCreateInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(m_vkLogicalDeviceData.vkHandle, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &m_vkGraphicsPipeline) != VK_SUCCESS)
+		if (vkCreateGraphicsPipelines(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &m_vkGraphicsPipeline) != VK_SUCCESS)
 		{
 			printf("Failed to create graphics pipeline!\n");
 		}
@@ -971,6 +1201,67 @@ namespace vulkan
 		vkDestroyPipelineLayout(m_vkLogicalDeviceData.vkHandle, m_vkPipelineLayout, nullptr);
 	}
 
+	void Wrapper::initComputePipelineState()
+	{
+		// Workgroup size is passed via specialization constants, to avoid recompiling the shader
+		const uint32_t numSpecializationConstants = 2;
+		uint32_t specializationData[numSpecializationConstants] = { m_computeWorkgroupSizeX, m_computeWorkgroupSizeY };
+		VkSpecializationMapEntry specializationMapEntries[numSpecializationConstants];
+		for (uint32_t i = 0; i < numSpecializationConstants; ++i)
+		{
+			specializationMapEntries[i].constantID = i;
+			specializationMapEntries[i].offset = i * sizeof(uint32_t);
+			specializationMapEntries[i].size = sizeof(uint32_t);
+		}
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = numSpecializationConstants;
+		specializationInfo.pMapEntries = specializationMapEntries;
+		specializationInfo.dataSize = sizeof(specializationData);
+		specializationInfo.pData = specializationData;
+
+		VkPipelineShaderStageCreateInfo compShaderStageInfo = {};
+		compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		compShaderStageInfo.module = m_vkShaderModules[2];
+		compShaderStageInfo.pName = "main";
+		compShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ComputeTilePushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &m_vkUBODescriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(m_vkLogicalDeviceData.vkHandle, &pipelineLayoutCreateInfo, nullptr, &m_vkComputePipelineLayout) != VK_SUCCESS)
+		{
+			printf("Failed to create compute pipeline layout!\n");
+		}
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.stage = compShaderStageInfo;
+		computePipelineCreateInfo.layout = m_vkComputePipelineLayout;
+		computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		computePipelineCreateInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_vkComputePipeline) != VK_SUCCESS)
+		{
+			printf("Failed to create compute pipeline!\n");
+		}
+	}
+	void Wrapper::deinitComputePipelineState()
+	{
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkComputePipeline, nullptr);
+		vkDestroyPipelineLayout(m_vkLogicalDeviceData.vkHandle, m_vkComputePipelineLayout, nullptr);
+	}
+
 	void Wrapper::initSwapchainFramebuffers()
 	{
 		m_vkSwapchainData.framebuffers.resize(m_vkSwapchainData.imageViews.size());
@@ -1004,6 +1295,7 @@ namespace vulkan
 		{
 			vkDestroyFramebuffer(m_vkLogicalDeviceData.vkHandle, swapchainFramebuffer, nullptr);
 		}
+		m_vkSwapchainData.framebuffers.resize(0);
 	}
 
 	void Wrapper::initCommandPool()
@@ -1011,7 +1303,8 @@ namespace vulkan
 		VkCommandPoolCreateInfo commandPoolCreateInfo = {};
 		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		commandPoolCreateInfo.queueFamilyIndex = m_vkLogicalDeviceData.graphicsQueueFamilyIndex;
-		commandPoolCreateInfo.flags = 0;
+		// Command buffers are re-recorded every frame
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(m_vkLogicalDeviceData.vkHandle, &commandPoolCreateInfo, nullptr, &m_vkCommandPool) != VK_SUCCESS)
 		{
@@ -1025,26 +1318,6 @@ namespace vulkan
 		vkDestroyCommandPool(m_vkLogicalDeviceData.vkHandle, m_vkCommandPool, nullptr);
 	}
 
-	uint32_t Wrapper::findMemoryType(const VkPhysicalDevice & physDev, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties)
-	{
-		VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-		vkGetPhysicalDeviceMemoryProperties(physDev, &physicalDeviceMemoryProperties);
-
-		for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; ++i)
-		{
-			if ( (typeFilter & (1 << i)) &&
-				 ((physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties) )
-			{
-				return i;
-			}
-		}
-
-		// TODO: warning
-		printf("Failed to find suitable memory type!\n");
-		assert(false && "Failed to find suitable memory type!\n");
-		return 0xFFffFFff;
-	}
-
 	VkCommandPool Wrapper::getTransientCommandPool()
 	{
 		// TODO: here we use m_vkCommandPool which is generalized command pool
@@ -1084,24 +1357,35 @@ namespace vulkan
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &transientCommandBuffer;
 
-		vkQueueSubmit(m_vkLogicalDeviceData.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(m_vkLogicalDeviceData.graphicsQueue);
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence readbackFence = VK_NULL_HANDLE;
+		if (vkCreateFence(m_vkLogicalDeviceData.vkHandle, &fenceCreateInfo, nullptr, &readbackFence) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create readback fence!\n");
+		}
+
+		// Fence signal covers the frames submitted to the graphics queue earlier as well, the rest of the queues
+		//	(i.e. the upload batches) are not waited on
+		vkQueueSubmit(m_vkLogicalDeviceData.graphicsQueue, 1, &submitInfo, readbackFence);
+		vkWaitForFences(m_vkLogicalDeviceData.vkHandle, 1, &readbackFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		vkDestroyFence(m_vkLogicalDeviceData.vkHandle, readbackFence, nullptr);
 
 		VkCommandPool transientCommandPool = getTransientCommandPool();
 		vkFreeCommandBuffers(m_vkLogicalDeviceData.vkHandle, transientCommandPool, 1, &transientCommandBuffer);
 	}
 
 	void Wrapper::createBuffer(
-			const VkPhysicalDevice & physDev,
-			const VkDevice & logicDev,
 			VkDeviceSize size,
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags memoryProperties,
 			VkBuffer * buffer,
-			VkDeviceMemory * bufferDeviceMemory
+			MemoryAllocation * bufferAllocation
 			)
 	{
-		if (buffer == nullptr || bufferDeviceMemory == nullptr)
+		if (buffer == nullptr || bufferAllocation == nullptr)
 		{
 			// TODO: warning
 			printf("Wrong data supplied for createBuffer!\n");
@@ -1113,52 +1397,60 @@ namespace vulkan
 		bufferCreateInfo.usage = usage;
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		if (vkCreateBuffer(logicDev, &bufferCreateInfo, nullptr, buffer) != VK_SUCCESS)
+		// Transfer destinations could be written by the upload batches on the transfer queue, concurrent sharing
+		//	saves the queue family ownership transfers, and costs buffers next to nothing
+		uint32_t queueFamilyIndices[] = { m_vkLogicalDeviceData.graphicsQueueFamilyIndex, m_vkLogicalDeviceData.transferQueueFamilyIndex };
+		if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && queueFamilyIndices[0] != queueFamilyIndices[1])
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = 2;
+			bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+
+		if (vkCreateBuffer(m_vkLogicalDeviceData.vkHandle, &bufferCreateInfo, nullptr, buffer) != VK_SUCCESS)
 		{
 			// TODO: error
-			printf("Failed to create triangle vertex buffer!\n");
+			printf("Failed to create buffer!\n");
 		}
 
 		VkMemoryRequirements memoryRequirements;
-		vkGetBufferMemoryRequirements(logicDev, *buffer, &memoryRequirements);
-
-		VkMemoryAllocateInfo memoryAllocateInfo = {};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(physDev, memoryRequirements.memoryTypeBits, memoryProperties);
+		vkGetBufferMemoryRequirements(m_vkLogicalDeviceData.vkHandle, *buffer, &memoryRequirements);
 
-		// TODO: vulkan memory allocation
-		//	using fine-grained allocations for each buffer is bad, since devices could have very limited amount of
-		//	allocations being live simultaneously. Instead, it is better to gather all of the buffers and make single
-		//	allocation for them, then splitting the data between them.
-		if (vkAllocateMemory(logicDev, &memoryAllocateInfo, nullptr, bufferDeviceMemory) != VK_SUCCESS)
+		if (!m_memoryAllocator.allocate(memoryRequirements, memoryProperties, MemoryResourceType::eLinear, bufferAllocation))
 		{
 			// TODO: error
-			printf("Failed to allocate triangle vertex buffer memory!");
+			printf("Failed to allocate buffer memory!\n");
 		}
 
-		// Offset (currently simply 0) needs to be divisible by memoryRequirements.alignment
-		vkBindBufferMemory(logicDev, *buffer, *bufferDeviceMemory, 0);
+		vkBindBufferMemory(m_vkLogicalDeviceData.vkHandle, *buffer, bufferAllocation->deviceMemory, bufferAllocation->offset);
 	}
-
-	void Wrapper::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+	void Wrapper::createStagingBuffer(VkDeviceSize size, VkBuffer * buffer, MemoryAllocation * bufferAllocation)
 	{
-		VkCommandBuffer transientCommandBuffer;
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		transientCommandBuffer = beginTransientCommandBuffer();
+		if (vkCreateBuffer(m_vkLogicalDeviceData.vkHandle, &bufferCreateInfo, nullptr, buffer) != VK_SUCCESS)
 		{
-			VkBufferCopy bufferCopyRegion = {};
-			bufferCopyRegion.srcOffset = 0;
-			bufferCopyRegion.dstOffset = 0;
-			bufferCopyRegion.size = size;
-			vkCmdCopyBuffer(transientCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
+			// TODO: error
+			printf("Failed to create staging buffer!\n");
 		}
-		endTransientCommandBuffer(transientCommandBuffer);
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements(m_vkLogicalDeviceData.vkHandle, *buffer, &memoryRequirements);
+
+		if (!m_memoryAllocator.allocateStaging(memoryRequirements, bufferAllocation))
+		{
+			// TODO: error
+			printf("Failed to allocate staging buffer memory!\n");
+		}
+
+		vkBindBufferMemory(m_vkLogicalDeviceData.vkHandle, *buffer, bufferAllocation->deviceMemory, bufferAllocation->offset);
 	}
 
 	void Wrapper::createImage(
-			const VkPhysicalDevice & physDev,
-			const VkDevice & logicDev,
 			uint32_t width,
 			uint32_t height,
 			VkFormat format,
@@ -1166,10 +1458,10 @@ namespace vulkan
 			VkImageUsageFlags usage,
 			VkMemoryPropertyFlags memoryProperties,
 			VkImage * image,
-			VkDeviceMemory * imageDeviceMemory
+			MemoryAllocation * imageAllocation
 			)
 	{
-		if (image == nullptr || imageDeviceMemory == nullptr)
+		if (image == nullptr || imageAllocation == nullptr)
 		{
 			// TODO: warning
 			printf("Wrong data supplied for createImage!\n");
@@ -1191,103 +1483,36 @@ namespace vulkan
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.flags = 0;
 
-		if (vkCreateImage(logicDev, &imageCreateInfo, nullptr, image) != VK_SUCCESS)
+		// Same as in `createBuffer`, the only uploaded image is a small texture, so concurrent sharing is not a concern
+		uint32_t queueFamilyIndices[] = { m_vkLogicalDeviceData.graphicsQueueFamilyIndex, m_vkLogicalDeviceData.transferQueueFamilyIndex };
+		if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && queueFamilyIndices[0] != queueFamilyIndices[1])
+		{
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageCreateInfo.queueFamilyIndexCount = 2;
+			imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+
+		if (vkCreateImage(m_vkLogicalDeviceData.vkHandle, &imageCreateInfo, nullptr, image) != VK_SUCCESS)
 		{
 			// TODO: error
 			printf("Failed to create image!\n");
 		}
 
 		VkMemoryRequirements memoryRequirements;
-		vkGetImageMemoryRequirements(logicDev, *image, &memoryRequirements);
+		vkGetImageMemoryRequirements(m_vkLogicalDeviceData.vkHandle, *image, &memoryRequirements);
 
-		VkMemoryAllocateInfo memoryAllocateInfo = {};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(physDev, memoryRequirements.memoryTypeBits, memoryProperties);
-
-		if (vkAllocateMemory(logicDev, &memoryAllocateInfo, nullptr, imageDeviceMemory) != VK_SUCCESS)
+		// Only optimal tiled images are subject to `bufferImageGranularity` separation from the buffers
+		const MemoryResourceType resourceType = (tiling == VK_IMAGE_TILING_OPTIMAL) ? MemoryResourceType::eOptimal : MemoryResourceType::eLinear;
+		if (!m_memoryAllocator.allocate(memoryRequirements, memoryProperties, resourceType, imageAllocation))
 		{
 			// TODO: error
-			printf("Failed to allocate image memory!");
+			printf("Failed to allocate image memory!\n");
 		}
 
-		vkBindImageMemory(logicDev, *image, *imageDeviceMemory, 0);
-	}
-
-	void Wrapper::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldImageLayout, VkImageLayout newImageLayout)
-	{
-		VkCommandBuffer transientCommandBuffer;
-
-		transientCommandBuffer = beginTransientCommandBuffer();
-		{
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = oldImageLayout;
-			imageMemoryBarrier.newLayout = newImageLayout;
-			// In case of transitioning queue families, these fields should be used
-			//	In case no ownership transition is intended, they should be both VK_QUEUE_FAMILY_IGNORED
-			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-			imageMemoryBarrier.subresourceRange.levelCount = 1;
-			imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-			imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-			VkPipelineStageFlags srcSyncStage = 0;
-			VkPipelineStageFlags dstSyncStage = 0;
-
-			// Try to infer synchronization logic from the layouts supplied
-			if (oldImageLayout == VK_IMAGE_LAYOUT_UNDEFINED && newImageLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-			{
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-				srcSyncStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-				dstSyncStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			}
-			else if (oldImageLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newImageLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-			{
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-				srcSyncStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-				dstSyncStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			}
-			else
-			{
-				// TODO: error
-				printf("Transition logic doesn't support this pair of layouts");
-				assert(false && "Transition logic doesn't support this pair of layouts");
-			}
-
-			const uint32_t memoryBarrierCount = 0;
-			const VkMemoryBarrier * pMemoryBarriers = nullptr;
-
-			const uint32_t bufferMemoryBarrierCount = 0;
-			const VkBufferMemoryBarrier * pBufferMemoryBarriers = nullptr;
-			
-			const uint32_t imageMemoryBarrierCount = 1;
-			const VkImageMemoryBarrier pImageMemoryBarriers[] = { imageMemoryBarrier };
-
-			vkCmdPipelineBarrier(
-				transientCommandBuffer,
-				srcSyncStage,
-				dstSyncStage,
-				0,
-				memoryBarrierCount,
-				pMemoryBarriers,
-				bufferMemoryBarrierCount,
-				pBufferMemoryBarriers,
-				imageMemoryBarrierCount,
-				pImageMemoryBarriers
-				);
-		}
-		endTransientCommandBuffer(transientCommandBuffer);
+		vkBindImageMemory(m_vkLogicalDeviceData.vkHandle, *image, imageAllocation->deviceMemory, imageAllocation->offset);
 	}
 
-	void Wrapper::copyBufferToImage(uint32_t width, uint32_t height, VkBuffer buffer, VkImage image)
+	void Wrapper::copyImageToBuffer(uint32_t width, uint32_t height, VkImage image, VkBuffer buffer)
 	{
 		VkCommandBuffer transientCommandBuffer;
 
@@ -1306,11 +1531,11 @@ namespace vulkan
 			bufferImageCopyRegion.imageOffset = {0, 0, 0};
 			bufferImageCopyRegion.imageExtent = {width, height, 1};
 
-			vkCmdCopyBufferToImage(
+			vkCmdCopyImageToBuffer(
 				transientCommandBuffer,
-				buffer,
 				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				buffer,
 				1,
 				&bufferImageCopyRegion
 				);
@@ -1320,58 +1545,17 @@ namespace vulkan
 
 	void Wrapper::initTextureImage()
 	{
-		const int imgSizeW = 256;
-		const int imgSizeH = 256;
-		const int imgSize = imgSizeW*imgSizeH*4;
-		const size_t imgBufferSize = imgSizeW*imgSizeH*4*sizeof(unsigned char);
-		unsigned char * imgData = new unsigned char[imgSize];
-
-		if (imgData == nullptr)
-		{
-			// TODO: error
-			printf("Failed to allocate memory for texture!\n");
-			return;
-		}
-
-		int yAdd = 0;
-		for (int y = 0; y < imgSizeH; ++y)
-		{
-			for (int x = 0; x < imgSizeW; ++x)
-			{
-				int pixelOffset = ((x + yAdd) << 2);
-				imgData[pixelOffset  ] = (rand() % 255);
-				imgData[pixelOffset+1] = (rand() % 255);
-				imgData[pixelOffset+2] = (rand() % 255);
-				imgData[pixelOffset+3] = (rand() % 255);
-			}
-			yAdd += imgSizeW;
-		}
+		// Blue noise for the sampler Cranley-Patterson rotations, see `sampler.glsl`; the seed is fixed,
+		//	`m_randomSeed` already changes the sequences themselves
+		const int imgSizeW = image::c_blueNoiseSize;
+		const int imgSizeH = image::c_blueNoiseSize;
+		std::vector<unsigned char> imgData;
+		image::generateBlueNoise(image::c_blueNoiseSize, 4, 0, &imgData);
+		const size_t imgBufferSize = imgData.size() * sizeof(unsigned char);
 
 		m_vkTextureImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferDeviceMemory;
-
-		createBuffer(
-			m_vkPhysicalDeviceData.vkHandle,
-			m_vkLogicalDeviceData.vkHandle,
-			(VkDeviceSize)imgBufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			&stagingBufferDeviceMemory
-			);
-
-		void * data = nullptr;
-		vkMapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, 0, (VkDeviceSize)imgBufferSize, 0, &data);
-		memcpy(data, imgData, imgBufferSize);
-		vkUnmapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory);
-
-		delete [] imgData;
-
 		createImage(
-			m_vkPhysicalDeviceData.vkHandle,
-			m_vkLogicalDeviceData.vkHandle,
 			(uint32_t)imgSizeW,
 			(uint32_t)imgSizeH,
 			m_vkTextureImageFormat,
@@ -1379,7 +1563,7 @@ namespace vulkan
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&m_vkTextureImage,
-			&m_vkTextureImageDeviceMemory
+			&m_vkTextureImageAllocation
 			);
 
 		/*
@@ -1394,34 +1578,18 @@ namespace vulkan
 		vkGetImageSubresourceLayout(m_vkLogicalDeviceData.vkHandle, m_vkTextureImage, *imageSubresource, &subresourceLayout);
 		//*/
 
-		// Transition image layout for transfer-friendly, not caring about the current image contents
-		transitionImageLayout(
+		uploadImageData(
 			m_vkTextureImage,
-			m_vkTextureImageFormat,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-			);
-		copyBufferToImage(
 			(uint32_t)imgSizeW,
 			(uint32_t)imgSizeH,
-			stagingBuffer,
-			m_vkTextureImage
+			imgData.data(),
+			imgBufferSize
 			);
-		// Transition image layout for optimal access from the shader
-		transitionImageLayout(
-			m_vkTextureImage,
-			m_vkTextureImageFormat,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			);
-
-		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, stagingBuffer, nullptr);
-		vkFreeMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, nullptr);
 	}
 	void Wrapper::deinitTextureImage()
 	{
 		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkTextureImage, nullptr);
-		vkFreeMemory(m_vkLogicalDeviceData.vkHandle, m_vkTextureImageDeviceMemory, nullptr);
+		m_memoryAllocator.free(&m_vkTextureImageAllocation);
 	}
 
 	VkImageView Wrapper::createImageView2D(const VkDevice & logicDev, VkImage image, VkFormat format)
@@ -1503,6 +1671,35 @@ namespace vulkan
 		vkDestroySampler(m_vkLogicalDeviceData.vkHandle, m_vkTextureSampler, nullptr);
 	}
 
+	void Wrapper::initAccumImage()
+	{
+		createImage(
+			m_vkSwapchainData.extent.width,
+			m_vkSwapchainData.extent.height,
+			m_vkAccumImageFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			// Transfer source is required to read back accumulated sample counts
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_vkAccumImage,
+			&m_vkAccumImageAllocation
+			);
+
+		// Storage images could only be accessed in the general layout, and it is never changed afterwards
+		//	contents are undefined, but the first accumulated frame overwrites them anyway
+		initStorageImageLayout(m_vkAccumImage, m_vkAccumImageFormat);
+
+		m_vkAccumImageView = createImageView2D(m_vkLogicalDeviceData.vkHandle, m_vkAccumImage, m_vkAccumImageFormat);
+
+		resetAccumulation();
+	}
+	void Wrapper::deinitAccumImage()
+	{
+		vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkAccumImageView, nullptr);
+		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkAccumImage, nullptr);
+		m_memoryAllocator.free(&m_vkAccumImageAllocation);
+	}
+
 	void Wrapper::initFSQuadBuffers()
 	{
 		//
@@ -1520,45 +1717,15 @@ namespace vulkan
 
 			size_t triangleVertexBufferSize = sizeof(vertices[0]) * numVertices;
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingBufferDeviceMemory;
 			createBuffer(
-				m_vkPhysicalDeviceData.vkHandle,
-				m_vkLogicalDeviceData.vkHandle,
-				(VkDeviceSize)triangleVertexBufferSize,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&stagingBuffer,
-				&stagingBufferDeviceMemory
-				);
-
-			// Fill in the Vertex Buffer
-		
-			/*
-			(obsolete warning, we're using staging buffer now)
-			// WARNING: to make sure the memory is seen by the device immediately, we're using VK_MEMORY_PROPERTY_HOST_COHERENT_BIT for the allocation
-			//	but faster and probably more widespread way of doing so would be to utilize `vkFlushMappedMemoryRanges`/`vkInvalidateMappedMemoryRanges`
-			*/
-
-			void * data = nullptr;
-			vkMapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, 0, (VkDeviceSize)triangleVertexBufferSize, 0, &data);
-			memcpy(data, vertices, triangleVertexBufferSize);
-			vkUnmapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory);
-
-			createBuffer(
-				m_vkPhysicalDeviceData.vkHandle,
-				m_vkLogicalDeviceData.vkHandle,
 				(VkDeviceSize)triangleVertexBufferSize,
 				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				&m_vkTriangleVertexBuffer,
-				&m_vkTriangleVertexBufferDeviceMemory
+				&m_vkTriangleVertexBufferAllocation
 				);
 
-			copyBuffer(stagingBuffer, m_vkTriangleVertexBuffer, (VkDeviceSize)triangleVertexBufferSize);
-
-			vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, stagingBuffer, nullptr);
-			vkFreeMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, nullptr);
+			uploadBufferData(m_vkTriangleVertexBuffer, vertices, triangleVertexBufferSize);
 		}
 
 		//
@@ -1576,61 +1743,184 @@ namespace vulkan
 
 			size_t triangleIndexBufferSize = sizeof(indices[0]) * numIndices;
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingBufferDeviceMemory;
 			createBuffer(
-				m_vkPhysicalDeviceData.vkHandle,
-				m_vkLogicalDeviceData.vkHandle,
-				(VkDeviceSize)triangleIndexBufferSize,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&stagingBuffer,
-				&stagingBufferDeviceMemory
-				);
-
-			// Fill in the buffer
-
-			void * data = nullptr;
-			vkMapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, 0, (VkDeviceSize)triangleIndexBufferSize, 0, &data);
-			memcpy(data, indices, triangleIndexBufferSize);
-			vkUnmapMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory);
-
-			createBuffer(
-				m_vkPhysicalDeviceData.vkHandle,
-				m_vkLogicalDeviceData.vkHandle,
 				(VkDeviceSize)triangleIndexBufferSize,
 				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				&m_vkTriangleIndexBuffer,
-				&m_vkTriangleIndexBufferDeviceMemory
+				&m_vkTriangleIndexBufferAllocation
 				);
 
-			copyBuffer(stagingBuffer, m_vkTriangleIndexBuffer, (VkDeviceSize)triangleIndexBufferSize);
-
-			vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, stagingBuffer, nullptr);
-			vkFreeMemory(m_vkLogicalDeviceData.vkHandle, stagingBufferDeviceMemory, nullptr);
+			uploadBufferData(m_vkTriangleIndexBuffer, indices, triangleIndexBufferSize);
 		}
 	}
 	void Wrapper::deinitFSQuadBuffers()
 	{
 		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, m_vkTriangleIndexBuffer, nullptr);
-		vkFreeMemory(m_vkLogicalDeviceData.vkHandle, m_vkTriangleIndexBufferDeviceMemory, nullptr);
+		m_memoryAllocator.free(&m_vkTriangleIndexBufferAllocation);
 
 		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, m_vkTriangleVertexBuffer, nullptr);
-		vkFreeMemory(m_vkLogicalDeviceData.vkHandle, m_vkTriangleVertexBufferDeviceMemory, nullptr);
+		m_memoryAllocator.free(&m_vkTriangleVertexBufferAllocation);
+	}
+
+	void Wrapper::initDoubleBufferedStorageCopy(DoubleBufferedStorage * storage, uint32_t copyIdx, size_t elementSize, uint32_t capacity)
+	{
+		// Zero-sized buffers are not allowed
+		storage->capacities[copyIdx] = std::max(capacity, 1u);
+		storage->unboundFrameNumbers[copyIdx] = 0;
+
+		createBuffer(
+			(VkDeviceSize)(storage->capacities[copyIdx] * elementSize),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storage->vkBuffers[copyIdx],
+			&storage->allocations[copyIdx]
+			);
+	}
+	void Wrapper::initDoubleBufferedStorage(DoubleBufferedStorage * storage, size_t elementSize, uint32_t capacity)
+	{
+		for (uint32_t copyIdx = 0; copyIdx < 2; ++copyIdx)
+		{
+			initDoubleBufferedStorageCopy(storage, copyIdx, elementSize, capacity);
+		}
+		storage->curCopyIdx = 0;
+	}
+	void Wrapper::deinitDoubleBufferedStorage(DoubleBufferedStorage * storage)
+	{
+		for (uint32_t copyIdx = 0; copyIdx < 2; ++copyIdx)
+		{
+			vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, storage->vkBuffers[copyIdx], nullptr);
+			m_memoryAllocator.free(&storage->allocations[copyIdx]);
+			storage->vkBuffers[copyIdx] = VK_NULL_HANDLE;
+			storage->capacities[copyIdx] = 0;
+		}
+	}
+	VkBuffer Wrapper::flipDoubleBufferedStorage(DoubleBufferedStorage * storage, size_t elementSize, uint32_t numElements)
+	{
+		const uint32_t spareCopyIdx = 1 - storage->curCopyIdx;
+
+		// Same conditions as `releaseRetiredResources`, the spare copy is normally free unless the previous flip
+		//	happened less than `m_frames.size()` frames ago
+		const uint64_t unboundFrameNumber = storage->unboundFrameNumbers[spareCopyIdx];
+		const bool isSpareCopyInUse = (unboundFrameNumber > 0) && (unboundFrameNumber + (uint64_t)m_frames.size() > m_numSubmittedFrames + 1);
+		if (isSpareCopyInUse || numElements > storage->capacities[spareCopyIdx])
+		{
+			retireBuffer(storage->vkBuffers[spareCopyIdx], storage->allocations[spareCopyIdx]);
+			initDoubleBufferedStorageCopy(storage, spareCopyIdx, elementSize, std::max(numElements, storage->capacities[spareCopyIdx]));
+		}
+
+		// Frame that is about to be recorded already rewrites its descriptor set, see `recordCommandBuffer`
+		storage->unboundFrameNumbers[storage->curCopyIdx] = m_numSubmittedFrames;
+		storage->curCopyIdx = spareCopyIdx;
+
+		// Descriptor sets of the frames in flight can't be updated until those frames finish
+		for (FrameData & frame : m_frames)
+		{
+			frame.areDescriptorSetsDirty = true;
+		}
+
+		return storage->vkBuffers[spareCopyIdx];
+	}
+
+	void Wrapper::initSceneBuffer(uint32_t capacity)
+	{
+		initDoubleBufferedStorage(&m_sceneBuffers, sizeof(SceneHitObject), capacity);
+	}
+	void Wrapper::deinitSceneBuffer()
+	{
+		deinitDoubleBufferedStorage(&m_sceneBuffers);
+	}
+
+	void Wrapper::initBVHBuffer(uint32_t capacity)
+	{
+		initDoubleBufferedStorage(&m_bvhBuffers, sizeof(scene::BVHNode), capacity);
+	}
+	void Wrapper::deinitBVHBuffer()
+	{
+		deinitDoubleBufferedStorage(&m_bvhBuffers);
+	}
+
+	void Wrapper::initMaterialsBuffer(uint32_t capacity)
+	{
+		initDoubleBufferedStorage(&m_materialsBuffers, sizeof(SceneMaterial), capacity);
+	}
+	void Wrapper::deinitMaterialsBuffer()
+	{
+		deinitDoubleBufferedStorage(&m_materialsBuffers);
+	}
+
+	void Wrapper::uploadScene()
+	{
+		std::vector<scene::BVHNode> bvhNodes;
+		std::vector<uint32_t> primIndices;
+		scene::buildBVH(m_scene.spheres, m_bvhBuildParams, &bvhNodes, &primIndices);
+
+		const uint32_t numHitObjects = (uint32_t)primIndices.size();
+		const uint32_t numBVHNodes = (uint32_t)bvhNodes.size();
+
+		m_numSceneHitObjects = numHitObjects;
+		m_numBVHNodes = numBVHNodes;
+		m_isSceneDirty = false;
+
+		if (numHitObjects == 0)
+			return;
+
+		std::vector<SceneHitObject> hitObjects(numHitObjects);
+		for (uint32_t objIdx = 0; objIdx < numHitObjects; ++objIdx)
+		{
+			const scene::Sphere & sphere = m_scene.spheres[primIndices[objIdx]];
+			SceneHitObject & hitObject = hitObjects[objIdx];
+			hitObject = {};
+			hitObject.type = SceneHitObject::eTypeSphere;
+			hitObject.materialIndex = sphere.materialIndex;
+			hitObject.param0 = Vec4C(sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius);
+			hitObject.param1 = Vec4C(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		// Frames in flight keep reading the current copies
+		VkBuffer sceneBuffer = flipDoubleBufferedStorage(&m_sceneBuffers, sizeof(SceneHitObject), numHitObjects);
+		VkBuffer bvhBuffer = flipDoubleBufferedStorage(&m_bvhBuffers, sizeof(scene::BVHNode), numBVHNodes);
+		uploadBufferData(sceneBuffer, hitObjects.data(), numHitObjects * sizeof(SceneHitObject));
+		uploadBufferData(bvhBuffer, bvhNodes.data(), numBVHNodes * sizeof(scene::BVHNode));
+	}
+
+	void Wrapper::uploadMaterials()
+	{
+		const uint32_t numMaterials = (uint32_t)m_scene.materials.size();
+
+		m_numSceneMaterials = numMaterials;
+		m_isMaterialsDirty = false;
+
+		if (numMaterials == 0)
+			return;
+
+		std::vector<SceneMaterial> materials(numMaterials);
+		for (uint32_t materialIdx = 0; materialIdx < numMaterials; ++materialIdx)
+		{
+			const scene::Material & sceneMaterial = m_scene.materials[materialIdx];
+			SceneMaterial & material = materials[materialIdx];
+			material = {};
+			material.type = (int32_t)sceneMaterial.type;
+			material.roughness = sceneMaterial.roughness;
+			material.refIdx = sceneMaterial.refIdx;
+			material.albedo = Vec4C(sceneMaterial.albedo.x, sceneMaterial.albedo.y, sceneMaterial.albedo.z, 1.0f);
+		}
+
+		VkBuffer materialsBuffer = flipDoubleBufferedStorage(&m_materialsBuffers, sizeof(SceneMaterial), numMaterials);
+		uploadBufferData(materialsBuffer, materials.data(), numMaterials * sizeof(SceneMaterial));
 	}
 
 	void Wrapper::initDescriptorSetLayout()
 	{
-		const uint32_t numBindings = 2;
+		const uint32_t numBindings = 11;
 		VkDescriptorSetLayoutBinding bindings[numBindings];
 
 		VkDescriptorSetLayoutBinding & uboDescriptorSetLayoutBinding = bindings[0];
 		uboDescriptorSetLayoutBinding = { };
 		uboDescriptorSetLayoutBinding.binding = 0;
-		uboDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		uboDescriptorSetLayoutBinding.descriptorCount = 1;
-		uboDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		uboDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		uboDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutBinding & samplerDescriptorSetLayoutBinding = bindings[1];
@@ -1638,9 +1928,69 @@ namespace vulkan
 		samplerDescriptorSetLayoutBinding.binding = 1;
 		samplerDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		samplerDescriptorSetLayoutBinding.descriptorCount = 1;
-		samplerDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		samplerDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		samplerDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
+		VkDescriptorSetLayoutBinding & accumImageDescriptorSetLayoutBinding = bindings[2];
+		accumImageDescriptorSetLayoutBinding = { };
+		accumImageDescriptorSetLayoutBinding.binding = 2;
+		accumImageDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		accumImageDescriptorSetLayoutBinding.descriptorCount = 1;
+		accumImageDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		accumImageDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding & sceneDescriptorSetLayoutBinding = bindings[3];
+		sceneDescriptorSetLayoutBinding = { };
+		sceneDescriptorSetLayoutBinding.binding = 3;
+		sceneDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		sceneDescriptorSetLayoutBinding.descriptorCount = 1;
+		sceneDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		sceneDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding & bvhDescriptorSetLayoutBinding = bindings[4];
+		bvhDescriptorSetLayoutBinding = { };
+		bvhDescriptorSetLayoutBinding.binding = 4;
+		bvhDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bvhDescriptorSetLayoutBinding.descriptorCount = 1;
+		bvhDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		bvhDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding & materialsDescriptorSetLayoutBinding = bindings[5];
+		materialsDescriptorSetLayoutBinding = { };
+		materialsDescriptorSetLayoutBinding.binding = 5;
+		materialsDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materialsDescriptorSetLayoutBinding.descriptorCount = 1;
+		materialsDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		materialsDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding & momentsImageDescriptorSetLayoutBinding = bindings[6];
+		momentsImageDescriptorSetLayoutBinding = { };
+		momentsImageDescriptorSetLayoutBinding.binding = 6;
+		momentsImageDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		momentsImageDescriptorSetLayoutBinding.descriptorCount = 1;
+		momentsImageDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		momentsImageDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding & sampleCountImageDescriptorSetLayoutBinding = bindings[7];
+		sampleCountImageDescriptorSetLayoutBinding = { };
+		sampleCountImageDescriptorSetLayoutBinding.binding = 7;
+		sampleCountImageDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		sampleCountImageDescriptorSetLayoutBinding.descriptorCount = 1;
+		sampleCountImageDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		sampleCountImageDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+		// Temporal reprojection images: history and the pair of surface images, only the compute-based backends reproject
+		for (uint32_t temporalBindingIdx = 0; temporalBindingIdx < 3; ++temporalBindingIdx)
+		{
+			VkDescriptorSetLayoutBinding & temporalImageDescriptorSetLayoutBinding = bindings[8 + temporalBindingIdx];
+			temporalImageDescriptorSetLayoutBinding = { };
+			temporalImageDescriptorSetLayoutBinding.binding = 8 + temporalBindingIdx;
+			temporalImageDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			temporalImageDescriptorSetLayoutBinding.descriptorCount = 1;
+			temporalImageDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			temporalImageDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+		}
+
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
 		descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 		descriptorSetLayoutCreateInfo.bindingCount = numBindings;
@@ -1665,42 +2015,63 @@ namespace vulkan
 
 	void Wrapper::initUBO()
 	{
-		size_t bufferSize = sizeof(UniformBufferObject);
+		// Each frame in flight gets its own slot, so that updating the UBO for the next frame
+		//	doesn't interfere with the frames that are still being processed by the GPU
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(m_vkPhysicalDeviceData.vkHandle, &deviceProperties);
+
+		const VkDeviceSize slotAlignment = std::max(deviceProperties.limits.minUniformBufferOffsetAlignment, (VkDeviceSize)1);
+		m_uboSlotSize = ((VkDeviceSize)sizeof(UniformBufferObject) + slotAlignment - 1) / slotAlignment * slotAlignment;
+
 		createBuffer(
-			m_vkPhysicalDeviceData.vkHandle,
-			m_vkLogicalDeviceData.vkHandle,
-			(VkDeviceSize)bufferSize,
+			m_uboSlotSize * (VkDeviceSize)m_frames.size(),
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&m_vkUBOBuffer,
-			&m_vkUBOBufferDeviceMemory
+			&m_vkUBOBufferAllocation
 			);
 	}
 	void Wrapper::deinitUBO()
 	{
 		vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, m_vkUBOBuffer, nullptr);
-		vkFreeMemory(m_vkLogicalDeviceData.vkHandle, m_vkUBOBufferDeviceMemory, nullptr);
+		m_vkUBOBuffer = VK_NULL_HANDLE;
+		m_memoryAllocator.free(&m_vkUBOBufferAllocation);
 	}
 
 	void Wrapper::initDescriptorPool()
 	{
-		const uint32_t descriptorPoolSizesNum = 2;
+		// One descriptor set per frame in flight
+		const uint32_t numFrames = (uint32_t)m_frames.size();
+
+		const uint32_t descriptorPoolSizesNum = 4;
 		VkDescriptorPoolSize descriptorPoolSizes[descriptorPoolSizesNum];
 
 		VkDescriptorPoolSize & uboDescriptorPoolSize = descriptorPoolSizes[0];
 		uboDescriptorPoolSize = { };
-		uboDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboDescriptorPoolSize.descriptorCount = 1;
+		uboDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		uboDescriptorPoolSize.descriptorCount = numFrames;
 
 		VkDescriptorPoolSize & samplerDescriptorPoolSize = descriptorPoolSizes[1];
 		samplerDescriptorPoolSize = { };
 		samplerDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerDescriptorPoolSize.descriptorCount = 1;
+		samplerDescriptorPoolSize.descriptorCount = numFrames;
+
+		VkDescriptorPoolSize & storageImageDescriptorPoolSize = descriptorPoolSizes[2];
+		storageImageDescriptorPoolSize = { };
+		storageImageDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		// Accumulation, moments, sample count, history and two surface images
+		storageImageDescriptorPoolSize.descriptorCount = 6 * numFrames;
+
+		VkDescriptorPoolSize & storageBufferDescriptorPoolSize = descriptorPoolSizes[3];
+		storageBufferDescriptorPoolSize = { };
+		storageBufferDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		// Scene, BVH and materials buffers
+		storageBufferDescriptorPoolSize.descriptorCount = 3 * numFrames;
 
 		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
 		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		descriptorPoolCreateInfo.flags = (VkDescriptorPoolCreateFlags)0;
-		descriptorPoolCreateInfo.maxSets = 1;
+		descriptorPoolCreateInfo.maxSets = numFrames;
 		descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizesNum;
 		descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
 
@@ -1723,16 +2094,21 @@ namespace vulkan
 
 	void Wrapper::initDescriptorSet()
 	{
+		const uint32_t numFrames = (uint32_t)m_frames.size();
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts(numFrames, m_vkUBODescriptorSetLayout);
+		std::vector<VkDescriptorSet> descriptorSets(numFrames);
+
 		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
 		descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		descriptorSetAllocateInfo.descriptorPool = m_vkDescriptorPool;
-		descriptorSetAllocateInfo.descriptorSetCount = 1;
-		descriptorSetAllocateInfo.pSetLayouts = &m_vkUBODescriptorSetLayout;
+		descriptorSetAllocateInfo.descriptorSetCount = numFrames;
+		descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
 
 		VkResult result = vkAllocateDescriptorSets(
 								m_vkLogicalDeviceData.vkHandle,
 								&descriptorSetAllocateInfo,
-								&m_vkDescriptorSet
+								descriptorSets.data()
 								);
 		if (result != VK_SUCCESS)
 		{
@@ -1740,7 +2116,26 @@ namespace vulkan
 			printf("Failed to allocate descriptor set!\n");
 		}
 
+		for (uint32_t frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+		{
+			m_frames[frameIdx].descriptorSet = descriptorSets[frameIdx];
+		}
+
+		updateDescriptorSets();
+	}
+	void Wrapper::updateDescriptorSets()
+	{
+		for (uint32_t frameIdx = 0, frameIdxEnd = (uint32_t)m_frames.size(); frameIdx < frameIdxEnd; ++frameIdx)
+		{
+			updateFrameDescriptorSet(frameIdx);
+		}
+	}
+	void Wrapper::updateFrameDescriptorSet(uint32_t frameIdx)
+	{
+		FrameData & frame = m_frames[frameIdx];
+
 		VkDescriptorBufferInfo descriptorBufferInfo = {};
+		// Slot of the frame is selected with the dynamic offset at bind time
 		descriptorBufferInfo.buffer = m_vkUBOBuffer;
 		descriptorBufferInfo.offset = 0;
 		descriptorBufferInfo.range = (VkDeviceSize)sizeof(UniformBufferObject);
@@ -1750,17 +2145,56 @@ namespace vulkan
 		descriptorImageInfo.imageView = m_vkTextureImageView;
 		descriptorImageInfo.sampler = m_vkTextureSampler;
 
-		const uint32_t writeDescriptorSetsNum = 2;
+		VkDescriptorImageInfo accumDescriptorImageInfo = {};
+		accumDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		accumDescriptorImageInfo.imageView = m_vkAccumImageView;
+		accumDescriptorImageInfo.sampler = VK_NULL_HANDLE;
+
+		VkDescriptorBufferInfo sceneDescriptorBufferInfo = {};
+		sceneDescriptorBufferInfo.buffer = m_sceneBuffers.getCurBuffer();
+		sceneDescriptorBufferInfo.offset = 0;
+		sceneDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo bvhDescriptorBufferInfo = {};
+		bvhDescriptorBufferInfo.buffer = m_bvhBuffers.getCurBuffer();
+		bvhDescriptorBufferInfo.offset = 0;
+		bvhDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo materialsDescriptorBufferInfo = {};
+		materialsDescriptorBufferInfo.buffer = m_materialsBuffers.getCurBuffer();
+		materialsDescriptorBufferInfo.offset = 0;
+		materialsDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo momentsDescriptorImageInfo = {};
+		momentsDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		momentsDescriptorImageInfo.imageView = m_vkMomentsImageView;
+		momentsDescriptorImageInfo.sampler = VK_NULL_HANDLE;
+
+		VkDescriptorImageInfo sampleCountDescriptorImageInfo = {};
+		sampleCountDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		sampleCountDescriptorImageInfo.imageView = m_vkSampleCountImageView;
+		sampleCountDescriptorImageInfo.sampler = VK_NULL_HANDLE;
+
+		VkDescriptorImageInfo temporalDescriptorImageInfos[3] = {};
+		const VkImageView temporalImageViews[3] = { m_vkHistoryImageView, m_vkSurfaceImageViews[0], m_vkSurfaceImageViews[1] };
+		for (uint32_t temporalImageIdx = 0; temporalImageIdx < 3; ++temporalImageIdx)
+		{
+			temporalDescriptorImageInfos[temporalImageIdx].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			temporalDescriptorImageInfos[temporalImageIdx].imageView = temporalImageViews[temporalImageIdx];
+			temporalDescriptorImageInfos[temporalImageIdx].sampler = VK_NULL_HANDLE;
+		}
+
+		const uint32_t writeDescriptorSetsNum = 11;
 		VkWriteDescriptorSet writeDescriptorSets[writeDescriptorSetsNum];
 
 		VkWriteDescriptorSet & uboWriteDescriptorSet = writeDescriptorSets[0];
 		uboWriteDescriptorSet = { };
 		uboWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		uboWriteDescriptorSet.dstSet = m_vkDescriptorSet;
+		uboWriteDescriptorSet.dstSet = frame.descriptorSet;
 		uboWriteDescriptorSet.dstBinding = 0;
 		uboWriteDescriptorSet.dstArrayElement = 0;
 		uboWriteDescriptorSet.descriptorCount = 1;
-		uboWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		uboWriteDescriptorSet.pImageInfo = nullptr;
 		uboWriteDescriptorSet.pBufferInfo = &descriptorBufferInfo;
 		uboWriteDescriptorSet.pTexelBufferView = nullptr;
@@ -1768,7 +2202,7 @@ namespace vulkan
 		VkWriteDescriptorSet & samplerWriteDescriptorSet = writeDescriptorSets[1];
 		samplerWriteDescriptorSet = { };
 		samplerWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		samplerWriteDescriptorSet.dstSet = m_vkDescriptorSet;
+		samplerWriteDescriptorSet.dstSet = frame.descriptorSet;
 		samplerWriteDescriptorSet.dstBinding = 1;
 		samplerWriteDescriptorSet.dstArrayElement = 0;
 		samplerWriteDescriptorSet.descriptorCount = 1;
@@ -1777,110 +2211,386 @@ namespace vulkan
 		samplerWriteDescriptorSet.pBufferInfo = nullptr;
 		samplerWriteDescriptorSet.pTexelBufferView = nullptr;
 
+		VkWriteDescriptorSet & accumWriteDescriptorSet = writeDescriptorSets[2];
+		accumWriteDescriptorSet = { };
+		accumWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		accumWriteDescriptorSet.dstSet = frame.descriptorSet;
+		accumWriteDescriptorSet.dstBinding = 2;
+		accumWriteDescriptorSet.dstArrayElement = 0;
+		accumWriteDescriptorSet.descriptorCount = 1;
+		accumWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		accumWriteDescriptorSet.pImageInfo = &accumDescriptorImageInfo;
+		accumWriteDescriptorSet.pBufferInfo = nullptr;
+		accumWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet & sceneWriteDescriptorSet = writeDescriptorSets[3];
+		sceneWriteDescriptorSet = { };
+		sceneWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		sceneWriteDescriptorSet.dstSet = frame.descriptorSet;
+		sceneWriteDescriptorSet.dstBinding = 3;
+		sceneWriteDescriptorSet.dstArrayElement = 0;
+		sceneWriteDescriptorSet.descriptorCount = 1;
+		sceneWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		sceneWriteDescriptorSet.pImageInfo = nullptr;
+		sceneWriteDescriptorSet.pBufferInfo = &sceneDescriptorBufferInfo;
+		sceneWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet & bvhWriteDescriptorSet = writeDescriptorSets[4];
+		bvhWriteDescriptorSet = { };
+		bvhWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		bvhWriteDescriptorSet.dstSet = frame.descriptorSet;
+		bvhWriteDescriptorSet.dstBinding = 4;
+		bvhWriteDescriptorSet.dstArrayElement = 0;
+		bvhWriteDescriptorSet.descriptorCount = 1;
+		bvhWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bvhWriteDescriptorSet.pImageInfo = nullptr;
+		bvhWriteDescriptorSet.pBufferInfo = &bvhDescriptorBufferInfo;
+		bvhWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet & materialsWriteDescriptorSet = writeDescriptorSets[5];
+		materialsWriteDescriptorSet = { };
+		materialsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		materialsWriteDescriptorSet.dstSet = frame.descriptorSet;
+		materialsWriteDescriptorSet.dstBinding = 5;
+		materialsWriteDescriptorSet.dstArrayElement = 0;
+		materialsWriteDescriptorSet.descriptorCount = 1;
+		materialsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materialsWriteDescriptorSet.pImageInfo = nullptr;
+		materialsWriteDescriptorSet.pBufferInfo = &materialsDescriptorBufferInfo;
+		materialsWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet & momentsWriteDescriptorSet = writeDescriptorSets[6];
+		momentsWriteDescriptorSet = { };
+		momentsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		momentsWriteDescriptorSet.dstSet = frame.descriptorSet;
+		momentsWriteDescriptorSet.dstBinding = 6;
+		momentsWriteDescriptorSet.dstArrayElement = 0;
+		momentsWriteDescriptorSet.descriptorCount = 1;
+		momentsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		momentsWriteDescriptorSet.pImageInfo = &momentsDescriptorImageInfo;
+		momentsWriteDescriptorSet.pBufferInfo = nullptr;
+		momentsWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet & sampleCountWriteDescriptorSet = writeDescriptorSets[7];
+		sampleCountWriteDescriptorSet = { };
+		sampleCountWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		sampleCountWriteDescriptorSet.dstSet = frame.descriptorSet;
+		sampleCountWriteDescriptorSet.dstBinding = 7;
+		sampleCountWriteDescriptorSet.dstArrayElement = 0;
+		sampleCountWriteDescriptorSet.descriptorCount = 1;
+		sampleCountWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		sampleCountWriteDescriptorSet.pImageInfo = &sampleCountDescriptorImageInfo;
+		sampleCountWriteDescriptorSet.pBufferInfo = nullptr;
+		sampleCountWriteDescriptorSet.pTexelBufferView = nullptr;
+
+		for (uint32_t temporalImageIdx = 0; temporalImageIdx < 3; ++temporalImageIdx)
+		{
+			VkWriteDescriptorSet & temporalWriteDescriptorSet = writeDescriptorSets[8 + temporalImageIdx];
+			temporalWriteDescriptorSet = { };
+			temporalWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			temporalWriteDescriptorSet.dstSet = frame.descriptorSet;
+			temporalWriteDescriptorSet.dstBinding = 8 + temporalImageIdx;
+			temporalWriteDescriptorSet.dstArrayElement = 0;
+			temporalWriteDescriptorSet.descriptorCount = 1;
+			temporalWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			temporalWriteDescriptorSet.pImageInfo = &temporalDescriptorImageInfos[temporalImageIdx];
+			temporalWriteDescriptorSet.pBufferInfo = nullptr;
+			temporalWriteDescriptorSet.pTexelBufferView = nullptr;
+		}
+
 		vkUpdateDescriptorSets(m_vkLogicalDeviceData.vkHandle, writeDescriptorSetsNum, writeDescriptorSets, 0, nullptr);
 	}
 	void Wrapper::deinitDescriptorSet()
 	{
 		// No need to explicitly deallocate descriptor set since its lifetime
 		//	is equal to lifetime of the descrptor set pool
-		//vkFreeDescriptorSets(m_vkLogicalDeviceData.vkHandle, m_vkDescriptorPool, 1, &m_vkDescriptorSet);
+		for (FrameData & frame : m_frames)
+		{
+			//vkFreeDescriptorSets(m_vkLogicalDeviceData.vkHandle, m_vkDescriptorPool, 1, &frame.descriptorSet);
+			frame.descriptorSet = VK_NULL_HANDLE;
+		}
 	}
 
 	void Wrapper::buildCommandBuffers()
 	{
-		// Command buffer outputs to a certain image, and since swapchain has several of them - we need several command buffers
-		m_vkCommandBuffers.resize(m_vkSwapchainData.framebuffers.size());
+		// Command buffers are re-recorded each frame (they reference swapchain image that is only known after
+		//	the acquisition), so we only need one command buffer per frame in flight
+		std::vector<VkCommandBuffer> commandBuffers(m_frames.size());
 
 		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
 		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		commandBufferAllocateInfo.commandPool = m_vkCommandPool;
 		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		commandBufferAllocateInfo.commandBufferCount = (uint32_t)m_vkCommandBuffers.size();
+		commandBufferAllocateInfo.commandBufferCount = (uint32_t)commandBuffers.size();
 
-		if (vkAllocateCommandBuffers(m_vkLogicalDeviceData.vkHandle, &commandBufferAllocateInfo, m_vkCommandBuffers.data()) != VK_SUCCESS)
+		if (vkAllocateCommandBuffers(m_vkLogicalDeviceData.vkHandle, &commandBufferAllocateInfo, commandBuffers.data()) != VK_SUCCESS)
 		{
 			// TODO: error
 			printf("Failed to allocate command buffers!\n");
 		}
 
-		for (size_t i = 0, iend = m_vkCommandBuffers.size(); i < iend; ++i)
+		for (size_t frameIdx = 0, frameIdxEnd = m_frames.size(); frameIdx < frameIdxEnd; ++frameIdx)
+		{
+			m_frames[frameIdx].commandBuffer = commandBuffers[frameIdx];
+		}
+	}
+	void Wrapper::destroyCommandBuffers()
+	{
+		for (FrameData & frame : m_frames)
 		{
-			VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-			commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			commandBufferBeginInfo.pInheritanceInfo = nullptr;
+			vkFreeCommandBuffers(m_vkLogicalDeviceData.vkHandle, m_vkCommandPool, 1, &frame.commandBuffer);
+			frame.commandBuffer = VK_NULL_HANDLE;
+		}
+	}
 
-			vkBeginCommandBuffer(m_vkCommandBuffers[i], &commandBufferBeginInfo);
+	void Wrapper::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndexInSwapchain, uint32_t frameIdx)
+	{
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = nullptr;
 
-			VkClearValue clearColor = { 0.1f, 0.2f, 0.4f, 1.0f };
+		// Command pool is created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, so this implicitly resets the buffer
+		vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = m_vkRenderPass;
-			renderPassBeginInfo.framebuffer = m_vkSwapchainData.framebuffers[i];
-			renderPassBeginInfo.renderArea.offset = { 0, 0 };
-			renderPassBeginInfo.renderArea.extent = m_vkSwapchainData.extent;
-			renderPassBeginInfo.clearValueCount = 1;
-			renderPassBeginInfo.pClearValues = &clearColor;
+		// Slot fence is already waited on, so its descriptor sets are not in use anymore
+		FrameData & frame = m_frames[frameIdx];
+		if (frame.areDescriptorSetsDirty)
+		{
+			updateFrameDescriptorSet(frameIdx);
+			if (m_tracerBackend == TracerBackend::eWavefront)
+			{
+				updateWavefrontDescriptorSet(frameIdx);
+			}
+			frame.areDescriptorSetsDirty = false;
+		}
 
-			vkCmdBeginRenderPass(m_vkCommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		beginGpuTimersFrame(commandBuffer, frameIdx);
+		beginGpuTimer(commandBuffer, frameIdx, eGpuTimerFrame);
 
-			vkCmdBindPipeline(m_vkCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
+		recordPendingResourceInits(commandBuffer);
 
-			VkBuffer vertexBuffers[] = { m_vkTriangleVertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(m_vkCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(m_vkCommandBuffers[i], m_vkTriangleIndexBuffer, 0, m_vkTriangleIndexBufferType);
+		// Accumulation images (and the adaptive sampling mask) are written by the previous frame as well, make sure its writes are visible
+		{
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-			vkCmdBindDescriptorSets(
-				m_vkCommandBuffers[i],
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				m_vkPipelineLayout,
-				0,
-				1,
-				&m_vkDescriptorSet,
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				0,
-				nullptr
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr
 				);
+		}
 
-			vkCmdDrawIndexed(m_vkCommandBuffers[i], (uint32_t)m_vkTriangleIndicesCount, 1, 0, 0, 0);
+		if (m_isHistoryReprojected)
+		{
+			recordTemporalHistoryCopy(commandBuffer);
+		}
 
-			vkCmdEndRenderPass(m_vkCommandBuffers[i]);
+		if (m_tracerBackend == TracerBackend::eCompute)
+		{
+			beginGpuTimer(commandBuffer, frameIdx, eGpuTimerTracing);
+			recordComputeTracing(commandBuffer, frameIdx);
+			endGpuTimer(commandBuffer, frameIdx, eGpuTimerTracing);
+		}
+		else if (m_tracerBackend == TracerBackend::eWavefront)
+		{
+			beginGpuTimer(commandBuffer, frameIdx, eGpuTimerTracing);
+			recordWavefrontTracing(commandBuffer, frameIdx);
+			endGpuTimer(commandBuffer, frameIdx, eGpuTimerTracing);
+		}
 
-			if (vkEndCommandBuffer(m_vkCommandBuffers[i]) != VK_SUCCESS)
-			{
-				// TODO: error
-				printf("Failed to record command buffer %zd!\n", i);
-			}
+		if (m_isHistoryReprojected)
+		{
+			beginGpuTimer(commandBuffer, frameIdx, eGpuTimerTemporal);
+			recordTemporalReprojection(commandBuffer, frameIdx);
+			endGpuTimer(commandBuffer, frameIdx, eGpuTimerTemporal);
+		}
+
+		VkClearValue clearColor = { 0.1f, 0.2f, 0.4f, 1.0f };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = m_vkRenderPass;
+		renderPassBeginInfo.framebuffer = m_vkSwapchainData.framebuffers[imageIndexInSwapchain];
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = m_vkSwapchainData.extent;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearColor;
+
+		beginGpuTimer(commandBuffer, frameIdx, eGpuTimerRenderPass);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)m_vkSwapchainData.extent.width;
+		viewport.height = (float)m_vkSwapchainData.extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = m_vkSwapchainData.extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkBuffer vertexBuffers[] = { m_vkTriangleVertexBuffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, m_vkTriangleIndexBuffer, 0, m_vkTriangleIndexBufferType);
+
+		const uint32_t uboDynamicOffset = getUBODynamicOffset(frameIdx);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			m_vkPipelineLayout,
+			0,
+			1,
+			&m_frames[frameIdx].descriptorSet,
+			1,
+			&uboDynamicOffset
+			);
+
+		vkCmdDrawIndexed(commandBuffer, (uint32_t)m_vkTriangleIndicesCount, 1, 0, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+		endGpuTimer(commandBuffer, frameIdx, eGpuTimerRenderPass);
+
+		if (m_isAdaptiveSamplingEnabled)
+		{
+			beginGpuTimer(commandBuffer, frameIdx, eGpuTimerAdaptiveMask);
+			recordAdaptiveMask(commandBuffer, frameIdx);
+			endGpuTimer(commandBuffer, frameIdx, eGpuTimerAdaptiveMask);
+		}
+
+		endGpuTimer(commandBuffer, frameIdx, eGpuTimerFrame);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to record command buffer for frame %d!\n", (int)frameIdx);
 		}
 	}
-	void Wrapper::destroyCommandBuffers()
+
+	void Wrapper::recordComputeTracing(VkCommandBuffer commandBuffer, uint32_t frameIdx)
 	{
-		vkFreeCommandBuffers(m_vkLogicalDeviceData.vkHandle, m_vkCommandPool, (uint32_t)m_vkCommandBuffers.size(), m_vkCommandBuffers.data());
-		m_vkCommandBuffers.resize(0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkComputePipeline);
+
+		const uint32_t uboDynamicOffset = getUBODynamicOffset(frameIdx);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_vkComputePipelineLayout,
+			0,
+			1,
+			&m_frames[frameIdx].descriptorSet,
+			1,
+			&uboDynamicOffset
+			);
+
+		const uint32_t renderWidth = m_renderExtent.width;
+		const uint32_t renderHeight = m_renderExtent.height;
+		const uint32_t tileSizeX = (m_computeTileSizeX > 0) ? std::min(m_computeTileSizeX, renderWidth) : renderWidth;
+		const uint32_t tileSizeY = (m_computeTileSizeY > 0) ? std::min(m_computeTileSizeY, renderHeight) : renderHeight;
+
+		// Tiles are independent, so no synchronization is required between the dispatches
+		for (uint32_t tileY = 0; tileY < renderHeight; tileY += tileSizeY)
+		{
+			for (uint32_t tileX = 0; tileX < renderWidth; tileX += tileSizeX)
+			{
+				ComputeTilePushConstants pushConstants;
+				pushConstants.tileOffset[0] = (int32_t)tileX;
+				pushConstants.tileOffset[1] = (int32_t)tileY;
+				pushConstants.tileSize[0] = (int32_t)std::min(tileSizeX, renderWidth - tileX);
+				pushConstants.tileSize[1] = (int32_t)std::min(tileSizeY, renderHeight - tileY);
+
+				vkCmdPushConstants(commandBuffer, m_vkComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputeTilePushConstants), &pushConstants);
+
+				const uint32_t numGroupsX = (pushConstants.tileSize[0] + m_computeWorkgroupSizeX - 1) / m_computeWorkgroupSizeX;
+				const uint32_t numGroupsY = (pushConstants.tileSize[1] + m_computeWorkgroupSizeY - 1) / m_computeWorkgroupSizeY;
+				vkCmdDispatch(commandBuffer, numGroupsX, numGroupsY, 1);
+			}
+		}
+
+		// Fullscreen quad pass presents the accumulation image
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
 	}
 
-	void Wrapper::initSemaphores()
+	void Wrapper::initSyncPrimitives()
 	{
 		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateSemaphore(m_vkLogicalDeviceData.vkHandle, &semaphoreCreateInfo, nullptr, &m_vkSemaphoreImageAvailable) != VK_SUCCESS)
+		// Fences are created signaled, so that the very first wait on each frame slot doesn't block
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (FrameData & frame : m_frames)
 		{
-			// TODO: error
-			printf("Failed to create \"image available\" semaphore!\n");
+			if (vkCreateSemaphore(m_vkLogicalDeviceData.vkHandle, &semaphoreCreateInfo, nullptr, &frame.semaphoreImageAvailable) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to create \"image available\" semaphore!\n");
+			}
+			if (vkCreateSemaphore(m_vkLogicalDeviceData.vkHandle, &semaphoreCreateInfo, nullptr, &frame.semaphoreRenderFinished) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to create \"render finished\" semaphore!\n");
+			}
+			if (vkCreateFence(m_vkLogicalDeviceData.vkHandle, &fenceCreateInfo, nullptr, &frame.fenceInFlight) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to create \"in flight\" fence!\n");
+			}
 		}
-		if (vkCreateSemaphore(m_vkLogicalDeviceData.vkHandle, &semaphoreCreateInfo, nullptr, &m_vkSemaphoreRenderFinished) != VK_SUCCESS)
+	}
+	
+	void Wrapper::deinitSyncPrimitives()
+	{
+		for (FrameData & frame : m_frames)
 		{
-			// TODO: error
-			printf("Failed to create \"render finished\" semaphore!\n");
+			vkDestroyFence(m_vkLogicalDeviceData.vkHandle, frame.fenceInFlight, nullptr);
+			vkDestroySemaphore(m_vkLogicalDeviceData.vkHandle, frame.semaphoreRenderFinished, nullptr);
+			vkDestroySemaphore(m_vkLogicalDeviceData.vkHandle, frame.semaphoreImageAvailable, nullptr);
 		}
 	}
-	
-	void Wrapper::deinitSemaphores()
+
+	void Wrapper::waitForCurrentFrameSlot()
 	{
-		vkDestroySemaphore(m_vkLogicalDeviceData.vkHandle, m_vkSemaphoreRenderFinished, nullptr);
-		vkDestroySemaphore(m_vkLogicalDeviceData.vkHandle, m_vkSemaphoreImageAvailable, nullptr);
+		vkWaitForFences(m_vkLogicalDeviceData.vkHandle, 1, &m_frames[m_curFrameIdx].fenceInFlight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		// Frames up to the one that used this slot are done, and so are the resources retired before them
+		releaseRetiredResources(false);
+		releaseCompletedUploads(false);
+	}
+
+	void Wrapper::initHeadless(int width, int height)
+	{
+		m_isHeadless = true;
+		init(nullptr, width, height);
 	}
 
 	void Wrapper::init(HWND hWnd, int width, int height)
@@ -1889,6 +2599,10 @@ namespace vulkan
 		m_windowWidth = width;
 		m_windowHeight = height;
 
+		m_frames.resize(m_numFramesInFlight);
+		m_curFrameIdx = 0;
+		m_numSubmittedFrames = 0;
+
 		buildRequiredInstanceExtensionsList(true);
 		buildSupportedInstanceExtensionsList(true);
 
@@ -1906,16 +2620,25 @@ namespace vulkan
 			initDebugCallback(m_vkDebugCallback);
 		}
 
-		initWindowSurface(hWnd);
+		if (!m_isHeadless)
+		{
+			initWindowSurface(hWnd);
+		}
 
 		selectPhysicalDevice();
 
 		initLogicalDevice();
+		m_memoryAllocator.init(m_vkPhysicalDeviceData.vkHandle, m_vkLogicalDeviceData.vkHandle);
 		
 		initSwapchain();
+		updateRenderExtent();
+
+		const bool isComputeBackend = (m_tracerBackend == TracerBackend::eCompute);
+		const bool isWavefrontBackend = (m_tracerBackend == TracerBackend::eWavefront);
 
+		// In case of the compute-based backends, fullscreen quad only presents the traced image
 		std::vector<char> vertShaderByteCode = readShaderFile("shaders/bin/test.vs.spv");
-		std::vector<char> fragShaderByteCode = readShaderFile("shaders/bin/pathtracer.fs.spv");
+		std::vector<char> fragShaderByteCode = readShaderFile((isComputeBackend || isWavefrontBackend) ? "shaders/bin/blit.fs.spv" : "shaders/bin/pathtracer.fs.spv");
 
 		VkShaderModule vertShaderModule = initShaderModule(vertShaderByteCode);
 		VkShaderModule fragShaderModule = initShaderModule(fragShaderByteCode);
@@ -1923,75 +2646,267 @@ namespace vulkan
 		m_vkShaderModules.push_back(vertShaderModule);
 		m_vkShaderModules.push_back(fragShaderModule);
 
+		if (isComputeBackend)
+		{
+			std::vector<char> compShaderByteCode = readShaderFile("shaders/bin/pathtracer.cs.spv");
+			m_vkShaderModules.push_back(initShaderModule(compShaderByteCode));
+		}
+
+		initPipelineCache();
 		initRenderPass();
 		initDescriptorSetLayout();
 		initCommandPool();
+		initUploads();
+		initGpuTimers();
 		initUBO();
 		initTextureImage();
 		initTextureImageView();
 		initTextureSampler();
+		initAccumImage();
+		initAdaptiveSamplingImages();
+		initTemporalImages();
+		if (m_scene.spheres.empty())
+		{
+			scene::buildDefaultScene(&m_scene);
+		}
+		initSceneBuffer((uint32_t)m_scene.spheres.size());
+		// Binary tree with at least one primitive per leaf
+		initBVHBuffer(2 * (uint32_t)m_scene.spheres.size());
+		uploadScene();
+		initMaterialsBuffer((uint32_t)m_scene.materials.size());
+		uploadMaterials();
 		initDescriptorPool();
 		initDescriptorSet();
 		initPipelineState();
+		initAdaptiveMaskPipeline();
+		initTemporalPipeline();
+		if (isComputeBackend)
+		{
+			initComputePipelineState();
+		}
+		else if (isWavefrontBackend)
+		{
+			initWavefront();
+		}
 
 		initSwapchainFramebuffers();
 
 		initFSQuadBuffers();
 		buildCommandBuffers();
 
-		initSemaphores();
+		initSyncPrimitives();
 	}
 
 	void Wrapper::deinit()
 	{
 		// Wait before the last frame is fully rendered
 		vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle);
+		releaseRetiredResources(true);
+		m_pendingStorageImageTransitions.resize(0);
+		m_pendingBufferClears.resize(0);
 
-		deinitSemaphores();
+		deinitSyncPrimitives();
 
 		// No need to call destroyCommandBuffers as this will be done automatically by Vulkan on command pool deinitialization
 		deinitFSQuadBuffers();
 
 		deinitSwapchainFramebuffers();
+		if (m_tracerBackend == TracerBackend::eCompute)
+		{
+			deinitComputePipelineState();
+		}
+		else if (m_tracerBackend == TracerBackend::eWavefront)
+		{
+			deinitWavefront();
+		}
+		deinitTemporalPipeline();
+		deinitAdaptiveMaskPipeline();
 		deinitPipelineState();
 		deinitDescriptorSet();
 		deinitDescriptorPool();
+		deinitMaterialsBuffer();
+		deinitBVHBuffer();
+		deinitSceneBuffer();
+		deinitTemporalImages();
+		deinitAdaptiveSamplingImages();
+		deinitAccumImage();
 		deinitTextureSampler();
 		deinitTextureImageView();
 		deinitTextureImage();
 		deinitUBO();
+		deinitGpuTimers();
+		deinitUploads();
 		deinitCommandPool();
 		deinitDescriptorSetLayout();
 		deinitRenderPass();
+		deinitPipelineCache();
 		deinitShaderModules();
 		deinitSwapchain();
+		m_memoryAllocator.deinit();
 		deinitLogicalDevice();
 		deinitDebugCallback();
-		deinitWindowSurface();
+		if (!m_isHeadless)
+		{
+			deinitWindowSurface();
+		}
 		deinitInstance();
 	}
 
+	void Wrapper::updateCamera(double dtMS)
+	{
+		if (m_isCameraAnimated)
+		{
+			m_cameraTimeMS += dtMS;
+		}
+
+		// CPU reference tracer uses the same camera, see `cpu::PathTracer`
+		scene::buildDefaultCamera(&m_camera, m_cameraTimeMS, m_vkSwapchainData.extent.width / (float)m_vkSwapchainData.extent.height);
+
+		m_isHistoryReprojected = false;
+		if (!scene::isCameraEqual(m_camera, m_prevCamera))
+		{
+			// History is only valid if nothing else restarted the accumulation since the previous frame,
+			//	otherwise it doesn't match the scene, settings or the render extent anymore
+			const bool isHistoryValid = (m_accumFrameCount > 0);
+			resetAccumulation();
+			m_isHistoryReprojected = isTemporalReprojectionActive() && isHistoryValid;
+		}
+		m_prevCamera = m_camera;
+	}
+
 	void Wrapper::update(double dtMS)
 	{
+		// Only the frame that used this slot `m_numFramesInFlight` frames ago needs to be finished,
+		//	the rest of the frames could still be processed by the GPU
+		waitForCurrentFrameSlot();
+
+		if (m_isSceneDirty)
+		{
+			uploadScene();
+			resetAccumulation();
+		}
+		if (m_isMaterialsDirty)
+		{
+			uploadMaterials();
+			resetAccumulation();
+		}
+
+		updateDynamicResolution();
+
 		m_elapsedTimeMS += dtMS;
+		updateCamera(dtMS);
+
+		scene::computeCameraRayGenParams(m_camera, &m_cameraRayGenParams);
+		const scene::CameraRayGenParams & cameraRayGenParams = m_cameraRayGenParams;
+
+		auto toVec4 = [](const Vec3 & v) -> Vec4 { return Vec4C(v.x, v.y, v.z, 0.0f); };
+
 		UniformBufferObject ubo = {};
+		ubo.cameraOrigin = toVec4(cameraRayGenParams.origin);
+		ubo.cameraLowerLeftCorner = toVec4(cameraRayGenParams.lowerLeftCorner);
+		ubo.cameraAxisX = toVec4(cameraRayGenParams.axisX);
+		ubo.cameraAxisY = toVec4(cameraRayGenParams.axisY);
+		ubo.cameraLensX = toVec4(cameraRayGenParams.lensX);
+		ubo.cameraLensY = toVec4(cameraRayGenParams.lensY);
+		ubo.prevCameraOrigin = toVec4(m_prevCameraRayGenParams.origin);
+		ubo.prevCameraLowerLeftCorner = toVec4(m_prevCameraRayGenParams.lowerLeftCorner);
+		ubo.prevCameraAxisX = toVec4(m_prevCameraRayGenParams.axisX);
+		ubo.prevCameraAxisY = toVec4(m_prevCameraRayGenParams.axisY);
 		ubo.time = (float)m_elapsedTimeMS;
+		ubo.accumFrameCount = m_accumFrameCount;
+		ubo.samplesPerFrame = m_samplesPerFrame;
+		ubo.renderWidth = m_renderExtent.width;
+		ubo.renderHeight = m_renderExtent.height;
+		ubo.numHitObjects = m_numSceneHitObjects;
+		ubo.numMaterials = m_numSceneMaterials;
+		ubo.maxBounces = m_maxBounces;
+		ubo.rrMinDepth = m_russianRouletteMinDepth;
+		ubo.adaptiveSampling = m_isAdaptiveSamplingEnabled ? 1 : 0;
+		ubo.adaptiveErrorThreshold = m_adaptiveErrorThreshold;
+		ubo.adaptiveMinSamples = m_adaptiveMinSamples;
+		ubo.randomSeed = m_randomSeed;
+		ubo.accumStartFrame = m_accumStartFrame;
+		ubo.frameIdx = (uint32_t)m_numSubmittedFrames;
+		ubo.displayWidth = m_vkSwapchainData.extent.width;
+		ubo.displayHeight = m_vkSwapchainData.extent.height;
+		ubo.temporalReprojection = isTemporalReprojectionActive() ? 1 : 0;
+		ubo.temporalMaxHistorySamples = m_temporalMaxHistoryFrames * m_samplesPerFrame;
+
+		// UBO memory is persistently mapped, and the slot is no longer read by the GPU after the wait above
+		memcpy((uint8_t *)m_vkUBOBufferAllocation.mappedData + getUBODynamicOffset(m_curFrameIdx), &ubo, sizeof(ubo));
+	}
+
+	void Wrapper::submitFrame(VkSubmitInfo * submitInfo, VkFence fenceInFlight)
+	{
+		// Fence is only reset right before the submission that signals it, otherwise early exits (e.g. on the
+		//	swapchain recreation) would leave the frame slot blocked forever
+		vkResetFences(m_vkLogicalDeviceData.vkHandle, 1, &fenceInFlight);
+
+		if (vkQueueSubmit(m_vkLogicalDeviceData.graphicsQueue, 1, submitInfo, fenceInFlight) != VK_SUCCESS)
+		{
+			// TODO: warning
+			printf("Failed to submit draw command buffer!\n");
 
-		void * data;
-		vkMapMemory(m_vkLogicalDeviceData.vkHandle, m_vkUBOBufferDeviceMemory, 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(m_vkLogicalDeviceData.vkHandle, m_vkUBOBufferDeviceMemory);
+			// Same submission without the command buffer still waits and signals the semaphores, and most
+			//	importantly signals the fence, so that the next wait on this frame slot doesn't hang
+			submitInfo->commandBufferCount = 0;
+			submitInfo->pCommandBuffers = nullptr;
+			vkQueueSubmit(m_vkLogicalDeviceData.graphicsQueue, 1, submitInfo, fenceInFlight);
+			return;
+		}
+
+		// Frame is going to write the accumulation, so the next one could blend with it
+		++m_accumFrameCount;
+		m_prevCameraRayGenParams = m_cameraRayGenParams;
+	}
+
+	void Wrapper::renderOffscreen()
+	{
+		waitForCurrentFrameSlot();
+
+		FrameData & frame = m_frames[m_curFrameIdx];
+
+		// There is only one offscreen image, and no presentation engine to sync with
+		recordCommandBuffer(frame.commandBuffer, 0, m_curFrameIdx);
+
+		std::vector<VkSemaphore> renderBegSemaphores;
+		std::vector<VkPipelineStageFlags> pipelineWaitStages;
+		addUploadWaitSemaphores(&renderBegSemaphores, &pipelineWaitStages);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = (uint32_t)renderBegSemaphores.size();
+		submitInfo.pWaitSemaphores = renderBegSemaphores.empty() ? nullptr : renderBegSemaphores.data();
+		submitInfo.pWaitDstStageMask = pipelineWaitStages.empty() ? nullptr : pipelineWaitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = nullptr;
+
+		submitFrame(&submitInfo, frame.fenceInFlight);
+
+		m_curFrameIdx = (m_curFrameIdx + 1) % (uint32_t)m_frames.size();
+		++m_numSubmittedFrames;
 	}
 
 	void Wrapper::render()
 	{
-		// Sync to the presenting queue here in order to allow CPU/GPU code to overlap
-		vkQueueWaitIdle(m_vkLogicalDeviceData.presentingQueue);
+		if (m_isHeadless)
+		{
+			renderOffscreen();
+			return;
+		}
+
+		// Frame slot is normally already available at this point (see `update`), but this makes `render`
+		//	safe to call on its own as well
+		waitForCurrentFrameSlot();
+
+		FrameData & frame = m_frames[m_curFrameIdx];
 
 		uint32_t imageIndexInSwapchain;
 
 		{
-			VkResult result = vkAcquireNextImageKHR(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.vkHandle, std::numeric_limits<uint64_t>::max(), m_vkSemaphoreImageAvailable, VK_NULL_HANDLE, &imageIndexInSwapchain);
+			VkResult result = vkAcquireNextImageKHR(m_vkLogicalDeviceData.vkHandle, m_vkSwapchainData.vkHandle, std::numeric_limits<uint64_t>::max(), frame.semaphoreImageAvailable, VK_NULL_HANDLE, &imageIndexInSwapchain);
 
 			// VK_SUBOPTIMAL_KHR can be reported here, and it is not exactly a very bad thing, so no actions on that at the moment
 			if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -2008,25 +2923,26 @@ namespace vulkan
 			}
 		}
 
-		VkSemaphore renderBegSemaphore[] = { m_vkSemaphoreImageAvailable };
-		VkSemaphore renderEndSemaphore[] = { m_vkSemaphoreRenderFinished };
-		VkPipelineStageFlags pipelineWaitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		recordCommandBuffer(frame.commandBuffer, imageIndexInSwapchain, m_curFrameIdx);
+
+		std::vector<VkSemaphore> renderBegSemaphores(1, frame.semaphoreImageAvailable);
+		std::vector<VkPipelineStageFlags> pipelineWaitStages(1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		// Frame also waits for the uploads recorded since the previous one
+		addUploadWaitSemaphores(&renderBegSemaphores, &pipelineWaitStages);
+
+		VkSemaphore renderEndSemaphore[] = { frame.semaphoreRenderFinished };
 		
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = renderBegSemaphore;
-		submitInfo.pWaitDstStageMask = pipelineWaitStages;
+		submitInfo.waitSemaphoreCount = (uint32_t)renderBegSemaphores.size();
+		submitInfo.pWaitSemaphores = renderBegSemaphores.data();
+		submitInfo.pWaitDstStageMask = pipelineWaitStages.data();
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &m_vkCommandBuffers[imageIndexInSwapchain];
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = renderEndSemaphore;
 
-		if (vkQueueSubmit(m_vkLogicalDeviceData.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
-		{
-			// TODO: warning
-			printf("Failed to submit draw command buffer!\n");
-		}
+		submitFrame(&submitInfo, frame.fenceInFlight);
 
 		VkSwapchainKHR swapChains[] = { m_vkSwapchainData.vkHandle };
 
@@ -2039,6 +2955,10 @@ namespace vulkan
 		presentInfo.pImageIndices = &imageIndexInSwapchain;
 		presentInfo.pResults = nullptr;
 
+		// Frame is submitted, next frame could be prepared while this one is being processed
+		m_curFrameIdx = (m_curFrameIdx + 1) % (uint32_t)m_frames.size();
+		++m_numSubmittedFrames;
+
 		{
 			VkResult result = vkQueuePresentKHR(m_vkLogicalDeviceData.presentingQueue, &presentInfo);
 
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <vector>
+#include <deque>
+#include <string>
 #include <algorithm>
 
 #define NOMINMAX
@@ -8,10 +10,16 @@
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan\vulkan.h>
 
+#include "vulkan/memory_allocator.h"
+
 #include "math\vec2.h"
 #include "math\vec3.h"
 #include "math\vec4.h"
 
+#include "scene/camera.h"
+#include "scene/scene.h"
+#include "scene/bvh.h"
+
 namespace vulkan
 {
 	struct Vertex
@@ -21,9 +29,78 @@ namespace vulkan
 		math::Vec2 tc;
 	};
 
+	// Layout should match the std140 layout of the UBO declared in the shaders
 	struct UniformBufferObject
 	{
+		// See `scene::CameraRayGenParams`, w components are unused
+		math::Vec4 cameraOrigin;
+		math::Vec4 cameraLowerLeftCorner;
+		math::Vec4 cameraAxisX;
+		math::Vec4 cameraAxisY;
+		math::Vec4 cameraLensX;
+		math::Vec4 cameraLensY;
+		// Previous frame camera, see `Wrapper::m_isHistoryReprojected`
+		math::Vec4 prevCameraOrigin;
+		math::Vec4 prevCameraLowerLeftCorner;
+		math::Vec4 prevCameraAxisX;
+		math::Vec4 prevCameraAxisY;
+
 		float time;
+		// Number of frames already blended into the accumulation image, 0 means accumulation restart
+		uint32_t accumFrameCount;
+		uint32_t samplesPerFrame;
+		uint32_t renderWidth;
+		uint32_t renderHeight;
+		// Number of valid entries in the scene storage buffer
+		uint32_t numHitObjects;
+		// Number of valid entries in the materials storage buffer
+		uint32_t numMaterials;
+		uint32_t maxBounces;
+		uint32_t rrMinDepth;
+		// See `Wrapper::m_isAdaptiveSamplingEnabled`
+		uint32_t adaptiveSampling;
+		float adaptiveErrorThreshold;
+		uint32_t adaptiveMinSamples;
+		// See `Wrapper::m_randomSeed`
+		uint32_t randomSeed;
+		// See `Wrapper::m_accumStartFrame`
+		uint32_t accumStartFrame;
+		// Seeds the per-path random number generator, see `sampler.glsl`
+		uint32_t frameIdx;
+		// Swapchain extent, render extent is smaller with the dynamic resolution, see `Wrapper::m_renderExtent`
+		uint32_t displayWidth;
+		uint32_t displayHeight;
+		// See `Wrapper::m_isTemporalReprojectionEnabled`
+		uint32_t temporalReprojection;
+		uint32_t temporalMaxHistorySamples;
+	};
+
+	// Scene storage buffer element, layout should match `HitObject` (std430) in `pathtracer.glsl`
+	struct SceneHitObject
+	{
+		enum : int32_t
+		{
+			eTypeSphere = 1,
+		};
+
+		int32_t type;
+		int32_t materialIndex;
+		int32_t pad[2];
+		// Sphere: xyz - center, w - radius
+		math::Vec4 param0;
+		math::Vec4 param1;
+	};
+
+	// Materials storage buffer element, layout should match `Material` (std430) in `pathtracer.glsl`
+	struct SceneMaterial
+	{
+		// See `scene::MaterialType`
+		int32_t type;
+		float roughness;
+		float refIdx;
+		float pad;
+		// w is unused
+		math::Vec4 albedo;
 	};
 
 	class Wrapper
@@ -67,9 +144,12 @@ namespace vulkan
 
 			VkQueue graphicsQueue = VK_NULL_HANDLE;
 			VkQueue presentingQueue = VK_NULL_HANDLE;
+			// Dedicated transfer queue if the device has one, graphics queue otherwise
+			VkQueue transferQueue = VK_NULL_HANDLE;
 
 			uint32_t graphicsQueueFamilyIndex = 0xFFffFFff;
 			uint32_t presentingQueueFamilyIndex = 0xFFffFFff;
+			uint32_t transferQueueFamilyIndex = 0xFFffFFff;
 		};
 		VulkanLogicalDeviceData m_vkLogicalDeviceData;
 
@@ -89,6 +169,112 @@ namespace vulkan
 		VkPipelineLayout m_vkPipelineLayout = VK_NULL_HANDLE;
 		VkPipeline m_vkGraphicsPipeline = VK_NULL_HANDLE;
 
+		enum class TracerBackend
+		{
+			// Path tracing happens in the fragment shader applied to the fullscreen quad
+			eFragment,
+			// Path tracing happens in the compute shader writing into the accumulation storage image,
+			//	fullscreen quad only presents the result
+			eCompute,
+			// Path tracing is split into separate compute stages (generate, extend, shade, resolve) operating
+			//	on the queues of paths, fullscreen quad only presents the result; see `wavefront.cpp`
+			eWavefront,
+		};
+		TracerBackend m_tracerBackend = TracerBackend::eFragment;
+		// Should be called before `init`
+		void setTracerBackend(TracerBackend tracerBackend) { m_tracerBackend = tracerBackend; }
+		TracerBackend getTracerBackend() const { return m_tracerBackend; }
+
+		// Compute backend tunables, should be set before `init`
+		uint32_t m_computeWorkgroupSizeX = 8;
+		uint32_t m_computeWorkgroupSizeY = 8;
+		void setComputeWorkgroupSize(uint32_t sizeX, uint32_t sizeY)
+		{
+			m_computeWorkgroupSizeX = (sizeX > 0) ? sizeX : 1;
+			m_computeWorkgroupSizeY = (sizeY > 0) ? sizeY : 1;
+		}
+		// Image is traced in tiles of this size, one dispatch per tile; 0 means whole render target dimension
+		uint32_t m_computeTileSizeX = 0;
+		uint32_t m_computeTileSizeY = 0;
+		void setComputeTileSize(uint32_t sizeX, uint32_t sizeY)
+		{
+			m_computeTileSizeX = sizeX;
+			m_computeTileSizeY = sizeY;
+		}
+
+		// Should match the push constants block in `pathtracer.cs`
+		struct ComputeTilePushConstants
+		{
+			int32_t tileOffset[2];
+			int32_t tileSize[2];
+		};
+
+		VkPipelineLayout m_vkComputePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_vkComputePipeline = VK_NULL_HANDLE;
+		void initComputePipelineState();
+		void deinitComputePipelineState();
+
+		// Wavefront backend
+		static const uint32_t c_wavefrontWorkgroupSize = 64;
+		// Lambert, metal, glass; should match NUM_MATERIAL_QUEUES in `wavefront.glsl`
+		static const uint32_t c_numWavefrontMaterialQueues = 3;
+
+		// Should match the push constants block in `wavefront.glsl`
+		struct WavefrontPushConstants
+		{
+			uint32_t rayQueueIdx;
+			uint32_t sampleIdx;
+			uint32_t bounceIdx;
+			uint32_t controlPhase;
+		};
+		// Should match `CountersBuffer` in `wavefront.glsl`
+		struct WavefrontCounters
+		{
+			// Each dispatch arguments entry is padded to 16 bytes, as required by std430 uvec4
+			uint32_t extendDispatchArgs[4];
+			uint32_t shadeDispatchArgs[c_numWavefrontMaterialQueues][4];
+			uint32_t rayQueueCounts[2];
+			uint32_t materialQueueCounts[c_numWavefrontMaterialQueues];
+		};
+
+		enum WavefrontBufferIdx
+		{
+			eWavefrontBufferPathStates = 0,
+			eWavefrontBufferPathHits,
+			eWavefrontBufferRayQueues,
+			eWavefrontBufferMaterialQueues,
+			eWavefrontBufferCounters,
+			eWavefrontBufferRadiance,
+
+			eWavefrontBufferCount
+		};
+		// All wavefront buffers are sized for one path per pixel of the render target
+		VkBuffer m_vkWavefrontBuffers[eWavefrontBufferCount] = {};
+		MemoryAllocation m_vkWavefrontBuffersAllocations[eWavefrontBufferCount];
+		void initWavefrontBuffers();
+		void deinitWavefrontBuffers();
+
+		// Wavefront buffers are shared between the frames in flight, so they go into separate descriptor set layout;
+		//	each frame still has its own set (`FrameData::wavefrontDescriptorSet`), so that the buffers could be
+		//	replaced while the other frames are in flight
+		VkDescriptorSetLayout m_vkWavefrontDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool m_vkWavefrontDescriptorPool = VK_NULL_HANDLE;
+		void initWavefrontDescriptorSet();
+		void deinitWavefrontDescriptorSet();
+		void updateWavefrontDescriptorSet(uint32_t frameIdx);
+
+		VkPipelineLayout m_vkWavefrontPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_vkWavefrontGeneratePipeline = VK_NULL_HANDLE;
+		VkPipeline m_vkWavefrontExtendPipeline = VK_NULL_HANDLE;
+		VkPipeline m_vkWavefrontShadePipelines[c_numWavefrontMaterialQueues] = {};
+		VkPipeline m_vkWavefrontControlPipeline = VK_NULL_HANDLE;
+		VkPipeline m_vkWavefrontResolvePipeline = VK_NULL_HANDLE;
+		void initWavefrontPipelines();
+		void deinitWavefrontPipelines();
+
+		void initWavefront();
+		void deinitWavefront();
+
 		std::vector<const char *> m_requiredExtensionNamesList;
 		std::vector<VkExtensionProperties> m_supportedExtensionsProps;
 
@@ -140,31 +326,25 @@ namespace vulkan
 		void initSwapchain();
 		void deinitSwapchain();
 
-		void reinitSwapchain()
-		{
-			// At the moment, swapchain recreation requires full cease of rendering operations
-			//	while it is possible to change swapchain mid-rendering, by keeping old swapchain for a while,
-			//	and passing it to `VkSwapchainCreateInfoKHR` as well.
-			vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle);
-		
-			// Destroy everything swapchain-related
-			// TODO: see `destroyCommandBuffers()` to avoid needless command pool destruction in the future
-			deinitCommandPool();
-			deinitSwapchainFramebuffers();
-			deinitPipelineState();
-			deinitRenderPass();
-			deinitSwapchain();
-
-			initSwapchain();
-			initRenderPass();
-			// Theoretically we could avoid recreating the whole pipeline by using the pipeline dynamic states
-			initPipelineState();
-			initSwapchainFramebuffers();
-			// Theoretically, we could avoid command pool recreation by just removing all of the command lists
-			//	that are related to the swap chains. But for now we'll go with the sweeping clean approach.
-			initCommandPool();
-			buildCommandBuffers();
-		}
+		// Headless mode: there is no window surface, and rendering happens into the offscreen image
+		//	which is stored in place of the swapchain images
+		bool m_isHeadless = false;
+		bool getIsHeadless() const { return m_isHeadless; }
+
+		MemoryAllocation m_vkOffscreenImageAllocation;
+		void initOffscreenTarget();
+		void deinitOffscreenTarget();
+
+		// Reads back the offscreen image and saves it as PPM file, only valid in headless mode
+		bool saveOffscreenImage(const char * filename);
+
+		// Waits for all the submitted frames to finish
+		void waitIdle() { vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle); }
+
+		// Swapchain is recreated with the old one passed as `oldSwapchain`, without waiting for the device to idle:
+		//	frames in flight finish with the old swapchain images and the old extent-sized resources, which are
+		//	retired and destroyed once those frames are done, see `retired_resources.cpp`
+		void reinitSwapchain();
 
 		void onWindowResize(int width, int height)
 		{
@@ -185,55 +365,249 @@ namespace vulkan
 			return m_vkDebugCallback;
 		}
 
+		// Vertex shader, fragment shader (path tracer or blit, depending on the backend), and compute shader (if needed)
 		std::vector<VkShaderModule> m_vkShaderModules;
 		VkShaderModule initShaderModule(const std::vector<char> & shaderByteCode);
+		// Reads SPIR-V file and creates shader module from it, the module is not tracked in `m_vkShaderModules`
+		VkShaderModule loadShaderModule(const std::string & filename);
 		void deinitShaderModules();
 
 		void initRenderPass();
 		void deinitRenderPass();
 
 		static void getVertexInputDescriptions(VkVertexInputBindingDescription * bindingDescr, VkVertexInputAttributeDescription attribsDescr[], int numAttribs = 3);
-		static uint32_t Wrapper::findMemoryType(const VkPhysicalDevice & physDev, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 		void initPipelineState();
 		void deinitPipelineState();
 
+		// Every pipeline is created through this cache, which is loaded from the file on init and saved back on
+		//	deinit, see `pipeline_cache.cpp`; empty filename keeps the cache in memory only
+		std::string m_pipelineCacheFilename = "pipeline_cache.bin";
+		VkPipelineCache m_vkPipelineCache = VK_NULL_HANDLE;
+		// Whether the cache was initialized with the data from the file
+		bool m_isPipelineCacheLoaded = false;
+		void setPipelineCacheFilename(const char * filename) { m_pipelineCacheFilename = filename ? filename : ""; }
+		bool getIsPipelineCacheLoaded() const { return m_isPipelineCacheLoaded; }
+		void initPipelineCache();
+		void deinitPipelineCache();
+		bool savePipelineCache();
+
 		void initSwapchainFramebuffers();
 		void deinitSwapchainFramebuffers();
 
 		VkCommandPool m_vkCommandPool;
-		std::vector<VkCommandBuffer> m_vkCommandBuffers;
+
+		// Resources that are duplicated for each frame in flight, so that CPU could prepare
+		//	the next frame while GPU is still processing the previous ones
+		struct FrameData
+		{
+			VkSemaphore semaphoreImageAvailable = VK_NULL_HANDLE;
+			VkSemaphore semaphoreRenderFinished = VK_NULL_HANDLE;
+			VkFence fenceInFlight = VK_NULL_HANDLE;
+
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			// Only allocated for the wavefront backend
+			VkDescriptorSet wavefrontDescriptorSet = VK_NULL_HANDLE;
+			// Resources referenced by the descriptor sets were replaced while the slot was in flight,
+			//	sets are rewritten right before the slot records its next frame
+			bool areDescriptorSetsDirty = false;
+
+			// Bit per `GpuTimer` written by the frame that occupies the slot, see `beginGpuTimersFrame`
+			uint32_t gpuTimersMask = 0;
+			uint64_t gpuTimersFrameNumber = 0;
+		};
+		std::vector<FrameData> m_frames;
+
+		uint32_t m_numFramesInFlight = 2;
+		uint32_t m_curFrameIdx = 0;
+		// Frames submitted since `init`, frame N always occupies slot N % m_frames.size()
+		uint64_t m_numSubmittedFrames = 0;
+
+		// Resources replaced while the frames in flight could still reference them, see `retired_resources.cpp`
+		struct RetiredResources
+		{
+			// Only the frames submitted before this one could reference the resources
+			uint64_t frameNumber = 0;
+			std::vector<VkSwapchainKHR> swapchains;
+			std::vector<VkFramebuffer> framebuffers;
+			std::vector<VkImageView> imageViews;
+			std::vector<VkImage> images;
+			std::vector<VkBuffer> buffers;
+			std::vector<MemoryAllocation> allocations;
+		};
+		std::vector<RetiredResources> m_retiredResources;
+		RetiredResources & getRetiredResources();
+		void retireImage(VkImage image, VkImageView imageView, const MemoryAllocation & imageAllocation);
+		void retireBuffer(VkBuffer buffer, const MemoryAllocation & bufferAllocation);
+		// Destroys resources that none of the submitted frames could reference anymore, should be called
+		//	after the current frame slot is waited on; `releaseAll` requires the device to be idle
+		void releaseRetiredResources(bool releaseAll);
+
+		// Initialization of the storage images and buffers is always recorded into the next frame command buffer,
+		//	since the separate submission would have to wait for the frames in flight
+		std::vector<VkImage> m_pendingStorageImageTransitions;
+		std::vector<VkBuffer> m_pendingBufferClears;
+		// Transitions storage image from the undefined into the general layout, which it keeps for its lifetime
+		void initStorageImageLayout(VkImage image, VkFormat format);
+		// Fills the buffer with zeroes
+		void initBufferContents(VkBuffer buffer);
+		void recordPendingResourceInits(VkCommandBuffer commandBuffer);
+
+		// Uploads are recorded into the batch command buffer, which is submitted to the transfer queue along
+		//	with the next frame, and the frame waits on the batch semaphore; see `uploads.cpp`
+		struct UploadBatch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			// Number of the frame that waits on the semaphore, the batch is reused once that frame is done
+			uint64_t waitFrameNumber = 0;
+			bool isWaited = false;
+			std::vector<VkBuffer> stagingBuffers;
+			std::vector<MemoryAllocation> stagingAllocations;
+		};
+		VkCommandPool m_vkUploadCommandPool = VK_NULL_HANDLE;
+		bool m_isUploadBatchOpen = false;
+		UploadBatch m_openUploadBatch;
+		std::deque<UploadBatch> m_submittedUploadBatches;
+		std::vector<UploadBatch> m_freeUploadBatches;
+		void initUploads();
+		void deinitUploads();
+		UploadBatch & getOpenUploadBatch();
+		// Copies data into the device-local buffer via staging buffer, the copy is complete by the time the next
+		//	frame starts executing; buffer shouldn't be in use by the frames in flight
+		void uploadBufferData(VkBuffer dstBuffer, const void * data, size_t dataSize);
+		// Fills the whole image (single mip level) and transitions it into the VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		void uploadImageData(VkImage image, uint32_t width, uint32_t height, const void * data, size_t dataSize);
+		// Submits the open batch (if any), should be called before the resources it writes into are destroyed
+		void submitUploads();
+		// Submits the open batch, and adds semaphores of the batches that no frame waits on yet into the wait list
+		//	of the frame that is about to be submitted
+		void addUploadWaitSemaphores(std::vector<VkSemaphore> * waitSemaphores, std::vector<VkPipelineStageFlags> * waitStages);
+		// Same conditions as `releaseRetiredResources`
+		void releaseCompletedUploads(bool releaseAll);
+
+		// Should be called before `init`
+		void setNumFramesInFlight(uint32_t numFramesInFlight)
+		{
+			m_numFramesInFlight = (numFramesInFlight > 0) ? numFramesInFlight : 1;
+		}
+		uint32_t getNumFramesInFlight() const { return m_numFramesInFlight; }
 
 		void initCommandPool();
 		void deinitCommandPool();
 
+		// GPU timestamps around the passes of the frame command buffer, see `gpu_timers.cpp`
+		enum GpuTimer
+		{
+			// Whole frame command buffer
+			eGpuTimerFrame = 0,
+			// Compute or wavefront path tracing, recorded before the render pass
+			eGpuTimerTracing,
+			// Temporal reprojection pass, only recorded in the frames with the camera motion
+			eGpuTimerTemporal,
+			// Fullscreen quad pass: path tracing itself in the fragment backend, otherwise presentation
+			eGpuTimerRenderPass,
+			eGpuTimerAdaptiveMask,
+
+			eGpuTimerCount
+		};
+		static const char * getGpuTimerName(GpuTimer timer);
+
+		struct GpuFrameTimings
+		{
+			// Counts frames recorded since `init`
+			uint64_t frameNumber;
+			// Negative for the timers that weren't recorded in the frame, e.g. tracing in the fragment backend
+			double timesMS[eGpuTimerCount];
+		};
+
+		// Requires non-zero `timestampValidBits` on the graphics queue family, timers are no-op otherwise
+		bool m_isGpuTimingSupported = false;
+		double m_gpuTimestampPeriodNS = 1.0;
+		uint64_t m_gpuTimestampMask = ~0ull;
+		// Pair of queries per timer per frame in flight
+		VkQueryPool m_vkTimestampQueryPool = VK_NULL_HANDLE;
+		uint64_t m_numRecordedFrames = 0;
+		// Timings read back but not yet fetched with `popGpuFrameTimings`, oldest are dropped at the cap
+		std::deque<GpuFrameTimings> m_gpuFrameTimings;
+		void initGpuTimers();
+		void deinitGpuTimers();
+		bool getIsGpuTimingSupported() const { return m_isGpuTimingSupported; }
+
+		// Should be recorded first into the frame command buffer: reads back the timings that the frame slot
+		//	recorded the previous time (the slot fence is already waited on, so this never stalls), and resets its queries
+		void beginGpuTimersFrame(VkCommandBuffer commandBuffer, uint32_t frameIdx);
+		void beginGpuTimer(VkCommandBuffer commandBuffer, uint32_t frameIdx, GpuTimer timer);
+		void endGpuTimer(VkCommandBuffer commandBuffer, uint32_t frameIdx, GpuTimer timer);
+		void collectGpuTimers(uint32_t frameIdx);
+
+		// Moves timings of the frames read back since the previous call into `frameTimings`, oldest first;
+		//	frames are only read back once their slot is reused, i.e. `m_numFramesInFlight` frames late
+		void popGpuFrameTimings(std::vector<GpuFrameTimings> * frameTimings);
+		// Waits for the device to finish all the frames in flight, and reads back their timings
+		void flushGpuTimers();
+
+		// Dynamic resolution: compute-based backends trace into the render extent, which is scaled to keep the GPU
+		//	frame time around the target, and the presentation pass upscales it; see `dynamic_resolution.cpp`
+		bool m_isDynamicResolutionEnabled = false;
+		double m_dynamicResolutionTargetMS = 1000.0 / 60.0;
+		// Render extent never goes below this fraction of the swapchain extent, per dimension
+		float m_dynamicResolutionMinScale = 0.25f;
+		float m_renderScale = 1.0f;
+		// Top-left part of the accumulation image (and the rest of the swapchain-sized images) that is traced
+		VkExtent2D m_renderExtent = { 0, 0 };
+		// Frames recorded before this one had a different render extent, their timings are skipped
+		uint64_t m_dynamicResolutionFirstFrame = 0;
+		double m_dynamicResolutionSumMS = 0.0;
+		uint32_t m_dynamicResolutionNumFrames = 0;
+		// Only supported by the compute-based backends, fragment backend traces directly into the swapchain image
+		void setDynamicResolution(bool isEnabled, double targetMS)
+		{
+			m_isDynamicResolutionEnabled = isEnabled;
+			m_dynamicResolutionTargetMS = targetMS;
+		}
+		bool getDynamicResolution() const { return m_isDynamicResolutionEnabled; }
+		VkExtent2D getRenderExtent() const { return m_renderExtent; }
+		// Recomputes the render extent from the current scale, returns true if it changed
+		bool updateRenderExtent();
+		// Called for every frame timings read back, see `collectGpuTimers`
+		void addDynamicResolutionTimings(const GpuFrameTimings & frameTimings);
+		// Adjusts the render scale, should be called before the frame UBO is filled
+		void updateDynamicResolution();
+
 		int m_vkTriangleVerticesCount = -1;
 		VkBuffer m_vkTriangleVertexBuffer;
-		VkDeviceMemory m_vkTriangleVertexBufferDeviceMemory;
+		MemoryAllocation m_vkTriangleVertexBufferAllocation;
 
 		int m_vkTriangleIndicesCount = -1;
 		VkIndexType m_vkTriangleIndexBufferType;
 		VkBuffer m_vkTriangleIndexBuffer;
-		VkDeviceMemory m_vkTriangleIndexBufferDeviceMemory;
+		MemoryAllocation m_vkTriangleIndexBufferAllocation;
 
 		VkCommandPool getTransientCommandPool();
+		// Transient command buffers are only used for the readbacks: the submission to the graphics queue
+		//	is waited on with its own fence, which also covers all the frames submitted before it
 		VkCommandBuffer beginTransientCommandBuffer();
 		void endTransientCommandBuffer(const VkCommandBuffer & transientCommandBuffer);
 
-		static void createBuffer(
-						const VkPhysicalDevice & physDev,
-						const VkDevice & logicDev,
+		// All the device memory is sub-allocated from the larger blocks, see `memory_allocator.h`
+		MemoryAllocator m_memoryAllocator;
+		void getMemoryStats(MemoryAllocatorStats * stats) const { m_memoryAllocator.getStats(stats); }
+
+		void createBuffer(
 						VkDeviceSize size,
 						VkBufferUsageFlags usage,
 						VkMemoryPropertyFlags memoryProperties,
 						VkBuffer * buffer,
-						VkDeviceMemory * bufferDeviceMemory
+						MemoryAllocation * bufferAllocation
 						);
-		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		// Host visible transfer source/destination from the staging ring, should be destroyed as soon as
+		//	the transfer is complete
+		void createStagingBuffer(VkDeviceSize size, VkBuffer * buffer, MemoryAllocation * bufferAllocation);
 
-		static void createImage(
-						const VkPhysicalDevice & physDev,
-						const VkDevice & logicDev,
+		void createImage(
 						uint32_t width,
 						uint32_t height,
 						VkFormat format,
@@ -241,15 +615,15 @@ namespace vulkan
 						VkImageUsageFlags usage,
 						VkMemoryPropertyFlags memoryProperties,
 						VkImage * image,
-						VkDeviceMemory * imageDeviceMemory
+						MemoryAllocation * imageAllocation
 						);
-		void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldImageLayout, VkImageLayout newImageLayout);
-		// Image layout should be transitioned to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-		void copyBufferToImage(uint32_t width, uint32_t height, VkBuffer buffer, VkImage image);
+		// Image layout should be transitioned to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+		void copyImageToBuffer(uint32_t width, uint32_t height, VkImage image, VkBuffer buffer);
 
+		// Blue noise texture of the sampler, see `sampler.glsl`
 		VkFormat m_vkTextureImageFormat;
 		VkImage m_vkTextureImage;
-		VkDeviceMemory m_vkTextureImageDeviceMemory;
+		MemoryAllocation m_vkTextureImageAllocation;
 		void initTextureImage();
 		void deinitTextureImage();
 
@@ -267,52 +641,342 @@ namespace vulkan
 		void initTextureSampler();
 		void deinitTextureSampler();
 
+		// Progressive accumulation of the path traced samples across frames, has the size of the render target
+		VkFormat m_vkAccumImageFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkImage m_vkAccumImage = VK_NULL_HANDLE;
+		MemoryAllocation m_vkAccumImageAllocation;
+		VkImageView m_vkAccumImageView = VK_NULL_HANDLE;
+		void initAccumImage();
+		void deinitAccumImage();
+
+		// Only advanced once the frame is submitted (see `submitFrame`), frames dropped after the `update`
+		//	(e.g. failed acquire) don't write the accumulation, and the next one should not blend with it
+		uint32_t m_accumFrameCount = 0;
+		// Frame that restarted the accumulation, sampler sequences continue across the accumulated frames
+		//	and are reseeded on restart, see `sampler.glsl`
+		uint32_t m_accumStartFrame = 0;
+		void resetAccumulation()
+		{
+			m_accumFrameCount = 0;
+			m_accumStartFrame = (uint32_t)m_numSubmittedFrames;
+		}
+		uint32_t getAccumFrameCount() const { return m_accumFrameCount; }
+
+		uint32_t m_samplesPerFrame = 32;
+		void setSamplesPerFrame(uint32_t samplesPerFrame)
+		{
+			if (m_samplesPerFrame != samplesPerFrame)
+			{
+				m_samplesPerFrame = samplesPerFrame;
+				resetAccumulation();
+			}
+		}
+		uint32_t getSamplesPerFrame() const { return m_samplesPerFrame; }
+
+		// Maximum number of ray casts per path
+		uint32_t m_maxBounces = 16;
+		void setMaxBounces(uint32_t maxBounces)
+		{
+			if (m_maxBounces != maxBounces)
+			{
+				m_maxBounces = maxBounces;
+				resetAccumulation();
+			}
+		}
+		uint32_t getMaxBounces() const { return m_maxBounces; }
+
+		// Russian roulette terminates paths based on their throughput, but only after this amount of scatters;
+		//	values greater or equal to `m_maxBounces` effectively disable it
+		uint32_t m_russianRouletteMinDepth = 3;
+		void setRussianRouletteMinDepth(uint32_t minDepth)
+		{
+			if (m_russianRouletteMinDepth != minDepth)
+			{
+				m_russianRouletteMinDepth = minDepth;
+				resetAccumulation();
+			}
+		}
+		uint32_t getRussianRouletteMinDepth() const { return m_russianRouletteMinDepth; }
+
+		// Adaptive sampling: luminance moments are accumulated per pixel alongside the color, and the mask pass
+		//	allocates the samples of the next frame only to the pixels with the error estimate above the threshold;
+		//	see `adaptive_sampling.cpp`
+		bool m_isAdaptiveSamplingEnabled = false;
+		void setAdaptiveSampling(bool isEnabled)
+		{
+			if (m_isAdaptiveSamplingEnabled != isEnabled)
+			{
+				m_isAdaptiveSamplingEnabled = isEnabled;
+				// Sample count mask is not maintained while adaptive sampling is disabled
+				resetAccumulation();
+			}
+		}
+		bool getAdaptiveSampling() const { return m_isAdaptiveSamplingEnabled; }
+
+		// Relative standard error of the pixel mean luminance, below which the pixel is considered converged
+		float m_adaptiveErrorThreshold = 0.01f;
+		void setAdaptiveErrorThreshold(float threshold) { m_adaptiveErrorThreshold = threshold; }
+		float getAdaptiveErrorThreshold() const { return m_adaptiveErrorThreshold; }
+
+		// Error estimate is not trusted until the pixel accumulates this amount of samples
+		uint32_t m_adaptiveMinSamples = 128;
+		void setAdaptiveMinSamples(uint32_t minSamples) { m_adaptiveMinSamples = minSamples; }
+		uint32_t getAdaptiveMinSamples() const { return m_adaptiveMinSamples; }
+
+		// Offsets the per-frame random shift and seeds the sampler, so that the runs with the same seed
+		//	and the same frame times render the same images
+		uint32_t m_randomSeed = 0;
+		void setRandomSeed(uint32_t seed)
+		{
+			if (m_randomSeed != seed)
+			{
+				m_randomSeed = seed;
+				resetAccumulation();
+			}
+		}
+		uint32_t getRandomSeed() const { return m_randomSeed; }
+
+		// Same size as the accumulation image
+		VkFormat m_vkMomentsImageFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkImage m_vkMomentsImage = VK_NULL_HANDLE;
+		MemoryAllocation m_vkMomentsImageAllocation;
+		VkImageView m_vkMomentsImageView = VK_NULL_HANDLE;
+		VkFormat m_vkSampleCountImageFormat = VK_FORMAT_R32_UINT;
+		VkImage m_vkSampleCountImage = VK_NULL_HANDLE;
+		MemoryAllocation m_vkSampleCountImageAllocation;
+		VkImageView m_vkSampleCountImageView = VK_NULL_HANDLE;
+		void initAdaptiveSamplingImages();
+		void deinitAdaptiveSamplingImages();
+
+		VkPipelineLayout m_vkAdaptiveMaskPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_vkAdaptiveMaskPipeline = VK_NULL_HANDLE;
+		void initAdaptiveMaskPipeline();
+		void deinitAdaptiveMaskPipeline();
+
+		// Total amount of samples traced over all pixels since the last accumulation restart,
+		//	waits for the frames in flight to finish
+		uint64_t countAccumulatedSamples();
+
+		// Temporal reprojection: camera motion restarts the accumulation, but instead of starting from scratch,
+		//	the previous accumulation is reprojected using the first hit surfaces of both frames and blended
+		//	with the new samples; compute-based backends only, see `temporal_reprojection.cpp`
+		//	images are allocated along with the swapchain, so the reprojection should be enabled before `init`
+		bool m_isTemporalReprojectionEnabled = false;
+		void setTemporalReprojection(bool isEnabled)
+		{
+			if (m_isTemporalReprojectionEnabled != isEnabled)
+			{
+				m_isTemporalReprojectionEnabled = isEnabled;
+				// Surfaces are not maintained while the reprojection is disabled
+				resetAccumulation();
+			}
+		}
+		bool getTemporalReprojection() const { return m_isTemporalReprojectionEnabled; }
+		bool isTemporalReprojectionActive() const
+		{
+			return m_isTemporalReprojectionEnabled && m_areTemporalImagesAllocated && (m_tracerBackend != TracerBackend::eFragment);
+		}
+
+		// Reprojected history is capped at this amount of frames worth of samples, limits the ghosting
+		uint32_t m_temporalMaxHistoryFrames = 16;
+		void setTemporalMaxHistoryFrames(uint32_t maxHistoryFrames) { m_temporalMaxHistoryFrames = maxHistoryFrames; }
+		uint32_t getTemporalMaxHistoryFrames() const { return m_temporalMaxHistoryFrames; }
+
+		// Set by `updateCamera` for the frames that reproject the history
+		bool m_isHistoryReprojected = false;
+		// Camera of the frame prepared by `update`, becomes the previous one once the frame is submitted
+		scene::CameraRayGenParams m_cameraRayGenParams = {};
+		scene::CameraRayGenParams m_prevCameraRayGenParams = {};
+
+		// Previous accumulation copy, and the pair of first hit surface images alternating between the frames;
+		//	same size as the accumulation image if the reprojection is enabled, 1x1 placeholders otherwise
+		bool m_areTemporalImagesAllocated = false;
+		VkImage m_vkHistoryImage = VK_NULL_HANDLE;
+		MemoryAllocation m_vkHistoryImageAllocation;
+		VkImageView m_vkHistoryImageView = VK_NULL_HANDLE;
+		VkFormat m_vkSurfaceImageFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkImage m_vkSurfaceImages[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		MemoryAllocation m_vkSurfaceImagesAllocations[2];
+		VkImageView m_vkSurfaceImageViews[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		void initTemporalImages();
+		void deinitTemporalImages();
+
+		VkPipelineLayout m_vkTemporalPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_vkTemporalPipeline = VK_NULL_HANDLE;
+		void initTemporalPipeline();
+		void deinitTemporalPipeline();
+
 		void initFSQuadBuffers();
 		void deinitFSQuadBuffers();
 
+		// Device-local storage buffer that is rewritten while the frames in flight could still read it: each upload
+		//	goes into the copy that none of them is bound to, and the descriptor set of each frame slot switches
+		//	to the new copy once the slot is free
+		struct DoubleBufferedStorage
+		{
+			VkBuffer vkBuffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+			MemoryAllocation allocations[2];
+			uint32_t capacities[2] = { 0, 0 };
+			// Only the frames submitted before this one could read the copy
+			uint64_t unboundFrameNumbers[2] = { 0, 0 };
+			uint32_t curCopyIdx = 0;
+
+			VkBuffer getCurBuffer() const { return vkBuffers[curCopyIdx]; }
+		};
+		void initDoubleBufferedStorageCopy(DoubleBufferedStorage * storage, uint32_t copyIdx, size_t elementSize, uint32_t capacity);
+		void initDoubleBufferedStorage(DoubleBufferedStorage * storage, size_t elementSize, uint32_t capacity);
+		void deinitDoubleBufferedStorage(DoubleBufferedStorage * storage);
+		// Makes the copy that no frame in flight reads current and returns it, the copy is retired and recreated
+		//	if it is still in use or can't fit `numElements`
+		VkBuffer flipDoubleBufferedStorage(DoubleBufferedStorage * storage, size_t elementSize, uint32_t numElements);
+
+		// Scene is uploaded into the device-local storage buffer, which is only updated when scene changes
+		//	hit objects are reordered to match the BVH leaves
+		scene::Scene m_scene;
+		bool m_isSceneDirty = true;
+		uint32_t m_numSceneHitObjects = 0;
+		DoubleBufferedStorage m_sceneBuffers;
+		void initSceneBuffer(uint32_t capacity);
+		void deinitSceneBuffer();
+
+		scene::BVHBuildParams m_bvhBuildParams;
+		uint32_t m_numBVHNodes = 0;
+		DoubleBufferedStorage m_bvhBuffers;
+		void initBVHBuffer(uint32_t capacity);
+		void deinitBVHBuffer();
+		void setBVHBuildParams(const scene::BVHBuildParams & bvhBuildParams)
+		{
+			m_bvhBuildParams = bvhBuildParams;
+			m_isSceneDirty = true;
+		}
+		// Writes into the copies of the scene and BVH buffers that the frames in flight don't read, no waiting involved
+		void uploadScene();
+
+		// Materials are uploaded separately from the geometry, so that modifying them doesn't trigger BVH rebuild
+		bool m_isMaterialsDirty = true;
+		uint32_t m_numSceneMaterials = 0;
+		DoubleBufferedStorage m_materialsBuffers;
+		void initMaterialsBuffer(uint32_t capacity);
+		void deinitMaterialsBuffer();
+		// Same as `uploadScene`
+		void uploadMaterials();
+
+		// Scene changes take effect on the next `update` and restart the accumulation
+		void setScene(const scene::Scene & newScene)
+		{
+			m_scene = newScene;
+			m_isSceneDirty = true;
+			m_isMaterialsDirty = true;
+		}
+		void clearScene()
+		{
+			m_scene.clear();
+			m_isSceneDirty = true;
+			m_isMaterialsDirty = true;
+		}
+		void addSphere(const math::Vec3 & center, float radius, int materialIndex)
+		{
+			m_scene.addSphere(center, radius, materialIndex);
+			m_isSceneDirty = true;
+		}
+		int addMaterial(scene::MaterialType type, const math::Vec3 & albedo, float roughness = 0.0f, float refIdx = 1.5f)
+		{
+			m_isMaterialsDirty = true;
+			return m_scene.addMaterial(type, albedo, roughness, refIdx);
+		}
+		void setMaterial(int materialIndex, const scene::Material & material)
+		{
+			if (materialIndex < 0 || materialIndex >= (int)m_scene.materials.size())
+			{
+				// TODO: warning
+				printf("Wrong material index %d supplied for setMaterial!\n", materialIndex);
+				return;
+			}
+			m_scene.materials[materialIndex] = material;
+			m_isMaterialsDirty = true;
+		}
+		const scene::Scene & getScene() const { return m_scene; }
+
 		VkDescriptorSetLayout m_vkUBODescriptorSetLayout;
 		void initDescriptorSetLayout();
 		void deinitDescriptorSetLayout();
 
-		VkBuffer m_vkUBOBuffer;
-		VkDeviceMemory m_vkUBOBufferDeviceMemory;
+		// Single persistently mapped buffer, split into the slot per frame in flight; the slot is selected
+		//	by the dynamic offset when the descriptor set is bound, see `getUBODynamicOffset`
+		VkBuffer m_vkUBOBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_vkUBOBufferAllocation;
+		// `sizeof(UniformBufferObject)` rounded up to `minUniformBufferOffsetAlignment`
+		VkDeviceSize m_uboSlotSize = 0;
 		void initUBO();
 		void deinitUBO();
+		uint32_t getUBODynamicOffset(uint32_t frameIdx) const { return (uint32_t)(frameIdx * m_uboSlotSize); }
 
 		VkDescriptorPool m_vkDescriptorPool;
 		void initDescriptorPool();
 		void deinitDescriptorPool();
 
-		VkDescriptorSet m_vkDescriptorSet;
 		void initDescriptorSet();
 		void deinitDescriptorSet();
+		// Writes resources into the descriptor sets of all frames in flight
+		void updateDescriptorSets();
+		void updateFrameDescriptorSet(uint32_t frameIdx);
 
 		void buildCommandBuffers();
 		void destroyCommandBuffers();
+		void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndexInSwapchain, uint32_t frameIdx);
+		void recordComputeTracing(VkCommandBuffer commandBuffer, uint32_t frameIdx);
+		void recordWavefrontTracing(VkCommandBuffer commandBuffer, uint32_t frameIdx);
+		void recordAdaptiveMask(VkCommandBuffer commandBuffer, uint32_t frameIdx);
+		// Copies the previous accumulation into the history image, should be recorded before the tracing
+		void recordTemporalHistoryCopy(VkCommandBuffer commandBuffer);
+		void recordTemporalReprojection(VkCommandBuffer commandBuffer, uint32_t frameIdx);
+
+		void initSyncPrimitives();
+		void deinitSyncPrimitives();
 
-		void initSemaphores();
-		void deinitSemaphores();
+		// Blocks until GPU finishes processing the frame that previously occupied current frame slot
+		void waitForCurrentFrameSlot();
 
 		HWND m_hWnd;
 		void init(HWND hWnd, int width, int height);
+		void initHeadless(int width, int height);
 		void deinit();
 
 		bool m_isExitting = false;
 		void setIsExitting(bool isExitting) { m_isExitting = isExitting; }
 		bool getIsExitting() const { return m_isExitting; }
 
-		VkSemaphore m_vkSemaphoreImageAvailable;
-		VkSemaphore m_vkSemaphoreRenderFinished;
-
 		double m_elapsedTimeMS = 0.0;
+
+		scene::Camera m_camera;
+		scene::Camera m_prevCamera;
+		// Camera orbits around the scene when animated, any camera movement restarts the accumulation
+		bool m_isCameraAnimated = true;
+		double m_cameraTimeMS = 0.0;
+		void setIsCameraAnimated(bool isCameraAnimated) { m_isCameraAnimated = isCameraAnimated; }
+		bool getIsCameraAnimated() const { return m_isCameraAnimated; }
+		void updateCamera(double dtMS);
+
 		void update(double dtMS);
+		// Resets the frame fence and submits the frame, fence is signaled even if the submission fails;
+		//	advances the accumulation if the frame is actually submitted
+		void submitFrame(VkSubmitInfo * submitInfo, VkFence fenceInFlight);
 		void render();
+		void renderOffscreen();
 
 		static const int titleBufSize = 256;
 		char title[titleBufSize];
-		void setDTime(double dtimeMS)
+		// GPU frame time is only shown if it is non-negative, see `GpuFrameTimings`
+		void setDTime(double dtimeMS, double gpuTimeMS = -1.0)
 		{
-			sprintf_s(title, titleBufSize, "Test: %.1f (%.3f ms)", 1000.0 / dtimeMS, dtimeMS);
+			if (gpuTimeMS >= 0.0)
+			{
+				sprintf_s(title, titleBufSize, "Test: %.1f (%.3f ms, GPU %.3f ms)", 1000.0 / dtimeMS, dtimeMS, gpuTimeMS);
+			}
+			else
+			{
+				sprintf_s(title, titleBufSize, "Test: %.1f (%.3f ms)", 1000.0 / dtimeMS, dtimeMS);
+			}
 			SetWindowTextA(m_hWnd, title);
 		}
 	};
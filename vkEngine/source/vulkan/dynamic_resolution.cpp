@@ -0,0 +1,93 @@
+#include <math.h>
+#include <algorithm>
+
+#include "vulkan/basic.h"
+
+// Dynamic resolution
+//	swapchain-sized images (accumulation, adaptive sampling, wavefront path buffers) are allocated for the full
+//	swapchain extent, and the compute-based backends only trace their top-left part of the render extent size;
+//	presentation pass stretches that part over the swapchain with the bilinear filter, see `blit.fs`.
+//	Tracing cost is roughly proportional to the amount of pixels, so the controller corrects the scale (applied
+//	to both dimensions) by the square root of the ratio between the target and the measured GPU frame time.
+//	Timings arrive `m_numFramesInFlight` frames late, so after each change the frames that were recorded with
+//	the previous extent are skipped; every change restarts the accumulation, so small deviations are ignored
+
+namespace vulkan
+{
+	// Render extent dimensions are multiples of this, keeps the amount of distinct extents (and restarts) low
+	static const uint32_t c_renderExtentGranularity = 8;
+	// Measured frame time is averaged over this amount of frames before each decision
+	static const uint32_t c_numDynamicResolutionFrames = 4;
+	// Frame time within this relative deviation from the target keeps the current scale
+	static const double c_dynamicResolutionDeadBand = 0.1;
+	// Scale changes per decision are limited, growing slower than shrinking to avoid overshooting the budget
+	static const double c_maxRenderScaleDecrease = 0.5;
+	static const double c_maxRenderScaleIncrease = 1.25;
+
+	bool Wrapper::updateRenderExtent()
+	{
+		const VkExtent2D swapchainExtent = m_vkSwapchainData.extent;
+		if (!m_isDynamicResolutionEnabled || m_tracerBackend == TracerBackend::eFragment)
+		{
+			m_renderScale = 1.0f;
+		}
+
+		auto scaleDimension = [this](uint32_t size) -> uint32_t
+		{
+			if (m_renderScale >= 1.0f)
+				return size;
+
+			uint32_t scaledSize = (uint32_t)(size * m_renderScale + 0.5f * c_renderExtentGranularity);
+			scaledSize -= scaledSize % c_renderExtentGranularity;
+			return std::min(std::max(scaledSize, c_renderExtentGranularity), size);
+		};
+
+		VkExtent2D renderExtent;
+		renderExtent.width = scaleDimension(swapchainExtent.width);
+		renderExtent.height = scaleDimension(swapchainExtent.height);
+
+		const bool isChanged = (renderExtent.width != m_renderExtent.width || renderExtent.height != m_renderExtent.height);
+		m_renderExtent = renderExtent;
+		return isChanged;
+	}
+
+	void Wrapper::addDynamicResolutionTimings(const GpuFrameTimings & frameTimings)
+	{
+		if (!m_isDynamicResolutionEnabled || frameTimings.frameNumber < m_dynamicResolutionFirstFrame)
+			return;
+
+		const double frameTimeMS = frameTimings.timesMS[eGpuTimerFrame];
+		if (frameTimeMS <= 0.0)
+			return;
+
+		m_dynamicResolutionSumMS += frameTimeMS;
+		++m_dynamicResolutionNumFrames;
+	}
+
+	void Wrapper::updateDynamicResolution()
+	{
+		if (!m_isDynamicResolutionEnabled || m_tracerBackend == TracerBackend::eFragment)
+			return;
+
+		if (m_dynamicResolutionNumFrames < c_numDynamicResolutionFrames)
+			return;
+
+		const double frameTimeMS = m_dynamicResolutionSumMS / m_dynamicResolutionNumFrames;
+		m_dynamicResolutionSumMS = 0.0;
+		m_dynamicResolutionNumFrames = 0;
+
+		const double timeRatio = m_dynamicResolutionTargetMS / frameTimeMS;
+		if (fabs(timeRatio - 1.0) < c_dynamicResolutionDeadBand)
+			return;
+
+		const double scaleFactor = std::min(std::max(sqrt(timeRatio), c_maxRenderScaleDecrease), c_maxRenderScaleIncrease);
+		m_renderScale = std::min(std::max((float)(m_renderScale * scaleFactor), m_dynamicResolutionMinScale), 1.0f);
+
+		if (updateRenderExtent())
+		{
+			// Frame about to be recorded is the first one with the new extent
+			m_dynamicResolutionFirstFrame = m_numRecordedFrames;
+			resetAccumulation();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "vulkan/basic.h"
+
+// GPU timers
+//	each frame in flight owns a pair of timestamp queries per timer; the queries are reset at the beginning
+//	of the frame command buffer, and read back right before that, when the slot is reused by the next frame.
+//	At that point the slot fence is signaled, so results are available without waiting, at the cost of
+//	timings arriving `m_numFramesInFlight` frames late
+
+namespace vulkan
+{
+	// Timings that nobody fetches are dropped after this amount of frames
+	static const size_t c_maxPendingGpuFrameTimings = 1024;
+
+	// static
+	const char * Wrapper::getGpuTimerName(GpuTimer timer)
+	{
+		switch (timer)
+		{
+			case eGpuTimerFrame: return "frame";
+			case eGpuTimerTracing: return "tracing";
+			case eGpuTimerTemporal: return "temporal";
+			case eGpuTimerRenderPass: return "render_pass";
+			case eGpuTimerAdaptiveMask: return "adaptive_mask";
+			default: return "unknown";
+		}
+	}
+
+	void Wrapper::initGpuTimers()
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(m_vkPhysicalDeviceData.vkHandle, &deviceProperties);
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDeviceData.vkHandle, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDeviceData.vkHandle, &queueFamilyCount, queueFamilies.data());
+
+		const uint32_t graphicsQueueFamilyIndex = m_vkLogicalDeviceData.graphicsQueueFamilyIndex;
+		const uint32_t timestampValidBits = (graphicsQueueFamilyIndex < queueFamilyCount) ? queueFamilies[graphicsQueueFamilyIndex].timestampValidBits : 0;
+
+		m_isGpuTimingSupported = (timestampValidBits > 0);
+		m_gpuTimestampPeriodNS = (double)deviceProperties.limits.timestampPeriod;
+		m_gpuTimestampMask = (timestampValidBits >= 64) ? ~0ull : ((1ull << timestampValidBits) - 1);
+		m_numRecordedFrames = 0;
+		m_gpuFrameTimings.resize(0);
+
+		if (!m_isGpuTimingSupported)
+		{
+			printf("Graphics queue doesn't support timestamps, GPU timers are disabled\n");
+			return;
+		}
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = (uint32_t)m_frames.size() * eGpuTimerCount * 2;
+
+		if (vkCreateQueryPool(m_vkLogicalDeviceData.vkHandle, &queryPoolCreateInfo, nullptr, &m_vkTimestampQueryPool) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create timestamp query pool!\n");
+			m_isGpuTimingSupported = false;
+		}
+
+		for (FrameData & frame : m_frames)
+		{
+			frame.gpuTimersMask = 0;
+		}
+	}
+	void Wrapper::deinitGpuTimers()
+	{
+		if (m_vkTimestampQueryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(m_vkLogicalDeviceData.vkHandle, m_vkTimestampQueryPool, nullptr);
+			m_vkTimestampQueryPool = VK_NULL_HANDLE;
+		}
+		m_isGpuTimingSupported = false;
+	}
+
+	void Wrapper::beginGpuTimersFrame(VkCommandBuffer commandBuffer, uint32_t frameIdx)
+	{
+		FrameData & frame = m_frames[frameIdx];
+		frame.gpuTimersFrameNumber = m_numRecordedFrames++;
+
+		if (!m_isGpuTimingSupported)
+			return;
+
+		collectGpuTimers(frameIdx);
+
+		vkCmdResetQueryPool(commandBuffer, m_vkTimestampQueryPool, frameIdx * eGpuTimerCount * 2, eGpuTimerCount * 2);
+	}
+
+	void Wrapper::beginGpuTimer(VkCommandBuffer commandBuffer, uint32_t frameIdx, GpuTimer timer)
+	{
+		if (!m_isGpuTimingSupported)
+			return;
+
+		// Timestamp is written once all the previously submitted commands reach the stage
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vkTimestampQueryPool, (frameIdx * eGpuTimerCount + timer) * 2);
+	}
+	void Wrapper::endGpuTimer(VkCommandBuffer commandBuffer, uint32_t frameIdx, GpuTimer timer)
+	{
+		if (!m_isGpuTimingSupported)
+			return;
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_vkTimestampQueryPool, (frameIdx * eGpuTimerCount + timer) * 2 + 1);
+		m_frames[frameIdx].gpuTimersMask |= (1u << timer);
+	}
+
+	void Wrapper::collectGpuTimers(uint32_t frameIdx)
+	{
+		FrameData & frame = m_frames[frameIdx];
+		if (frame.gpuTimersMask == 0)
+			return;
+
+		GpuFrameTimings frameTimings;
+		frameTimings.frameNumber = frame.gpuTimersFrameNumber;
+		for (uint32_t timerIdx = 0; timerIdx < eGpuTimerCount; ++timerIdx)
+		{
+			frameTimings.timesMS[timerIdx] = -1.0;
+			if ((frame.gpuTimersMask & (1u << timerIdx)) == 0)
+				continue;
+
+			// No VK_QUERY_RESULT_WAIT_BIT: frame is known to be finished, and if the results are somehow
+			//	not available, it is better to lose the timing than to stall
+			uint64_t timestamps[2];
+			VkResult result = vkGetQueryPoolResults(
+				m_vkLogicalDeviceData.vkHandle,
+				m_vkTimestampQueryPool,
+				(frameIdx * eGpuTimerCount + timerIdx) * 2,
+				2,
+				sizeof(timestamps),
+				timestamps,
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT
+				);
+			if (result != VK_SUCCESS)
+				continue;
+
+			const uint64_t numTicks = (timestamps[1] - timestamps[0]) & m_gpuTimestampMask;
+			frameTimings.timesMS[timerIdx] = numTicks * m_gpuTimestampPeriodNS * 1e-6;
+		}
+		frame.gpuTimersMask = 0;
+
+		addDynamicResolutionTimings(frameTimings);
+
+		if (m_gpuFrameTimings.size() >= c_maxPendingGpuFrameTimings)
+		{
+			m_gpuFrameTimings.pop_front();
+		}
+		m_gpuFrameTimings.push_back(frameTimings);
+	}
+
+	void Wrapper::popGpuFrameTimings(std::vector<GpuFrameTimings> * frameTimings)
+	{
+		frameTimings->insert(frameTimings->end(), m_gpuFrameTimings.begin(), m_gpuFrameTimings.end());
+		m_gpuFrameTimings.clear();
+	}
+
+	void Wrapper::flushGpuTimers()
+	{
+		if (!m_isGpuTimingSupported)
+			return;
+
+		vkDeviceWaitIdle(m_vkLogicalDeviceData.vkHandle);
+
+		// Oldest frame first, i.e. starting with the slot that is going to be used next
+		const uint32_t numFrames = (uint32_t)m_frames.size();
+		for (uint32_t frameOffset = 0; frameOffset < numFrames; ++frameOffset)
+		{
+			collectGpuTimers((m_curFrameIdx + frameOffset) % numFrames);
+		}
+	}
+}
\ No newline at end of file
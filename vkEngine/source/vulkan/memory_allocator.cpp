@@ -0,0 +1,515 @@
+#include <stdio.h>
+#include <assert.h>
+#include <algorithm>
+
+#include "vulkan/memory_allocator.h"
+
+namespace vulkan
+{
+	namespace
+	{
+		const VkDeviceSize c_defaultBlockSize = 64ull << 20;
+		// Heaps up to this size (e.g. host visible memory of the discrete GPUs) get proportionally smaller blocks
+		const VkDeviceSize c_smallHeapSize = 1ull << 30;
+		// Largest upload is the scene data, which is a few MB even for the large scenes
+		const VkDeviceSize c_stagingRingSize = 32ull << 20;
+
+		const uint32_t c_invalidMemoryTypeIdx = 0xFFffFFff;
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	void MemoryAllocator::init(VkPhysicalDevice physDev, VkDevice logicDev)
+	{
+		m_vkDevice = logicDev;
+		vkGetPhysicalDeviceMemoryProperties(physDev, &m_vkMemoryProperties);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physDev, &deviceProperties);
+		m_bufferImageGranularity = std::max(deviceProperties.limits.bufferImageGranularity, (VkDeviceSize)1);
+		m_maxMemoryAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+		m_numStagingFallbacks = 0;
+		if (!initStagingRing())
+		{
+			// Staging buffers are still served by the regular blocks
+			printf("Failed to create staging ring!\n");
+		}
+	}
+	void MemoryAllocator::deinit()
+	{
+		StagingRing & ring = m_stagingRing;
+		if (ring.deviceMemory != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(m_vkDevice, ring.deviceMemory);
+			vkFreeMemory(m_vkDevice, ring.deviceMemory, nullptr);
+		}
+		m_stagingRing = StagingRing();
+
+		uint32_t numLeakedAllocations = 0;
+		while (!m_blocks.empty())
+		{
+			numLeakedAllocations += m_blocks.back()->numAllocations;
+			destroyBlock(m_blocks.back().get());
+		}
+		if (numLeakedAllocations > 0)
+		{
+			// TODO: warning
+			printf("%u device memory allocations were not freed!\n", numLeakedAllocations);
+		}
+	}
+
+	uint32_t MemoryAllocator::findMemoryTypeIdx(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties) const
+	{
+		for (uint32_t i = 0; i < m_vkMemoryProperties.memoryTypeCount; ++i)
+		{
+			if ( (memoryTypeBits & (1 << i)) &&
+				 ((m_vkMemoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties) )
+			{
+				return i;
+			}
+		}
+		return c_invalidMemoryTypeIdx;
+	}
+	VkDeviceSize MemoryAllocator::getPreferredBlockSize(uint32_t memoryTypeIdx) const
+	{
+		const VkDeviceSize heapSize = m_vkMemoryProperties.memoryHeaps[m_vkMemoryProperties.memoryTypes[memoryTypeIdx].heapIndex].size;
+		return (heapSize <= c_smallHeapSize) ? alignUp(heapSize / 8, 32) : c_defaultBlockSize;
+	}
+
+	MemoryBlock * MemoryAllocator::createBlock(uint32_t memoryTypeIdx, VkDeviceSize size, bool isDedicated)
+	{
+		// Staging ring is an allocation as well
+		const uint32_t numLiveAllocations = (uint32_t)m_blocks.size() + ((m_stagingRing.deviceMemory != VK_NULL_HANDLE) ? 1 : 0);
+		if (numLiveAllocations >= m_maxMemoryAllocationCount)
+		{
+			// TODO: error
+			printf("Device memory allocation limit (%u) reached!\n", m_maxMemoryAllocationCount);
+			return nullptr;
+		}
+
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = size;
+		memoryAllocateInfo.memoryTypeIndex = memoryTypeIdx;
+
+		VkDeviceMemory deviceMemory;
+		if (vkAllocateMemory(m_vkDevice, &memoryAllocateInfo, nullptr, &deviceMemory) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to allocate device memory block of %llu bytes!\n", (unsigned long long)size);
+			return nullptr;
+		}
+
+		std::unique_ptr<MemoryBlock> block(new MemoryBlock);
+		block->deviceMemory = deviceMemory;
+		block->size = size;
+		block->memoryTypeIdx = memoryTypeIdx;
+		block->isDedicated = isDedicated;
+
+		// Mapping the whole block once allows any amount of its resources to be accessed simultaneously
+		if (m_vkMemoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			if (vkMapMemory(m_vkDevice, deviceMemory, 0, VK_WHOLE_SIZE, 0, &block->mappedData) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to map device memory block!\n");
+				block->mappedData = nullptr;
+			}
+		}
+
+		MemoryRange freeRange;
+		freeRange.offset = 0;
+		freeRange.size = size;
+		freeRange.isFree = true;
+		freeRange.resourceType = MemoryResourceType::eLinear;
+		block->ranges.push_back(freeRange);
+
+		m_blocks.push_back(std::move(block));
+		return m_blocks.back().get();
+	}
+	void MemoryAllocator::destroyBlock(MemoryBlock * block)
+	{
+		if (block->mappedData != nullptr)
+		{
+			vkUnmapMemory(m_vkDevice, block->deviceMemory);
+		}
+		vkFreeMemory(m_vkDevice, block->deviceMemory, nullptr);
+
+		m_blocks.erase(
+			std::find_if(m_blocks.begin(), m_blocks.end(), [block](const std::unique_ptr<MemoryBlock> & ownedBlock) { return ownedBlock.get() == block; })
+			);
+	}
+
+	bool MemoryAllocator::allocate(const VkMemoryRequirements & memoryRequirements, VkMemoryPropertyFlags memoryProperties, MemoryResourceType resourceType, MemoryAllocation * allocation)
+	{
+		*allocation = MemoryAllocation();
+
+		const uint32_t memoryTypeIdx = findMemoryTypeIdx(memoryRequirements.memoryTypeBits, memoryProperties);
+		if (memoryTypeIdx == c_invalidMemoryTypeIdx)
+		{
+			// TODO: warning
+			printf("Failed to find suitable memory type!\n");
+			assert(false && "Failed to find suitable memory type!\n");
+			return false;
+		}
+
+		const VkDeviceSize size = memoryRequirements.size;
+		const VkDeviceSize alignment = std::max(memoryRequirements.alignment, (VkDeviceSize)1);
+
+		const VkDeviceSize blockSize = getPreferredBlockSize(memoryTypeIdx);
+		if (size > blockSize / 2)
+		{
+			MemoryBlock * dedicatedBlock = createBlock(memoryTypeIdx, size, true);
+			return (dedicatedBlock != nullptr) && allocateFromBlock(dedicatedBlock, size, alignment, resourceType, allocation);
+		}
+
+		for (const std::unique_ptr<MemoryBlock> & block : m_blocks)
+		{
+			if (block->isDedicated || block->memoryTypeIdx != memoryTypeIdx)
+				continue;
+
+			if (allocateFromBlock(block.get(), size, alignment, resourceType, allocation))
+				return true;
+		}
+
+		MemoryBlock * newBlock = createBlock(memoryTypeIdx, blockSize, false);
+		return (newBlock != nullptr) && allocateFromBlock(newBlock, size, alignment, resourceType, allocation);
+	}
+
+	bool MemoryAllocator::allocateStaging(const VkMemoryRequirements & memoryRequirements, MemoryAllocation * allocation)
+	{
+		*allocation = MemoryAllocation();
+
+		const VkDeviceSize alignment = std::max(memoryRequirements.alignment, (VkDeviceSize)1);
+		if ((memoryRequirements.memoryTypeBits & (1 << m_stagingRing.memoryTypeIdx)) &&
+			allocateFromStagingRing(memoryRequirements.size, alignment, allocation))
+		{
+			return true;
+		}
+
+		++m_numStagingFallbacks;
+		return allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryResourceType::eLinear, allocation);
+	}
+
+	void MemoryAllocator::free(MemoryAllocation * allocation)
+	{
+		if (allocation->deviceMemory == VK_NULL_HANDLE)
+			return;
+
+		if (allocation->isStaging)
+		{
+			freeFromStagingRing(allocation->offset);
+		}
+		else
+		{
+			MemoryBlock * block = allocation->block;
+			freeFromBlock(block, allocation->offset);
+
+			if (block->numAllocations == 0)
+			{
+				// Single empty block per memory type is kept, so that the resources that are recreated
+				//	repeatedly (e.g. on resize) don't allocate and free the device memory each time
+				bool hasOtherEmptyBlock = false;
+				for (const std::unique_ptr<MemoryBlock> & otherBlock : m_blocks)
+				{
+					if (otherBlock.get() != block && !otherBlock->isDedicated && otherBlock->memoryTypeIdx == block->memoryTypeIdx && otherBlock->numAllocations == 0)
+					{
+						hasOtherEmptyBlock = true;
+						break;
+					}
+				}
+
+				if (block->isDedicated || hasOtherEmptyBlock)
+				{
+					destroyBlock(block);
+				}
+			}
+		}
+
+		*allocation = MemoryAllocation();
+	}
+
+	bool MemoryAllocator::allocateFromBlock(MemoryBlock * block, VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType resourceType, MemoryAllocation * allocation)
+	{
+		auto isOnSamePage = [this](VkDeviceSize lastByteOffset, VkDeviceSize firstByteOffset)
+		{
+			return (lastByteOffset / m_bufferImageGranularity) == (firstByteOffset / m_bufferImageGranularity);
+		};
+
+		// Best fit: the smallest free range the allocation fits into
+		const size_t c_invalidRangeIdx = (size_t)-1;
+		size_t bestRangeIdx = c_invalidRangeIdx;
+		VkDeviceSize bestOffset = 0;
+		for (size_t rangeIdx = 0, rangeIdxEnd = block->ranges.size(); rangeIdx < rangeIdxEnd; ++rangeIdx)
+		{
+			const MemoryRange & range = block->ranges[rangeIdx];
+			if (!range.isFree || range.size < size)
+				continue;
+
+			if (bestRangeIdx != c_invalidRangeIdx && range.size >= block->ranges[bestRangeIdx].size)
+				continue;
+
+			// Neighbours of the free range are always allocated, since the free ranges are merged
+			VkDeviceSize offset = alignUp(range.offset, alignment);
+			if (rangeIdx > 0)
+			{
+				const MemoryRange & prevRange = block->ranges[rangeIdx - 1];
+				if (prevRange.resourceType != resourceType && isOnSamePage(prevRange.offset + prevRange.size - 1, offset))
+				{
+					offset = alignUp(offset, m_bufferImageGranularity);
+				}
+			}
+
+			const VkDeviceSize end = offset + size;
+			if (end > range.offset + range.size)
+				continue;
+
+			if (rangeIdx + 1 < rangeIdxEnd)
+			{
+				const MemoryRange & nextRange = block->ranges[rangeIdx + 1];
+				if (nextRange.resourceType != resourceType && isOnSamePage(end - 1, nextRange.offset))
+					continue;
+			}
+
+			bestRangeIdx = rangeIdx;
+			bestOffset = offset;
+		}
+
+		if (bestRangeIdx == c_invalidRangeIdx)
+			return false;
+
+		// Free range is split into the alignment padding, the allocation itself, and the remainder
+		const MemoryRange freeRange = block->ranges[bestRangeIdx];
+		std::vector<MemoryRange> splitRanges;
+		if (bestOffset > freeRange.offset)
+		{
+			MemoryRange paddingRange = freeRange;
+			paddingRange.size = bestOffset - freeRange.offset;
+			splitRanges.push_back(paddingRange);
+		}
+
+		MemoryRange allocatedRange;
+		allocatedRange.offset = bestOffset;
+		allocatedRange.size = size;
+		allocatedRange.isFree = false;
+		allocatedRange.resourceType = resourceType;
+		splitRanges.push_back(allocatedRange);
+
+		const VkDeviceSize freeRangeEnd = freeRange.offset + freeRange.size;
+		if (bestOffset + size < freeRangeEnd)
+		{
+			MemoryRange remainderRange = freeRange;
+			remainderRange.offset = bestOffset + size;
+			remainderRange.size = freeRangeEnd - remainderRange.offset;
+			splitRanges.push_back(remainderRange);
+		}
+
+		block->ranges.erase(block->ranges.begin() + bestRangeIdx);
+		block->ranges.insert(block->ranges.begin() + bestRangeIdx, splitRanges.begin(), splitRanges.end());
+		++block->numAllocations;
+
+		allocation->deviceMemory = block->deviceMemory;
+		allocation->offset = bestOffset;
+		allocation->size = size;
+		allocation->mappedData = (block->mappedData != nullptr) ? static_cast<char *>(block->mappedData) + bestOffset : nullptr;
+		allocation->block = block;
+		allocation->isStaging = false;
+		return true;
+	}
+	void MemoryAllocator::freeFromBlock(MemoryBlock * block, VkDeviceSize offset)
+	{
+		std::vector<MemoryRange> & ranges = block->ranges;
+		auto rangeIt = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const MemoryRange & range, VkDeviceSize value) { return range.offset < value; });
+		if (rangeIt == ranges.end() || rangeIt->offset != offset || rangeIt->isFree)
+		{
+			// TODO: error
+			printf("Freeing device memory that wasn't allocated!\n");
+			assert(false && "Freeing device memory that wasn't allocated!\n");
+			return;
+		}
+
+		rangeIt->isFree = true;
+		--block->numAllocations;
+
+		auto nextRangeIt = rangeIt + 1;
+		if (nextRangeIt != ranges.end() && nextRangeIt->isFree)
+		{
+			rangeIt->size += nextRangeIt->size;
+			ranges.erase(nextRangeIt);
+		}
+		if (rangeIt != ranges.begin())
+		{
+			auto prevRangeIt = rangeIt - 1;
+			if (prevRangeIt->isFree)
+			{
+				prevRangeIt->size += rangeIt->size;
+				ranges.erase(rangeIt);
+			}
+		}
+	}
+
+	bool MemoryAllocator::initStagingRing()
+	{
+		// Memory type bits only depend on the buffer usage and flags, so the probe buffer has the same
+		//	requirements as the actual staging buffers
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = c_stagingRingSize;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer probeBuffer;
+		if (vkCreateBuffer(m_vkDevice, &bufferCreateInfo, nullptr, &probeBuffer) != VK_SUCCESS)
+			return false;
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements(m_vkDevice, probeBuffer, &memoryRequirements);
+		vkDestroyBuffer(m_vkDevice, probeBuffer, nullptr);
+
+		const uint32_t memoryTypeIdx = findMemoryTypeIdx(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (memoryTypeIdx == c_invalidMemoryTypeIdx)
+			return false;
+
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = c_stagingRingSize;
+		memoryAllocateInfo.memoryTypeIndex = memoryTypeIdx;
+
+		StagingRing & ring = m_stagingRing;
+		if (vkAllocateMemory(m_vkDevice, &memoryAllocateInfo, nullptr, &ring.deviceMemory) != VK_SUCCESS)
+		{
+			ring.deviceMemory = VK_NULL_HANDLE;
+			return false;
+		}
+		if (vkMapMemory(m_vkDevice, ring.deviceMemory, 0, VK_WHOLE_SIZE, 0, &ring.mappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(m_vkDevice, ring.deviceMemory, nullptr);
+			ring = StagingRing();
+			return false;
+		}
+
+		ring.size = c_stagingRingSize;
+		ring.memoryTypeIdx = memoryTypeIdx;
+		ring.head = 0;
+		ring.entries.clear();
+		return true;
+	}
+	bool MemoryAllocator::allocateFromStagingRing(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation * allocation)
+	{
+		StagingRing & ring = m_stagingRing;
+		if (ring.deviceMemory == VK_NULL_HANDLE || size > ring.size)
+			return false;
+
+		VkDeviceSize offset = 0;
+		if (!ring.entries.empty())
+		{
+			const VkDeviceSize tail = ring.entries.front().offset;
+			offset = alignUp(ring.head, alignment);
+			if (ring.head > tail)
+			{
+				// Free space is after the head, and before the tail once wrapped around
+				if (offset + size > ring.size)
+				{
+					offset = 0;
+					if (size > tail)
+						return false;
+				}
+			}
+			else if (offset + size > tail)
+			{
+				// Already wrapped around, free space is between the head and the tail
+				return false;
+			}
+		}
+
+		StagingRingEntry entry;
+		entry.offset = offset;
+		entry.end = offset + size;
+		entry.isFreed = false;
+		ring.entries.push_back(entry);
+		ring.head = entry.end;
+
+		allocation->deviceMemory = ring.deviceMemory;
+		allocation->offset = offset;
+		allocation->size = size;
+		allocation->mappedData = static_cast<char *>(ring.mappedData) + offset;
+		allocation->block = nullptr;
+		allocation->isStaging = true;
+		return true;
+	}
+	void MemoryAllocator::freeFromStagingRing(VkDeviceSize offset)
+	{
+		StagingRing & ring = m_stagingRing;
+		for (StagingRingEntry & entry : ring.entries)
+		{
+			if (entry.offset == offset && !entry.isFreed)
+			{
+				entry.isFreed = true;
+				break;
+			}
+		}
+
+		// Space is only reclaimed from the tail, staging buffers are normally freed in the allocation order
+		while (!ring.entries.empty() && ring.entries.front().isFreed)
+		{
+			ring.entries.pop_front();
+		}
+		if (ring.entries.empty())
+		{
+			ring.head = 0;
+		}
+	}
+
+	void MemoryAllocator::getStats(MemoryAllocatorStats * stats) const
+	{
+		*stats = MemoryAllocatorStats();
+
+		VkDeviceSize bytesFree = 0;
+		VkDeviceSize bytesFreeContiguous = 0;
+		for (const std::unique_ptr<MemoryBlock> & block : m_blocks)
+		{
+			VkDeviceSize blockLargestFreeRange = 0;
+			++stats->numBlocks;
+			stats->bytesAllocated += block->size;
+			stats->numAllocations += block->numAllocations;
+			if (block->isDedicated)
+			{
+				++stats->numDedicatedBlocks;
+			}
+
+			for (const MemoryRange & range : block->ranges)
+			{
+				if (!range.isFree)
+				{
+					stats->bytesInUse += range.size;
+				}
+				else if (!block->isDedicated)
+				{
+					++stats->numFreeRanges;
+					bytesFree += range.size;
+					blockLargestFreeRange = std::max(blockLargestFreeRange, range.size);
+				}
+			}
+			bytesFreeContiguous += blockLargestFreeRange;
+			stats->largestFreeRange = std::max(stats->largestFreeRange, blockLargestFreeRange);
+		}
+		stats->fragmentation = (bytesFree > 0) ? 1.0 - bytesFreeContiguous / (double)bytesFree : 0.0;
+
+		const StagingRing & ring = m_stagingRing;
+		if (ring.deviceMemory != VK_NULL_HANDLE)
+		{
+			++stats->numBlocks;
+			stats->bytesAllocated += ring.size;
+			stats->stagingRingSize = ring.size;
+			for (const StagingRingEntry & entry : ring.entries)
+			{
+				stats->stagingRingBytesInUse += entry.end - entry.offset;
+			}
+		}
+		stats->numStagingFallbacks = m_numStagingFallbacks;
+	}
+}
\ No newline at end of file
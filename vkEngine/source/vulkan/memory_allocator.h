@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <vulkan\vulkan.h>
+
+namespace vulkan
+{
+	// Resources that are laid out linearly (buffers, linear tiled images) and non-linearly (optimal tiled
+	//	images) must not share a `bufferImageGranularity` page when placed next to each other in memory
+	enum class MemoryResourceType
+	{
+		eLinear,
+		eOptimal,
+	};
+
+	struct MemoryBlock;
+
+	// Part of the device memory block bound to a single resource
+	struct MemoryAllocation
+	{
+		VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// Host visible blocks are persistently mapped, points to the allocation start; null otherwise
+		void * mappedData = nullptr;
+
+		// Owner block, null for the staging ring allocations
+		MemoryBlock * block = nullptr;
+		bool isStaging = false;
+	};
+
+	struct MemoryRange
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		bool isFree;
+		// Only valid for the allocated ranges
+		MemoryResourceType resourceType;
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIdx = 0;
+		void * mappedData = nullptr;
+		// Holds single resource, and is released together with it
+		bool isDedicated = false;
+
+		// Sorted by offset and cover the whole block, adjacent free ranges are always merged
+		std::vector<MemoryRange> ranges;
+		uint32_t numAllocations = 0;
+	};
+
+	struct MemoryAllocatorStats
+	{
+		// Amount of the `vkAllocateMemory` allocations live, and their total size
+		uint32_t numBlocks = 0;
+		uint32_t numDedicatedBlocks = 0;
+		VkDeviceSize bytesAllocated = 0;
+
+		uint32_t numAllocations = 0;
+		VkDeviceSize bytesInUse = 0;
+
+		uint32_t numFreeRanges = 0;
+		VkDeviceSize largestFreeRange = 0;
+		// Share of the free bytes that are not in the largest free range of their block, 0 means that the free
+		//	space of each block is contiguous (or that there is no free space at all); dedicated blocks are excluded
+		double fragmentation = 0.0;
+
+		VkDeviceSize stagingRingSize = 0;
+		VkDeviceSize stagingRingBytesInUse = 0;
+		// Staging requests that didn't fit into the ring and were served by the regular blocks
+		uint32_t numStagingFallbacks = 0;
+	};
+
+	// Resources are sub-allocated from the large per-memory-type blocks, so that the amount of the live
+	//	`vkAllocateMemory` allocations (limited by `maxMemoryAllocationCount`, and slow to create) stays small.
+	//	Each block keeps the sorted list of ranges that covers it completely, allocation takes the best fitting
+	//	free range, and freeing merges the range with the free neighbours. Resources larger than half of the
+	//	block get their own dedicated allocation. Short-lived staging buffers are taken from a separate ring,
+	//	which is freed in the allocation order and thus doesn't fragment the regular blocks
+	class MemoryAllocator
+	{
+	public:
+		void init(VkPhysicalDevice physDev, VkDevice logicDev);
+		// All the allocations should be freed by then
+		void deinit();
+
+		// Memory type is selected among `memoryRequirements.memoryTypeBits`, and should have all `memoryProperties`
+		bool allocate(const VkMemoryRequirements & memoryRequirements, VkMemoryPropertyFlags memoryProperties, MemoryResourceType resourceType, MemoryAllocation * allocation);
+		// Host visible and coherent memory for the buffers that live until the transfer they are used in
+		//	completes; falls back to `allocate` when the ring is full
+		bool allocateStaging(const VkMemoryRequirements & memoryRequirements, MemoryAllocation * allocation);
+		// Resets the allocation, does nothing for the empty ones
+		void free(MemoryAllocation * allocation);
+
+		void getStats(MemoryAllocatorStats * stats) const;
+
+	private:
+		uint32_t findMemoryTypeIdx(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties) const;
+		VkDeviceSize getPreferredBlockSize(uint32_t memoryTypeIdx) const;
+
+		MemoryBlock * createBlock(uint32_t memoryTypeIdx, VkDeviceSize size, bool isDedicated);
+		void destroyBlock(MemoryBlock * block);
+
+		bool allocateFromBlock(MemoryBlock * block, VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType resourceType, MemoryAllocation * allocation);
+		void freeFromBlock(MemoryBlock * block, VkDeviceSize offset);
+
+		bool initStagingRing();
+		bool allocateFromStagingRing(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation * allocation);
+		void freeFromStagingRing(VkDeviceSize offset);
+
+		VkDevice m_vkDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties m_vkMemoryProperties = {};
+		VkDeviceSize m_bufferImageGranularity = 1;
+		uint32_t m_maxMemoryAllocationCount = 0;
+
+		std::vector<std::unique_ptr<MemoryBlock>> m_blocks;
+
+		struct StagingRingEntry
+		{
+			VkDeviceSize offset;
+			VkDeviceSize end;
+			bool isFreed;
+		};
+		struct StagingRing
+		{
+			VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeIdx = 0;
+			void * mappedData = nullptr;
+			// Next allocation starts here, live entries are in the allocation order
+			VkDeviceSize head = 0;
+			std::deque<StagingRingEntry> entries;
+		};
+		StagingRing m_stagingRing;
+		uint32_t m_numStagingFallbacks = 0;
+	};
+}
\ No newline at end of file
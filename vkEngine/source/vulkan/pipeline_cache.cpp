@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "vulkan/basic.h"
+
+// Pipeline cache
+//	driver compilation of the path tracer shaders dominates the startup, and the graphics pipeline is rebuilt
+//	on each swapchain recreation; all the pipelines are created through the single cache, which is persisted
+//	between the runs. Cache file starts with own header that identifies the device and the driver, since
+//	some drivers don't validate the blob passed to `vkCreatePipelineCache` thoroughly enough, and a stale
+//	cache after the driver update is better discarded than trusted
+
+namespace vulkan
+{
+	namespace
+	{
+		const uint32_t c_pipelineCacheFileMagic = 0x43505456;	// "VTPC"
+		const uint32_t c_pipelineCacheFileVersion = 1;
+
+		struct PipelineCacheFileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+			// FNV-1a of the cache data, catches truncated or otherwise damaged files
+			uint64_t dataHash;
+		};
+
+		uint64_t hashData(const char * data, size_t size)
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			for (size_t byteIdx = 0; byteIdx < size; ++byteIdx)
+			{
+				hash ^= (uint8_t)data[byteIdx];
+				hash *= 0x100000001b3ull;
+			}
+			return hash;
+		}
+
+		void fillPipelineCacheFileHeader(const VkPhysicalDeviceProperties & deviceProperties, PipelineCacheFileHeader * header)
+		{
+			memset(header, 0, sizeof(PipelineCacheFileHeader));
+			header->magic = c_pipelineCacheFileMagic;
+			header->version = c_pipelineCacheFileVersion;
+			header->vendorID = deviceProperties.vendorID;
+			header->deviceID = deviceProperties.deviceID;
+			header->driverVersion = deviceProperties.driverVersion;
+			memcpy(header->pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+		}
+
+		// Returns cache data only if the file matches the device, otherwise the reason of the mismatch
+		bool readPipelineCacheFile(const char * filename, const PipelineCacheFileHeader & expectedHeader, std::vector<char> * data, const char ** missReason)
+		{
+			FILE * fp = nullptr;
+			if (fopen_s(&fp, filename, "rb") != 0 || fp == nullptr)
+			{
+				*missReason = "no cache file";
+				return false;
+			}
+
+			// Data size in the header is only trusted as long as the file actually holds that much
+			uint64_t fileSize = 0;
+			if (fseek(fp, 0, SEEK_END) == 0)
+			{
+				const long fileEnd = ftell(fp);
+				fileSize = (fileEnd > 0) ? (uint64_t)fileEnd : 0;
+			}
+			fseek(fp, 0, SEEK_SET);
+
+			PipelineCacheFileHeader header;
+			bool isValid = false;
+			if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != expectedHeader.magic)
+			{
+				*missReason = "not a pipeline cache file";
+			}
+			else if (header.version != expectedHeader.version)
+			{
+				*missReason = "file version mismatch";
+			}
+			else if (header.vendorID != expectedHeader.vendorID || header.deviceID != expectedHeader.deviceID)
+			{
+				*missReason = "different device";
+			}
+			else if (header.driverVersion != expectedHeader.driverVersion || memcmp(header.pipelineCacheUUID, expectedHeader.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+			{
+				*missReason = "different driver";
+			}
+			else if (header.dataSize == 0 || fileSize < sizeof(header) || header.dataSize > fileSize - sizeof(header))
+			{
+				*missReason = "truncated file";
+			}
+			else
+			{
+				data->resize((size_t)header.dataSize);
+				if (fread(data->data(), 1, data->size(), fp) != data->size())
+				{
+					*missReason = "truncated file";
+				}
+				else if (hashData(data->data(), data->size()) != header.dataHash)
+				{
+					*missReason = "damaged file";
+				}
+				else
+				{
+					isValid = true;
+				}
+			}
+			fclose(fp);
+
+			if (!isValid)
+			{
+				data->resize(0);
+			}
+			return isValid;
+		}
+	}
+
+	void Wrapper::initPipelineCache()
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(m_vkPhysicalDeviceData.vkHandle, &deviceProperties);
+
+		PipelineCacheFileHeader expectedHeader;
+		fillPipelineCacheFileHeader(deviceProperties, &expectedHeader);
+
+		std::vector<char> cacheData;
+		const char * missReason = "disabled";
+		m_isPipelineCacheLoaded = false;
+		if (!m_pipelineCacheFilename.empty())
+		{
+			m_isPipelineCacheLoaded = readPipelineCacheFile(m_pipelineCacheFilename.c_str(), expectedHeader, &cacheData, &missReason);
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+		pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+		VkResult result = vkCreatePipelineCache(m_vkLogicalDeviceData.vkHandle, &pipelineCacheCreateInfo, nullptr, &m_vkPipelineCache);
+		if (result != VK_SUCCESS && m_isPipelineCacheLoaded)
+		{
+			// Driver rejected the data despite the matching header, start with the empty cache instead
+			m_isPipelineCacheLoaded = false;
+			missReason = "rejected by the driver";
+			pipelineCacheCreateInfo.initialDataSize = 0;
+			pipelineCacheCreateInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache(m_vkLogicalDeviceData.vkHandle, &pipelineCacheCreateInfo, nullptr, &m_vkPipelineCache);
+		}
+		if (result != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create pipeline cache!\n");
+			// Pipelines are still created without the cache
+			m_vkPipelineCache = VK_NULL_HANDLE;
+			return;
+		}
+
+		if (m_isPipelineCacheLoaded)
+		{
+			printf("Pipeline cache hit: %zu bytes loaded from %s\n", cacheData.size(), m_pipelineCacheFilename.c_str());
+		}
+		else
+		{
+			printf("Pipeline cache miss (%s), pipelines are compiled from scratch\n", missReason);
+		}
+	}
+	void Wrapper::deinitPipelineCache()
+	{
+		if (m_vkPipelineCache == VK_NULL_HANDLE)
+			return;
+
+		if (!m_pipelineCacheFilename.empty())
+		{
+			savePipelineCache();
+		}
+
+		vkDestroyPipelineCache(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, nullptr);
+		m_vkPipelineCache = VK_NULL_HANDLE;
+	}
+
+	bool Wrapper::savePipelineCache()
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		{
+			printf("Pipeline cache is empty, nothing to save\n");
+			return false;
+		}
+
+		std::vector<char> cacheData(dataSize);
+		if (vkGetPipelineCacheData(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to get pipeline cache data!\n");
+			return false;
+		}
+		cacheData.resize(dataSize);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(m_vkPhysicalDeviceData.vkHandle, &deviceProperties);
+
+		PipelineCacheFileHeader header;
+		fillPipelineCacheFileHeader(deviceProperties, &header);
+		header.dataSize = (uint64_t)cacheData.size();
+		header.dataHash = hashData(cacheData.data(), cacheData.size());
+
+		FILE * fp = nullptr;
+		if (fopen_s(&fp, m_pipelineCacheFilename.c_str(), "wb") != 0 || fp == nullptr)
+		{
+			printf("Failed to open %s for writing!\n", m_pipelineCacheFilename.c_str());
+			return false;
+		}
+
+		// Interrupted write leaves the file that fails the size or the hash check on the next load
+		const bool isWritten = (fwrite(&header, sizeof(header), 1, fp) == 1) && (fwrite(cacheData.data(), 1, cacheData.size(), fp) == cacheData.size());
+		fclose(fp);
+
+		if (!isWritten)
+		{
+			printf("Failed to write pipeline cache into %s!\n", m_pipelineCacheFilename.c_str());
+			return false;
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "vulkan/basic.h"
+
+// Retired resources
+//	when the swapchain is recreated, frames in flight still reference the old swapchain images, framebuffers
+//	and the extent-sized images and buffers through their command buffers and descriptor sets. Instead of
+//	waiting for the device to idle, such resources are moved into the retirement list tagged with the number
+//	of the frames submitted so far, and destroyed once the fences show that all of those frames are done.
+//	Replacement resources (as well as the ones created in `init`) are initialized by the next frame command
+//	buffer, and the descriptor sets of each frame slot are rewritten once the slot is free, see
+//	`FrameData::areDescriptorSetsDirty`
+
+namespace vulkan
+{
+	Wrapper::RetiredResources & Wrapper::getRetiredResources()
+	{
+		// Everything retired before the next submission shares the entry
+		if (m_retiredResources.empty() || m_retiredResources.back().frameNumber != m_numSubmittedFrames)
+		{
+			m_retiredResources.push_back(RetiredResources());
+			m_retiredResources.back().frameNumber = m_numSubmittedFrames;
+		}
+		return m_retiredResources.back();
+	}
+
+	void Wrapper::retireImage(VkImage image, VkImageView imageView, const MemoryAllocation & imageAllocation)
+	{
+		// Image could be retired before any frame initialized it
+		m_pendingStorageImageTransitions.erase(
+			std::remove(m_pendingStorageImageTransitions.begin(), m_pendingStorageImageTransitions.end(), image),
+			m_pendingStorageImageTransitions.end()
+			);
+
+		RetiredResources & retiredResources = getRetiredResources();
+		retiredResources.imageViews.push_back(imageView);
+		retiredResources.images.push_back(image);
+		retiredResources.allocations.push_back(imageAllocation);
+	}
+	void Wrapper::retireBuffer(VkBuffer buffer, const MemoryAllocation & bufferAllocation)
+	{
+		m_pendingBufferClears.erase(
+			std::remove(m_pendingBufferClears.begin(), m_pendingBufferClears.end(), buffer),
+			m_pendingBufferClears.end()
+			);
+
+		RetiredResources & retiredResources = getRetiredResources();
+		retiredResources.buffers.push_back(buffer);
+		retiredResources.allocations.push_back(bufferAllocation);
+	}
+
+	void Wrapper::releaseRetiredResources(bool releaseAll)
+	{
+		const uint64_t numFrames = (uint64_t)m_frames.size();
+
+		size_t numReleased = 0;
+		for (size_t numRetired = m_retiredResources.size(); numReleased < numRetired; ++numReleased)
+		{
+			RetiredResources & retiredResources = m_retiredResources[numReleased];
+
+			// Current slot was last used by the frame `m_numSubmittedFrames - numFrames`, so that frame and all
+			//	the frames before it are done; resources are referenced by the frames before `frameNumber`
+			if (!releaseAll && retiredResources.frameNumber + numFrames > m_numSubmittedFrames + 1)
+				break;
+
+			const VkDevice device = m_vkLogicalDeviceData.vkHandle;
+			for (VkFramebuffer framebuffer : retiredResources.framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			for (VkImageView imageView : retiredResources.imageViews)
+			{
+				vkDestroyImageView(device, imageView, nullptr);
+			}
+			for (VkImage image : retiredResources.images)
+			{
+				vkDestroyImage(device, image, nullptr);
+			}
+			for (VkBuffer buffer : retiredResources.buffers)
+			{
+				vkDestroyBuffer(device, buffer, nullptr);
+			}
+			for (MemoryAllocation & allocation : retiredResources.allocations)
+			{
+				m_memoryAllocator.free(&allocation);
+			}
+			for (VkSwapchainKHR swapchain : retiredResources.swapchains)
+			{
+				vkDestroySwapchainKHR(device, swapchain, nullptr);
+			}
+		}
+
+		m_retiredResources.erase(m_retiredResources.begin(), m_retiredResources.begin() + numReleased);
+	}
+
+	void Wrapper::initStorageImageLayout(VkImage image, VkFormat format)
+	{
+		m_pendingStorageImageTransitions.push_back(image);
+	}
+	void Wrapper::initBufferContents(VkBuffer buffer)
+	{
+		m_pendingBufferClears.push_back(buffer);
+	}
+
+	void Wrapper::recordPendingResourceInits(VkCommandBuffer commandBuffer)
+	{
+		if (m_pendingStorageImageTransitions.empty() && m_pendingBufferClears.empty())
+			return;
+
+		for (VkBuffer buffer : m_pendingBufferClears)
+		{
+			vkCmdFillBuffer(commandBuffer, buffer, 0, VK_WHOLE_SIZE, 0);
+		}
+
+		// Cleared buffers include the indirect dispatch arguments
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		// Storage images are both read and written by the shaders, and keep the general layout for their lifetime
+		std::vector<VkImageMemoryBarrier> imageMemoryBarriers(m_pendingStorageImageTransitions.size());
+		for (size_t imageIdx = 0, imageIdxEnd = imageMemoryBarriers.size(); imageIdx < imageIdxEnd; ++imageIdx)
+		{
+			VkImageMemoryBarrier & imageMemoryBarrier = imageMemoryBarriers[imageIdx];
+			imageMemoryBarrier = {};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.image = m_pendingStorageImageTransitions[imageIdx];
+			imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+			imageMemoryBarrier.subresourceRange.levelCount = 1;
+			imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+			imageMemoryBarrier.subresourceRange.layerCount = 1;
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			m_pendingBufferClears.empty() ? 0 : 1, &memoryBarrier,
+			0, nullptr,
+			(uint32_t)imageMemoryBarriers.size(), imageMemoryBarriers.empty() ? nullptr : imageMemoryBarriers.data()
+			);
+
+		m_pendingStorageImageTransitions.resize(0);
+		m_pendingBufferClears.resize(0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "vulkan/basic.h"
+
+// Temporal reprojection
+//	tracers store the first hit surface of each pixel (normal and distance) into one of the two surface images,
+//	alternating between the frames. When the camera moves, the accumulation is still restarted, but before
+//	the tracing the previous accumulation is copied into the history image, and after the tracing the
+//	temporal pass (`temporal.cs`) finds where the previous camera saw the pixel surface, fetches the history
+//	there from the taps that pass the distance and normal tests (disocclusions are rejected), clips its
+//	luminance to the deviation of the new samples, and blends it in as if it was accumulated in the pixel.
+//	History is only valid if nothing but the camera restarted the accumulation since the previous frame
+
+namespace vulkan
+{
+	void Wrapper::initTemporalImages()
+	{
+		// Three more swapchain-sized RGBA32F images are too much to keep around unused, but the descriptor sets
+		//	still need valid views, so there are 1x1 placeholders that are never accessed instead
+		m_areTemporalImagesAllocated = m_isTemporalReprojectionEnabled && (m_tracerBackend != TracerBackend::eFragment);
+		const uint32_t width = m_areTemporalImagesAllocated ? m_vkSwapchainData.extent.width : 1;
+		const uint32_t height = m_areTemporalImagesAllocated ? m_vkSwapchainData.extent.height : 1;
+
+		createImage(
+			width,
+			height,
+			m_vkAccumImageFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_vkHistoryImage,
+			&m_vkHistoryImageAllocation
+			);
+		for (int surfaceIdx = 0; surfaceIdx < 2; ++surfaceIdx)
+		{
+			createImage(
+				width,
+				height,
+				m_vkSurfaceImageFormat,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_STORAGE_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&m_vkSurfaceImages[surfaceIdx],
+				&m_vkSurfaceImagesAllocations[surfaceIdx]
+				);
+		}
+
+		// Contents are undefined, but history is only read after a frame since the accumulation restart fills them
+		initStorageImageLayout(m_vkHistoryImage, m_vkAccumImageFormat);
+		m_vkHistoryImageView = createImageView2D(m_vkLogicalDeviceData.vkHandle, m_vkHistoryImage, m_vkAccumImageFormat);
+		for (int surfaceIdx = 0; surfaceIdx < 2; ++surfaceIdx)
+		{
+			initStorageImageLayout(m_vkSurfaceImages[surfaceIdx], m_vkSurfaceImageFormat);
+			m_vkSurfaceImageViews[surfaceIdx] = createImageView2D(m_vkLogicalDeviceData.vkHandle, m_vkSurfaceImages[surfaceIdx], m_vkSurfaceImageFormat);
+		}
+
+		resetAccumulation();
+	}
+	void Wrapper::deinitTemporalImages()
+	{
+		for (int surfaceIdx = 0; surfaceIdx < 2; ++surfaceIdx)
+		{
+			vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkSurfaceImageViews[surfaceIdx], nullptr);
+			vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkSurfaceImages[surfaceIdx], nullptr);
+			m_memoryAllocator.free(&m_vkSurfaceImagesAllocations[surfaceIdx]);
+		}
+
+		vkDestroyImageView(m_vkLogicalDeviceData.vkHandle, m_vkHistoryImageView, nullptr);
+		vkDestroyImage(m_vkLogicalDeviceData.vkHandle, m_vkHistoryImage, nullptr);
+		m_memoryAllocator.free(&m_vkHistoryImageAllocation);
+	}
+
+	void Wrapper::initTemporalPipeline()
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &m_vkUBODescriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(m_vkLogicalDeviceData.vkHandle, &pipelineLayoutCreateInfo, nullptr, &m_vkTemporalPipelineLayout) != VK_SUCCESS)
+		{
+			printf("Failed to create temporal reprojection pipeline layout!\n");
+		}
+
+		// Same as the adaptive mask, pipeline is created regardless of the setting, so that it could be toggled at runtime
+		VkShaderModule temporalShaderModule = loadShaderModule("shaders/bin/temporal.cs.spv");
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePipelineCreateInfo.stage.module = temporalShaderModule;
+		computePipelineCreateInfo.stage.pName = "main";
+		computePipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+		computePipelineCreateInfo.layout = m_vkTemporalPipelineLayout;
+		computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		computePipelineCreateInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_vkTemporalPipeline) != VK_SUCCESS)
+		{
+			printf("Failed to create temporal reprojection pipeline!\n");
+		}
+
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, temporalShaderModule, nullptr);
+	}
+	void Wrapper::deinitTemporalPipeline()
+	{
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkTemporalPipeline, nullptr);
+		vkDestroyPipelineLayout(m_vkLogicalDeviceData.vkHandle, m_vkTemporalPipelineLayout, nullptr);
+	}
+
+	void Wrapper::recordTemporalHistoryCopy(VkCommandBuffer commandBuffer)
+	{
+		// Accumulation image is written by the previous frame tracing (and possibly read by its presentation)
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+
+		// Both images stay in the general layout, and only the traced part is copied
+		VkImageCopy imageCopyRegion = {};
+		imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageCopyRegion.srcSubresource.mipLevel = 0;
+		imageCopyRegion.srcSubresource.baseArrayLayer = 0;
+		imageCopyRegion.srcSubresource.layerCount = 1;
+		imageCopyRegion.srcOffset = {0, 0, 0};
+		imageCopyRegion.dstSubresource = imageCopyRegion.srcSubresource;
+		imageCopyRegion.dstOffset = {0, 0, 0};
+		imageCopyRegion.extent = {m_renderExtent.width, m_renderExtent.height, 1};
+
+		vkCmdCopyImage(
+			commandBuffer,
+			m_vkAccumImage,
+			VK_IMAGE_LAYOUT_GENERAL,
+			m_vkHistoryImage,
+			VK_IMAGE_LAYOUT_GENERAL,
+			1,
+			&imageCopyRegion
+			);
+
+		// Tracing overwrites the accumulation image, and the temporal pass reads the history
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+	}
+
+	void Wrapper::recordTemporalReprojection(VkCommandBuffer commandBuffer, uint32_t frameIdx)
+	{
+		// Accumulation and surfaces are written by the tracing
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkTemporalPipeline);
+		const uint32_t uboDynamicOffset = getUBODynamicOffset(frameIdx);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_vkTemporalPipelineLayout,
+			0,
+			1,
+			&m_frames[frameIdx].descriptorSet,
+			1,
+			&uboDynamicOffset
+			);
+
+		// Should match the workgroup size in `temporal.cs`
+		const uint32_t temporalWorkgroupSize = 8;
+		const uint32_t numGroupsX = (m_renderExtent.width + temporalWorkgroupSize - 1) / temporalWorkgroupSize;
+		const uint32_t numGroupsY = (m_renderExtent.height + temporalWorkgroupSize - 1) / temporalWorkgroupSize;
+		vkCmdDispatch(commandBuffer, numGroupsX, numGroupsY, 1);
+
+		// Fullscreen quad pass presents the blended accumulation
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <string.h>
+
+#include "vulkan/basic.h"
+
+// Uploads
+//	each upload used to be a separate submission to the graphics queue followed by `vkQueueWaitIdle`. Instead,
+//	copies out of the staging buffers are recorded into the batch command buffer, which is submitted to the
+//	transfer queue (dedicated copy engine if the device exposes one) right before the next frame, and the frame
+//	waits on the batch semaphore. Upload destinations are created with the concurrent sharing between the graphics
+//	and the transfer queue families, so no queue family ownership transfers are needed. Staging buffers, command
+//	buffer and semaphore of the batch are recycled once the frame that waited on it is done
+
+namespace vulkan
+{
+	void Wrapper::initUploads()
+	{
+		VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		commandPoolCreateInfo.queueFamilyIndex = m_vkLogicalDeviceData.transferQueueFamilyIndex;
+		// Batch command buffers are recorded once and recycled
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(m_vkLogicalDeviceData.vkHandle, &commandPoolCreateInfo, nullptr, &m_vkUploadCommandPool) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create upload command pool!\n");
+		}
+
+		if (m_vkLogicalDeviceData.transferQueueFamilyIndex != m_vkLogicalDeviceData.graphicsQueueFamilyIndex)
+		{
+			printf("Uploads use dedicated transfer queue family %d\n", (int)m_vkLogicalDeviceData.transferQueueFamilyIndex);
+		}
+		else
+		{
+			printf("No dedicated transfer queue family, uploads use graphics queue\n");
+		}
+	}
+	void Wrapper::deinitUploads()
+	{
+		// Open batch was never submitted, and the device is idle at this point
+		if (m_isUploadBatchOpen)
+		{
+			m_openUploadBatch.isWaited = true;
+			m_submittedUploadBatches.push_back(m_openUploadBatch);
+			m_openUploadBatch = UploadBatch();
+			m_isUploadBatchOpen = false;
+		}
+		releaseCompletedUploads(true);
+
+		for (UploadBatch & batch : m_freeUploadBatches)
+		{
+			vkDestroySemaphore(m_vkLogicalDeviceData.vkHandle, batch.semaphore, nullptr);
+		}
+		m_freeUploadBatches.resize(0);
+
+		// Command buffers deallocation happens automatically on VkCommandPool destruction
+		vkDestroyCommandPool(m_vkLogicalDeviceData.vkHandle, m_vkUploadCommandPool, nullptr);
+		m_vkUploadCommandPool = VK_NULL_HANDLE;
+	}
+
+	Wrapper::UploadBatch & Wrapper::getOpenUploadBatch()
+	{
+		if (m_isUploadBatchOpen)
+			return m_openUploadBatch;
+
+		if (!m_freeUploadBatches.empty())
+		{
+			m_openUploadBatch = m_freeUploadBatches.back();
+			m_freeUploadBatches.pop_back();
+		}
+		else
+		{
+			m_openUploadBatch = UploadBatch();
+
+			VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandPool = m_vkUploadCommandPool;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(m_vkLogicalDeviceData.vkHandle, &commandBufferAllocateInfo, &m_openUploadBatch.commandBuffer) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to allocate upload command buffer!\n");
+			}
+
+			VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			if (vkCreateSemaphore(m_vkLogicalDeviceData.vkHandle, &semaphoreCreateInfo, nullptr, &m_openUploadBatch.semaphore) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to create upload semaphore!\n");
+			}
+		}
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		// Command pool is created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, so this implicitly resets the recycled buffer
+		vkBeginCommandBuffer(m_openUploadBatch.commandBuffer, &commandBufferBeginInfo);
+
+		m_isUploadBatchOpen = true;
+		return m_openUploadBatch;
+	}
+
+	void Wrapper::uploadBufferData(VkBuffer dstBuffer, const void * data, size_t dataSize)
+	{
+		if (dataSize == 0)
+			return;
+
+		UploadBatch & batch = getOpenUploadBatch();
+
+		VkBuffer stagingBuffer;
+		MemoryAllocation stagingBufferAllocation;
+		createStagingBuffer(
+			(VkDeviceSize)dataSize,
+			&stagingBuffer,
+			&stagingBufferAllocation
+			);
+
+		memcpy(stagingBufferAllocation.mappedData, data, dataSize);
+
+		VkBufferCopy bufferCopyRegion = {};
+		bufferCopyRegion.srcOffset = 0;
+		bufferCopyRegion.dstOffset = 0;
+		bufferCopyRegion.size = (VkDeviceSize)dataSize;
+		vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, dstBuffer, 1, &bufferCopyRegion);
+
+		batch.stagingBuffers.push_back(stagingBuffer);
+		batch.stagingAllocations.push_back(stagingBufferAllocation);
+	}
+
+	void Wrapper::uploadImageData(VkImage image, uint32_t width, uint32_t height, const void * data, size_t dataSize)
+	{
+		if (dataSize == 0)
+			return;
+
+		UploadBatch & batch = getOpenUploadBatch();
+
+		VkBuffer stagingBuffer;
+		MemoryAllocation stagingBufferAllocation;
+		createStagingBuffer(
+			(VkDeviceSize)dataSize,
+			&stagingBuffer,
+			&stagingBufferAllocation
+			);
+
+		memcpy(stagingBufferAllocation.mappedData, data, dataSize);
+
+		VkImageMemoryBarrier imageMemoryBarrier = {};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+		imageMemoryBarrier.subresourceRange.levelCount = 1;
+		imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+		imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+		// Previous contents are not needed
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier
+			);
+
+		// Whole image is copied, which satisfies `minImageTransferGranularity` of any transfer queue family
+		VkBufferImageCopy bufferImageCopyRegion = {};
+		bufferImageCopyRegion.bufferOffset = 0;
+		bufferImageCopyRegion.bufferRowLength = 0;
+		bufferImageCopyRegion.bufferImageHeight = 0;
+
+		bufferImageCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferImageCopyRegion.imageSubresource.mipLevel = 0;
+		bufferImageCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferImageCopyRegion.imageSubresource.layerCount = 1;
+
+		bufferImageCopyRegion.imageOffset = {0, 0, 0};
+		bufferImageCopyRegion.imageExtent = {width, height, 1};
+
+		vkCmdCopyBufferToImage(
+			batch.commandBuffer,
+			stagingBuffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&bufferImageCopyRegion
+			);
+
+		// Transfer queue might not support the shader stages, visibility for the shader reads is provided
+		//	by the semaphore wait of the frame
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier
+			);
+
+		batch.stagingBuffers.push_back(stagingBuffer);
+		batch.stagingAllocations.push_back(stagingBufferAllocation);
+	}
+
+	void Wrapper::submitUploads()
+	{
+		if (!m_isUploadBatchOpen)
+			return;
+
+		vkEndCommandBuffer(m_openUploadBatch.commandBuffer);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_openUploadBatch.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &m_openUploadBatch.semaphore;
+
+		if (vkQueueSubmit(m_vkLogicalDeviceData.transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			// TODO: warning
+			printf("Failed to submit upload command buffer!\n");
+		}
+
+		m_openUploadBatch.isWaited = false;
+		m_submittedUploadBatches.push_back(m_openUploadBatch);
+		m_openUploadBatch = UploadBatch();
+		m_isUploadBatchOpen = false;
+	}
+
+	void Wrapper::addUploadWaitSemaphores(std::vector<VkSemaphore> * waitSemaphores, std::vector<VkPipelineStageFlags> * waitStages)
+	{
+		submitUploads();
+
+		// Uploaded buffers and images are only read as the vertex input and from the shaders
+		const VkPipelineStageFlags uploadWaitStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		for (UploadBatch & batch : m_submittedUploadBatches)
+		{
+			if (batch.isWaited)
+				continue;
+
+			waitSemaphores->push_back(batch.semaphore);
+			waitStages->push_back(uploadWaitStages);
+
+			// Frame that is about to be submitted
+			batch.waitFrameNumber = m_numSubmittedFrames;
+			batch.isWaited = true;
+		}
+	}
+
+	void Wrapper::releaseCompletedUploads(bool releaseAll)
+	{
+		const uint64_t numFrames = (uint64_t)m_frames.size();
+
+		while (!m_submittedUploadBatches.empty())
+		{
+			UploadBatch & batch = m_submittedUploadBatches.front();
+
+			// Semaphore could only be reused after the wait on it is executed, and the staging buffers after
+			//	the transfer; both are done once the waiting frame is
+			if (!releaseAll && (!batch.isWaited || batch.waitFrameNumber + numFrames > m_numSubmittedFrames))
+				break;
+
+			for (VkBuffer stagingBuffer : batch.stagingBuffers)
+			{
+				vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, stagingBuffer, nullptr);
+			}
+			for (MemoryAllocation & stagingAllocation : batch.stagingAllocations)
+			{
+				m_memoryAllocator.free(&stagingAllocation);
+			}
+			batch.stagingBuffers.resize(0);
+			batch.stagingAllocations.resize(0);
+
+			m_freeUploadBatches.push_back(batch);
+			m_submittedUploadBatches.pop_front();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,409 @@
+#include <stddef.h>
+
+#include "vulkan/basic.h"
+
+// Wavefront path tracing backend
+//	instead of tracing the whole path in a single thread (megakernel), paths are stored in the buffers and
+//	processed by the separate compute stages, each stage only receiving the paths that need it:
+//		generate: creates camera rays for the pixels that still need samples, fills the first ray queue
+//		extend: finds the closest hits for the ray queue, sorts hit paths into per-material queues
+//		shade: one pipeline per material type, scatters the paths and appends survivors to the next ray queue
+//		control: single thread, converts queue sizes into the indirect dispatch arguments
+//		resolve: averages the frame samples into the accumulation image
+//	terminated paths are compacted out of the queues via atomic append, so that the later bounces only
+//	dispatch the threads for the paths that are still alive
+
+namespace vulkan
+{
+	void Wrapper::initWavefrontBuffers()
+	{
+		const VkDeviceSize numPaths = (VkDeviceSize)m_vkSwapchainData.extent.width * m_vkSwapchainData.extent.height;
+
+		// Should match the structures in `wavefront.glsl`
+		const VkDeviceSize pathStateSize = 4 * 16;
+		const VkDeviceSize pathHitSize = 2 * 16;
+		const VkDeviceSize queueEntrySize = sizeof(uint32_t);
+		const VkDeviceSize radianceSize = 16;
+
+		VkDeviceSize bufferSizes[eWavefrontBufferCount];
+		bufferSizes[eWavefrontBufferPathStates] = numPaths * pathStateSize;
+		bufferSizes[eWavefrontBufferPathHits] = numPaths * pathHitSize;
+		bufferSizes[eWavefrontBufferRayQueues] = 2 * numPaths * queueEntrySize;
+		bufferSizes[eWavefrontBufferMaterialQueues] = c_numWavefrontMaterialQueues * numPaths * queueEntrySize;
+		bufferSizes[eWavefrontBufferCounters] = sizeof(WavefrontCounters);
+		bufferSizes[eWavefrontBufferRadiance] = numPaths * radianceSize;
+
+		for (int bufferIdx = 0; bufferIdx < eWavefrontBufferCount; ++bufferIdx)
+		{
+			VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			if (bufferIdx == eWavefrontBufferCounters)
+			{
+				usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+			}
+
+			createBuffer(
+				bufferSizes[bufferIdx],
+				usage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&m_vkWavefrontBuffers[bufferIdx],
+				&m_vkWavefrontBuffersAllocations[bufferIdx]
+				);
+		}
+
+		// Radiance is accumulated over the frame samples, and cleared by the resolve stage
+		//	counters are initialized by the generate stage, but are cleared to avoid garbage indirect dispatches
+		initBufferContents(m_vkWavefrontBuffers[eWavefrontBufferRadiance]);
+		initBufferContents(m_vkWavefrontBuffers[eWavefrontBufferCounters]);
+	}
+	void Wrapper::deinitWavefrontBuffers()
+	{
+		for (int bufferIdx = 0; bufferIdx < eWavefrontBufferCount; ++bufferIdx)
+		{
+			vkDestroyBuffer(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontBuffers[bufferIdx], nullptr);
+			m_memoryAllocator.free(&m_vkWavefrontBuffersAllocations[bufferIdx]);
+			m_vkWavefrontBuffers[bufferIdx] = VK_NULL_HANDLE;
+		}
+	}
+
+	void Wrapper::initWavefrontDescriptorSet()
+	{
+		VkDescriptorSetLayoutBinding bindings[eWavefrontBufferCount];
+		for (uint32_t bindingIdx = 0; bindingIdx < eWavefrontBufferCount; ++bindingIdx)
+		{
+			VkDescriptorSetLayoutBinding & binding = bindings[bindingIdx];
+			binding = { };
+			binding.binding = bindingIdx;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			binding.descriptorCount = 1;
+			binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			binding.pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+		descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutCreateInfo.bindingCount = eWavefrontBufferCount;
+		descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+		if (vkCreateDescriptorSetLayout(m_vkLogicalDeviceData.vkHandle, &descriptorSetLayoutCreateInfo, nullptr, &m_vkWavefrontDescriptorSetLayout) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create wavefront descriptor set layout!\n");
+		}
+
+		const uint32_t numFrames = (uint32_t)m_frames.size();
+
+		VkDescriptorPoolSize descriptorPoolSize = {};
+		descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorPoolSize.descriptorCount = eWavefrontBufferCount * numFrames;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.flags = (VkDescriptorPoolCreateFlags)0;
+		descriptorPoolCreateInfo.maxSets = numFrames;
+		descriptorPoolCreateInfo.poolSizeCount = 1;
+		descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
+
+		if (vkCreateDescriptorPool(m_vkLogicalDeviceData.vkHandle, &descriptorPoolCreateInfo, nullptr, &m_vkWavefrontDescriptorPool) != VK_SUCCESS)
+		{
+			// TODO: error
+			printf("Failed to create wavefront descriptor pool!\n");
+		}
+
+		for (uint32_t frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+		{
+			VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+			descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocateInfo.descriptorPool = m_vkWavefrontDescriptorPool;
+			descriptorSetAllocateInfo.descriptorSetCount = 1;
+			descriptorSetAllocateInfo.pSetLayouts = &m_vkWavefrontDescriptorSetLayout;
+
+			if (vkAllocateDescriptorSets(m_vkLogicalDeviceData.vkHandle, &descriptorSetAllocateInfo, &m_frames[frameIdx].wavefrontDescriptorSet) != VK_SUCCESS)
+			{
+				// TODO: error
+				printf("Failed to allocate wavefront descriptor set!\n");
+			}
+
+			updateWavefrontDescriptorSet(frameIdx);
+		}
+	}
+	void Wrapper::deinitWavefrontDescriptorSet()
+	{
+		// Descriptor sets are freed along with the pool
+		vkDestroyDescriptorPool(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontDescriptorSetLayout, nullptr);
+		for (FrameData & frame : m_frames)
+		{
+			frame.wavefrontDescriptorSet = VK_NULL_HANDLE;
+		}
+	}
+	void Wrapper::updateWavefrontDescriptorSet(uint32_t frameIdx)
+	{
+		VkDescriptorBufferInfo descriptorBufferInfos[eWavefrontBufferCount];
+		VkWriteDescriptorSet writeDescriptorSets[eWavefrontBufferCount];
+		for (uint32_t bindingIdx = 0; bindingIdx < eWavefrontBufferCount; ++bindingIdx)
+		{
+			VkDescriptorBufferInfo & descriptorBufferInfo = descriptorBufferInfos[bindingIdx];
+			descriptorBufferInfo = {};
+			descriptorBufferInfo.buffer = m_vkWavefrontBuffers[bindingIdx];
+			descriptorBufferInfo.offset = 0;
+			descriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet & writeDescriptorSet = writeDescriptorSets[bindingIdx];
+			writeDescriptorSet = { };
+			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSet.dstSet = m_frames[frameIdx].wavefrontDescriptorSet;
+			writeDescriptorSet.dstBinding = bindingIdx;
+			writeDescriptorSet.dstArrayElement = 0;
+			writeDescriptorSet.descriptorCount = 1;
+			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSet.pImageInfo = nullptr;
+			writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
+			writeDescriptorSet.pTexelBufferView = nullptr;
+		}
+
+		vkUpdateDescriptorSets(m_vkLogicalDeviceData.vkHandle, eWavefrontBufferCount, writeDescriptorSets, 0, nullptr);
+	}
+
+	void Wrapper::initWavefrontPipelines()
+	{
+		VkDescriptorSetLayout descriptorSetLayouts[] = { m_vkUBODescriptorSetLayout, m_vkWavefrontDescriptorSetLayout };
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(WavefrontPushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 2;
+		pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(m_vkLogicalDeviceData.vkHandle, &pipelineLayoutCreateInfo, nullptr, &m_vkWavefrontPipelineLayout) != VK_SUCCESS)
+		{
+			printf("Failed to create wavefront pipeline layout!\n");
+		}
+
+		// Constant 0 is the workgroup size, constant 1 is the material type (only used by the shade stage)
+		struct SpecializationData
+		{
+			uint32_t workgroupSize;
+			int32_t materialType;
+		};
+		VkSpecializationMapEntry specializationMapEntries[2];
+		specializationMapEntries[0].constantID = 0;
+		specializationMapEntries[0].offset = offsetof(SpecializationData, workgroupSize);
+		specializationMapEntries[0].size = sizeof(uint32_t);
+		specializationMapEntries[1].constantID = 1;
+		specializationMapEntries[1].offset = offsetof(SpecializationData, materialType);
+		specializationMapEntries[1].size = sizeof(int32_t);
+
+		auto createPipeline = [&](VkShaderModule shaderModule, int32_t materialType, VkPipeline * pipeline)
+		{
+			SpecializationData specializationData;
+			specializationData.workgroupSize = c_wavefrontWorkgroupSize;
+			specializationData.materialType = materialType;
+
+			VkSpecializationInfo specializationInfo = {};
+			specializationInfo.mapEntryCount = 2;
+			specializationInfo.pMapEntries = specializationMapEntries;
+			specializationInfo.dataSize = sizeof(specializationData);
+			specializationInfo.pData = &specializationData;
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+			computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computePipelineCreateInfo.stage.module = shaderModule;
+			computePipelineCreateInfo.stage.pName = "main";
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			computePipelineCreateInfo.layout = m_vkWavefrontPipelineLayout;
+			computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+			computePipelineCreateInfo.basePipelineIndex = -1;
+
+			if (vkCreateComputePipelines(m_vkLogicalDeviceData.vkHandle, m_vkPipelineCache, 1, &computePipelineCreateInfo, nullptr, pipeline) != VK_SUCCESS)
+			{
+				printf("Failed to create wavefront compute pipeline!\n");
+			}
+		};
+
+		// Shader modules are only needed for the pipeline creation
+		VkShaderModule generateShaderModule = loadShaderModule("shaders/bin/wf_generate.cs.spv");
+		VkShaderModule extendShaderModule = loadShaderModule("shaders/bin/wf_extend.cs.spv");
+		VkShaderModule shadeShaderModule = loadShaderModule("shaders/bin/wf_shade.cs.spv");
+		VkShaderModule controlShaderModule = loadShaderModule("shaders/bin/wf_control.cs.spv");
+		VkShaderModule resolveShaderModule = loadShaderModule("shaders/bin/wf_resolve.cs.spv");
+
+		createPipeline(generateShaderModule, 0, &m_vkWavefrontGeneratePipeline);
+		createPipeline(extendShaderModule, 0, &m_vkWavefrontExtendPipeline);
+		for (uint32_t queueIdx = 0; queueIdx < c_numWavefrontMaterialQueues; ++queueIdx)
+		{
+			// Material queues are in the order of material types, starting with Lambert
+			int32_t materialType = (int32_t)scene::MaterialType::eLambert + (int32_t)queueIdx;
+			createPipeline(shadeShaderModule, materialType, &m_vkWavefrontShadePipelines[queueIdx]);
+		}
+		createPipeline(controlShaderModule, 0, &m_vkWavefrontControlPipeline);
+		createPipeline(resolveShaderModule, 0, &m_vkWavefrontResolvePipeline);
+
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, generateShaderModule, nullptr);
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, extendShaderModule, nullptr);
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, shadeShaderModule, nullptr);
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, controlShaderModule, nullptr);
+		vkDestroyShaderModule(m_vkLogicalDeviceData.vkHandle, resolveShaderModule, nullptr);
+	}
+	void Wrapper::deinitWavefrontPipelines()
+	{
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontGeneratePipeline, nullptr);
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontExtendPipeline, nullptr);
+		for (uint32_t queueIdx = 0; queueIdx < c_numWavefrontMaterialQueues; ++queueIdx)
+		{
+			vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontShadePipelines[queueIdx], nullptr);
+		}
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontControlPipeline, nullptr);
+		vkDestroyPipeline(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontResolvePipeline, nullptr);
+		vkDestroyPipelineLayout(m_vkLogicalDeviceData.vkHandle, m_vkWavefrontPipelineLayout, nullptr);
+	}
+
+	void Wrapper::initWavefront()
+	{
+		initWavefrontBuffers();
+		initWavefrontDescriptorSet();
+		initWavefrontPipelines();
+	}
+	void Wrapper::deinitWavefront()
+	{
+		deinitWavefrontPipelines();
+		deinitWavefrontDescriptorSet();
+		deinitWavefrontBuffers();
+	}
+
+	// Makes the writes of the previous stage visible to the next one, including the indirect dispatch arguments
+	static void recordWavefrontStageBarrier(VkCommandBuffer commandBuffer)
+	{
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+	}
+
+	void Wrapper::recordWavefrontTracing(VkCommandBuffer commandBuffer, uint32_t frameIdx)
+	{
+		VkDescriptorSet descriptorSets[] = { m_frames[frameIdx].descriptorSet, m_frames[frameIdx].wavefrontDescriptorSet };
+		const uint32_t uboDynamicOffset = getUBODynamicOffset(frameIdx);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_vkWavefrontPipelineLayout,
+			0,
+			2,
+			descriptorSets,
+			1,
+			&uboDynamicOffset
+			);
+
+		const uint32_t numPaths = m_renderExtent.width * m_renderExtent.height;
+		const uint32_t numPathGroups = (numPaths + c_wavefrontWorkgroupSize - 1) / c_wavefrontWorkgroupSize;
+
+		VkBuffer countersBuffer = m_vkWavefrontBuffers[eWavefrontBufferCounters];
+
+		WavefrontPushConstants pushConstants = {};
+		auto pushWavefrontConstants = [&]()
+		{
+			vkCmdPushConstants(commandBuffer, m_vkWavefrontPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(WavefrontPushConstants), &pushConstants);
+		};
+
+		// One path per pixel is traced at a time, so the frame samples are traced one after another
+		for (uint32_t sampleIdx = 0; sampleIdx < m_samplesPerFrame; ++sampleIdx)
+		{
+			pushConstants.rayQueueIdx = 0;
+			pushConstants.sampleIdx = sampleIdx;
+			pushConstants.bounceIdx = 0;
+
+			pushConstants.controlPhase = 2;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontControlPipeline);
+			pushWavefrontConstants();
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			recordWavefrontStageBarrier(commandBuffer);
+
+			// Pixels skipped by the adaptive sampling don't get into the ray queue
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontGeneratePipeline);
+			pushWavefrontConstants();
+			vkCmdDispatch(commandBuffer, numPathGroups, 1, 1);
+			recordWavefrontStageBarrier(commandBuffer);
+
+			// Sizes the first extend by the amount of generated paths, same as after the shade stage
+			//	that appends into the ray queue 0
+			pushConstants.rayQueueIdx = 1;
+			pushConstants.controlPhase = 1;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontControlPipeline);
+			pushWavefrontConstants();
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			recordWavefrontStageBarrier(commandBuffer);
+
+			// Bounces beyond the point where all the paths are terminated dispatch zero workgroups
+			for (uint32_t bounceIdx = 0; bounceIdx < m_maxBounces; ++bounceIdx)
+			{
+				pushConstants.rayQueueIdx = bounceIdx & 1;
+				pushConstants.bounceIdx = bounceIdx;
+
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontExtendPipeline);
+				pushWavefrontConstants();
+				vkCmdDispatchIndirect(commandBuffer, countersBuffer, offsetof(WavefrontCounters, extendDispatchArgs));
+				recordWavefrontStageBarrier(commandBuffer);
+
+				pushConstants.controlPhase = 0;
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontControlPipeline);
+				pushWavefrontConstants();
+				vkCmdDispatch(commandBuffer, 1, 1, 1);
+				recordWavefrontStageBarrier(commandBuffer);
+
+				// Material queues are independent, and only append to the next ray queue atomically,
+				//	so no barriers are needed between them
+				for (uint32_t queueIdx = 0; queueIdx < c_numWavefrontMaterialQueues; ++queueIdx)
+				{
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontShadePipelines[queueIdx]);
+					pushWavefrontConstants();
+					vkCmdDispatchIndirect(commandBuffer, countersBuffer, offsetof(WavefrontCounters, shadeDispatchArgs) + queueIdx * 4 * sizeof(uint32_t));
+				}
+				recordWavefrontStageBarrier(commandBuffer);
+
+				pushConstants.controlPhase = 1;
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontControlPipeline);
+				pushWavefrontConstants();
+				vkCmdDispatch(commandBuffer, 1, 1, 1);
+				recordWavefrontStageBarrier(commandBuffer);
+			}
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkWavefrontResolvePipeline);
+		pushWavefrontConstants();
+		vkCmdDispatch(commandBuffer, numPathGroups, 1, 1);
+
+		// Fullscreen quad pass presents the accumulation image
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+			);
+	}
+}
\ No newline at end of file